@@ -0,0 +1,497 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "checkpoint.h"
+#include "decode.h"
+#include "image.h"
+#include "pool.h"
+#include "common.h"
+
+#define ADIS_BATCH_INIT_ALLOC   64
+
+struct batch_run;
+struct batch_file;
+
+struct batch_chunk {
+    struct batch_file *file;
+    size_t index;
+    size_t off;
+    size_t len;
+    int done;
+    int complete;
+    struct adis_buffer out;
+};
+
+struct batch_file {
+    struct batch_run *run;
+    const char *path;
+    char *out_path;
+    struct adis_image img;
+    FILE *out;
+    struct checkpoint_entry *ckpt;
+    uint64_t out_len;
+    pthread_mutex_t lock;
+    struct batch_chunk *chunks;
+    size_t nchunks;
+    size_t next_write;
+    size_t next_submit;
+    size_t remaining;
+    // index of the first chunk known to stop early, later ones are skipped
+    size_t stop_chunk;
+    int status;
+};
+
+struct batch_run {
+    struct adis_pool *pool;
+    const char *outdir;
+    struct adis_checkpoint *ckpt;   // entries are updated under lock
+    size_t depth;                   // chunks in flight per file
+    int status;
+    size_t files;
+    size_t bytes;
+    pthread_mutex_t lock;
+};
+
+void batch_init(struct adis_batch *b)
+{
+    b->paths = NULL;
+    b->count = 0;
+    b->size = 0;
+}
+
+void batch_free(struct adis_batch *b)
+{
+    size_t i;
+
+    for (i = 0; i < b->count; i++) {
+        free(b->paths[i]);
+    }
+
+    free(b->paths);
+    batch_init(b);
+}
+
+int batch_add(struct adis_batch *b, const char *path)
+{
+    char **paths;
+
+    if (b->count == b->size) {
+        b->size = b->size ? b->size * 2 : ADIS_BATCH_INIT_ALLOC;
+        paths = realloc(b->paths, sizeof(*paths) * b->size);
+        if (paths == NULL) {
+            return 0;
+        }
+        b->paths = paths;
+    }
+
+    if ((b->paths[b->count] = strdup(path)) == NULL) {
+        return 0;
+    }
+
+    b->count++;
+    return 1;
+}
+
+int batch_add_manifest(struct adis_batch *b, const char *manifest)
+{
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t n;
+    FILE *fp;
+    int ok = 1;
+
+    if (!strcmp(manifest, "-")) {
+        fp = stdin;
+    } else if ((fp = fopen(manifest, "r")) == NULL) {
+        perror(manifest);
+        return 0;
+    }
+
+    while (ok && (n = getline(&line, &size, fp)) >= 0) {
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) {
+            line[--n] = 0;
+        }
+
+        if (n > 0) {
+            ok = batch_add(b, line);
+        }
+    }
+
+    free(line);
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    return ok;
+}
+
+static void batch_status(struct batch_run *run, int status)
+{
+    pthread_mutex_lock(&run->lock);
+    run->status = ADIS_MAX(run->status, status);
+    pthread_mutex_unlock(&run->lock);
+}
+
+static char *output_path(const char *path, const char *outdir)
+{
+    const char *base;
+    char *out;
+    size_t len;
+
+    if (outdir == NULL) {
+        len = strlen(path) + sizeof(".dis");
+        if ((out = malloc(len)) != NULL) {
+            snprintf(out, len, "%s.dis", path);
+        }
+        return out;
+    }
+
+    base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    len = strlen(outdir) + strlen(base) + sizeof("/.dis");
+    if ((out = malloc(len)) != NULL) {
+        snprintf(out, len, "%s/%s.dis", outdir, base);
+    }
+
+    return out;
+}
+
+static void file_finish(struct batch_file *f)
+{
+    if (f->out != NULL && fclose(f->out) != 0) {
+        perror(f->out_path);
+        f->status = 2;
+    }
+
+    if (f->status) {
+        batch_status(f->run, f->status);
+    }
+
+    // a file that failed is redone from its last checkpoint
+    if (f->ckpt != NULL && f->status < 2) {
+        pthread_mutex_lock(&f->run->lock);
+        f->ckpt->state = f->status ? ADIS_CHECKPOINT_STOPPED :
+            ADIS_CHECKPOINT_DONE;
+        if (!f->status) {
+            f->ckpt->input_off = f->ckpt->addr = f->img.size;
+        }
+        pthread_mutex_unlock(&f->run->lock);
+    }
+
+    image_close(&f->img);
+    pthread_mutex_destroy(&f->lock);
+    free(f->chunks);
+    free(f->out_path);
+    free(f);
+}
+
+/*
+ * Save the checkpoint once the outputs it counts are on disk. Every
+ * entry counts output of its own file, some of them closed already, so
+ * one sync() covers them all however many files there are.
+ */
+static int batch_save(struct adis_checkpoint *ckpt)
+{
+    sync();
+    return checkpoint_save(ckpt);
+}
+
+/*
+ * Everything up to the end of chunk c has been written, let the
+ * checkpoint know. The output is flushed first, so the entry never
+ * counts bytes still sitting in its buffer; they reach the disk before
+ * the entry is saved.
+ */
+static void chunk_progress(struct batch_file *f, struct batch_chunk *c)
+{
+    struct batch_run *run = f->run;
+
+    if (fflush(f->out) != 0) {
+        perror(f->out_path);
+        f->status = 2;
+        return;
+    }
+
+    pthread_mutex_lock(&run->lock);
+    f->ckpt->input_off = f->ckpt->addr = c->off + c->len;
+    f->ckpt->output_len = f->out_len;
+    if (checkpoint_due(run->ckpt)) {
+        batch_save(run->ckpt);
+    }
+    pthread_mutex_unlock(&run->lock);
+}
+
+static void chunk_task(void *arg);
+
+/*
+ * Queue the chunks after the last one submitted, in file order, as long
+ * as fewer than depth of them aren't written yet. Called with the file
+ * locked (or before any chunk runs).
+ */
+static void chunk_submit(struct batch_file *f)
+{
+    while (f->next_submit < f->nchunks &&
+           f->next_submit - f->next_write < f->run->depth) {
+        pool_submit(f->run->pool, chunk_task, &f->chunks[f->next_submit++]);
+    }
+}
+
+/*
+ * Chunks finish in any order but have to be written in order. Whoever
+ * completes a chunk writes out every finished chunk that is next in
+ * line and queues as many chunks as it wrote, the last one to finish
+ * closes the file.
+ */
+static void chunk_complete(struct batch_chunk *c)
+{
+    struct batch_file *f = c->file;
+    struct batch_chunk *next;
+    int last;
+
+    pthread_mutex_lock(&f->lock);
+    c->done = 1;
+
+    while (f->next_write < f->nchunks && f->chunks[f->next_write].done) {
+        next = &f->chunks[f->next_write++];
+
+        if (next->index <= f->stop_chunk && f->status < 2) {
+            if (fwrite(next->out.data, 1, next->out.len, f->out) !=
+                next->out.len) {
+                perror(f->out_path);
+                f->status = 2;
+            }
+            f->out_len += next->out.len;
+        }
+
+        if (!next->complete && next->index <= f->stop_chunk) {
+            f->stop_chunk = next->index;
+            f->status = ADIS_MAX(f->status, 1);
+        }
+
+        if (f->ckpt != NULL && next->complete && f->status == 0) {
+            chunk_progress(f, next);
+        }
+
+        buffer_free(&next->out);
+    }
+
+    chunk_submit(f);
+    last = --f->remaining == 0;
+    pthread_mutex_unlock(&f->lock);
+
+    if (last) {
+        file_finish(f);
+    }
+}
+
+static void chunk_task(void *arg)
+{
+    struct batch_chunk *c = arg;
+    struct batch_file *f = c->file;
+    struct adis_buffer *prev;
+    size_t off, stop;
+
+    pthread_mutex_lock(&f->lock);
+    stop = f->stop_chunk;
+    pthread_mutex_unlock(&f->lock);
+
+    c->complete = 1;
+
+    if (c->index <= stop) {
+        prev = set_output_buffer(&c->out);
+        for (off = c->off; off < c->off + c->len; off += 4) {
+            if (!disasm_line(image_word(&f->img, off), off)) {
+                c->complete = 0;
+                break;
+            }
+        }
+        set_output_buffer(prev);
+    }
+
+    if (!c->complete) {
+        // nothing after this chunk can be part of the output
+        pthread_mutex_lock(&f->lock);
+        f->stop_chunk = ADIS_MIN(f->stop_chunk, c->index);
+        pthread_mutex_unlock(&f->lock);
+    }
+
+    chunk_complete(c);
+}
+
+/*
+ * Open the output of a file, and with a checkpoint, cut it back to where
+ * the checkpoint left it. Returns the first chunk still to render, or -1
+ * on error.
+ */
+static size_t file_open_output(struct batch_file *f, size_t end)
+{
+    struct checkpoint_entry *e = f->ckpt;
+
+    if (e == NULL || (e->input_off == 0 && e->output_len == 0)) {
+        if ((f->out = fopen(f->out_path, "w")) == NULL) {
+            perror(f->out_path);
+            return (size_t)-1;
+        }
+        return 0;
+    }
+
+    // checkpoints are only taken at chunk boundaries
+    if (e->input_off > end || (e->input_off % ADIS_BATCH_CHUNK_SIZE != 0 &&
+        e->input_off != end)) {
+        fprintf(stderr, "ADIS_ERROR: Checkpoint doesn't match %s\n", f->path);
+        return (size_t)-1;
+    }
+
+    if ((f->out = fopen(f->out_path, "r+")) == NULL) {
+        perror(f->out_path);
+        return (size_t)-1;
+    } else if (!checkpoint_rewind(e, f->out, f->out_path)) {
+        fclose(f->out);
+        f->out = NULL;
+        return (size_t)-1;
+    }
+
+    f->out_len = e->output_len;
+    return (e->input_off + ADIS_BATCH_CHUNK_SIZE - 1) / ADIS_BATCH_CHUNK_SIZE;
+}
+
+static void file_task(void *arg)
+{
+    struct batch_file *f = arg;
+    size_t i, first, end;
+
+    // finished before the run was resumed
+    if (f->ckpt != NULL && f->ckpt->state != ADIS_CHECKPOINT_RUN) {
+        if (f->ckpt->state == ADIS_CHECKPOINT_STOPPED) {
+            batch_status(f->run, 1);
+        }
+        free(f->out_path);
+        free(f);
+        return;
+    }
+
+    if (!image_open(&f->img, f->path)) {
+        batch_status(f->run, 2);
+        free(f->out_path);
+        free(f);
+        return;
+    }
+
+    end = image_words_size(&f->img);
+    f->nchunks = (end + ADIS_BATCH_CHUNK_SIZE - 1) / ADIS_BATCH_CHUNK_SIZE;
+    f->chunks = calloc(f->nchunks ? f->nchunks : 1, sizeof(*f->chunks));
+    first = file_open_output(f, end);
+    f->stop_chunk = (size_t)-1;
+    pthread_mutex_init(&f->lock, NULL);
+
+    if (f->chunks == NULL || first == (size_t)-1) {
+        if (f->chunks == NULL) {
+            perror("calloc");
+        }
+        f->status = 2;
+        f->nchunks = 0;
+        first = 0;
+    }
+
+    pthread_mutex_lock(&f->run->lock);
+    f->run->files++;
+    f->run->bytes += end;
+    pthread_mutex_unlock(&f->run->lock);
+
+    if (first == f->nchunks) {
+        file_finish(f);
+        return;
+    }
+
+    f->next_write = first;
+    f->next_submit = first + 1;
+    f->remaining = f->nchunks - first;
+    for (i = first; i < f->nchunks; i++) {
+        f->chunks[i].file = f;
+        f->chunks[i].index = i;
+        f->chunks[i].off = i * ADIS_BATCH_CHUNK_SIZE;
+        f->chunks[i].len = ADIS_MIN(end - f->chunks[i].off,
+            (size_t)ADIS_BATCH_CHUNK_SIZE);
+        buffer_init(&f->chunks[i].out);
+    }
+
+    // this worker renders the first chunk, idle ones steal the next few
+    pthread_mutex_lock(&f->lock);
+    chunk_submit(f);
+    pthread_mutex_unlock(&f->lock);
+
+    chunk_task(&f->chunks[first]);
+}
+
+int batch_run(struct adis_batch *b, const char *outdir, int nthreads,
+    int verbose, struct adis_checkpoint *ckpt)
+{
+    struct batch_run run;
+    struct batch_file *f;
+    size_t i;
+
+    memset(&run, 0, sizeof(run));
+    run.outdir = outdir;
+    run.ckpt = ckpt;
+    pthread_mutex_init(&run.lock, NULL);
+
+    if ((run.pool = pool_new(nthreads)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Failed to start worker threads\n");
+        return 2;
+    }
+    run.depth = ADIS_BATCH_DEPTH * pool_size(run.pool);
+
+    for (i = 0; i < b->count; i++) {
+        f = calloc(1, sizeof(*f));
+        if (f == NULL || (f->out_path = output_path(b->paths[i], outdir)) == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            free(f);
+            run.status = 2;
+            break;
+        }
+
+        f->run = &run;
+        f->path = b->paths[i];
+        f->ckpt = ckpt != NULL ? &ckpt->entries[i] : NULL;
+        pool_submit(run.pool, file_task, f);
+    }
+
+    pool_wait(run.pool);
+
+    if (ckpt != NULL && !batch_save(ckpt)) {
+        run.status = 2;
+    }
+
+    if (verbose) {
+        fprintf(stderr, "adis: %zu files, %zu bytes, %d threads\n",
+            run.files, run.bytes, pool_size(run.pool));
+    }
+
+    pool_free(run.pool);
+    pthread_mutex_destroy(&run.lock);
+
+    return run.status;
+}
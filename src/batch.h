@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_BATCH_H__
+#define __ADIS_BATCH_H__
+
+#include <stddef.h>
+
+#include "checkpoint.h"
+
+// Inputs larger than this are split into chunks rendered in parallel
+#define ADIS_BATCH_CHUNK_SIZE   (1 << 20)
+
+/*
+ * Chunks of a file rendered or waiting to be written at once, per worker
+ * thread. Finished chunks are held until every chunk before them is
+ * written, this keeps that bounded.
+ */
+#define ADIS_BATCH_DEPTH        2
+
+struct adis_batch {
+    char **paths;
+    size_t count;
+    size_t size;
+};
+
+void batch_init(struct adis_batch *b);
+void batch_free(struct adis_batch *b);
+int batch_add(struct adis_batch *b, const char *path);
+
+// Add every non-empty line of a manifest file ("-" for stdin)
+int batch_add_manifest(struct adis_batch *b, const char *manifest);
+
+/*
+ * Disassemble every input to <input>.dis, or to DIR/<basename>.dis if
+ * outdir isn't NULL. Returns 0 if everything went fine, 1 if some input
+ * stopped at an unrecognized instruction and 2 if some input couldn't
+ * be read or written.
+ *
+ * With a checkpoint (one entry per input, in order), the progress of
+ * each file is recorded as its chunks are written, and files the
+ * checkpoint has progress for pick up from there.
+ */
+int batch_run(struct adis_batch *b, const char *outdir, int nthreads,
+    int verbose, struct adis_checkpoint *ckpt);
+
+#endif  // __ADIS_BATCH_H__
@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "branch.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_LINK_BIT(_op)      (_op & 0x01000000)
@@ -29,8 +30,19 @@ void branch_instr(uint32_t op)
     char *cond = get_condition_string(op);
 
     if (ADIS_LINK_BIT(op)) {
-        printf("BL%s =0x%.8X\n", cond, ADIS_BRANCH_OFFSET(op));
+        adis_printf("BL%s =0x%.8X\n", cond, ADIS_BRANCH_OFFSET(op));
     } else {
-        printf("B%s =0x%.8X\n", cond, ADIS_BRANCH_OFFSET(op));
+        adis_printf("B%s =0x%.8X\n", cond, ADIS_BRANCH_OFFSET(op));
     }
 }
+
+int branch_opcode(uint32_t op)
+{
+    return ADIS_LINK_BIT(op) ? ADIS_OP_BL : ADIS_OP_B;
+}
+
+uint32_t branch_target(uint32_t op, uint32_t addr)
+{
+    // signed word offset, relative to the instruction after next
+    return addr + 8 + ((int32_t)(ADIS_BRANCH_OFFSET(op) << 8) >> 6);
+}
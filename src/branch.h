@@ -22,5 +22,9 @@
 #include <stdint.h>
 
 void branch_instr(uint32_t op);
+int branch_opcode(uint32_t op);
+
+// Address a branch located at addr jumps to
+uint32_t branch_target(uint32_t op, uint32_t addr);
 
 #endif  // __ADIS_BRANCH_H__
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "buffer.h"
+
+static __thread struct adis_buffer *output;
+
+void buffer_init(struct adis_buffer *buf)
+{
+    buf->data = NULL;
+    buf->len = 0;
+    buf->size = 0;
+}
+
+void buffer_free(struct adis_buffer *buf)
+{
+    free(buf->data);
+    buffer_init(buf);
+}
+
+void buffer_reserve(struct adis_buffer *buf, size_t extra)
+{
+    size_t size = buf->size ? buf->size : ADIS_BUFFER_INIT_SIZE;
+    char *data;
+
+    if (buf->len + extra <= buf->size) {
+        return;
+    }
+
+    while (size < buf->len + extra) {
+        size *= 2;
+    }
+
+    data = realloc(buf->data, size);
+    if (data == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        exit(1);
+    }
+
+    buf->data = data;
+    buf->size = size;
+}
+
+void buffer_write(struct adis_buffer *buf, const void *data, size_t len)
+{
+    buffer_reserve(buf, len);
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+static void buffer_vprintf(struct adis_buffer *buf, const char *fmt, va_list ap)
+{
+    va_list cp;
+    int n;
+
+    // Nearly every line fits on the first try
+    buffer_reserve(buf, 128);
+    va_copy(cp, ap);
+    n = vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, cp);
+    va_end(cp);
+
+    if (n < 0) {
+        return;
+    }
+
+    if ((size_t)n >= buf->size - buf->len) {
+        buffer_reserve(buf, n + 1);
+        vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, ap);
+    }
+
+    buf->len += n;
+}
+
+void buffer_printf(struct adis_buffer *buf, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    buffer_vprintf(buf, fmt, ap);
+    va_end(ap);
+}
+
+int buffer_flush(struct adis_buffer *buf, FILE *fp)
+{
+    size_t len = buf->len;
+
+    buf->len = 0;
+    return fwrite(buf->data, 1, len, fp) == len;
+}
+
+struct adis_buffer *get_output_buffer(void)
+{
+    return output;
+}
+
+struct adis_buffer *set_output_buffer(struct adis_buffer *buf)
+{
+    struct adis_buffer *prev = output;
+    output = buf;
+    return prev;
+}
+
+void adis_printf(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    buffer_vprintf(output, fmt, ap);
+    va_end(ap);
+}
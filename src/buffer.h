@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_BUFFER_H__
+#define __ADIS_BUFFER_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define ADIS_BUFFER_INIT_SIZE   4096
+
+// Output is written out once this much has been rendered
+#define ADIS_FLUSH_SIZE         65536
+
+struct adis_buffer {
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+void buffer_init(struct adis_buffer *buf);
+void buffer_free(struct adis_buffer *buf);
+void buffer_reserve(struct adis_buffer *buf, size_t extra);
+void buffer_write(struct adis_buffer *buf, const void *data, size_t len);
+void buffer_printf(struct adis_buffer *buf, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Write the contents to fp and empty the buffer, returns 0 on error
+int buffer_flush(struct adis_buffer *buf, FILE *fp);
+
+/*
+ * The decoders don't print to stdout directly, they append to the
+ * output buffer of the calling thread. Whoever drives the decoders
+ * decides where that buffer ends up.
+ */
+struct adis_buffer *get_output_buffer(void);
+struct adis_buffer *set_output_buffer(struct adis_buffer *buf);
+
+void adis_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif  // __ADIS_BUFFER_H__
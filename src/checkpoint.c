@@ -0,0 +1,232 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+static const char *state_names[] = { "run", "done", "stopped" };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int get_state_by_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (!strcmp(name, state_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Parse one entry line in place, returns 0 if it is malformed
+static int parse_entry(char *line, struct checkpoint_entry *e,
+    const char **path)
+{
+    unsigned long long off, addr, len;
+    char state[16];
+    size_t n = strlen(line);
+    int pos;
+
+    while (n > 0 && line[n - 1] == '\n') {
+        line[--n] = 0;
+    }
+
+    if (sscanf(line, "%15s %llu %llu %llu %n", state, &off, &addr, &len,
+        &pos) != 4 || (e->state = get_state_by_name(state)) < 0) {
+        return 0;
+    }
+
+    e->input_off = off;
+    e->addr = addr;
+    e->output_len = len;
+    *path = line + pos;
+    return 1;
+}
+
+static int checkpoint_load(struct adis_checkpoint *c)
+{
+    char *line = NULL;
+    const char *path;
+    size_t size = 0, i = 0;
+    int version, ok = 1;
+    FILE *fp;
+
+    if ((fp = fopen(c->path, "r")) == NULL) {
+        // nothing saved yet, start from the beginning
+        if (errno == ENOENT) {
+            return 1;
+        }
+        perror(c->path);
+        return 0;
+    }
+
+    if (fscanf(fp, ADIS_CHECKPOINT_MAGIC " %d\n", &version) != 1 ||
+        version != ADIS_CHECKPOINT_VERSION) {
+        fprintf(stderr, "ADIS_ERROR: %s is not a checkpoint\n", c->path);
+        fclose(fp);
+        return 0;
+    }
+
+    while (ok && getline(&line, &size, fp) >= 0) {
+        ok = i < c->n && parse_entry(line, &c->entries[i], &path) &&
+            !strcmp(path, c->entries[i].path);
+        i++;
+    }
+
+    if (!ok || i != c->n) {
+        fprintf(stderr, "ADIS_ERROR: Checkpoint %s is for different inputs\n",
+            c->path);
+        ok = 0;
+    }
+
+    free(line);
+    fclose(fp);
+    return ok;
+}
+
+int checkpoint_open(struct adis_checkpoint *c, const char *path,
+    char **inputs, size_t ninputs, int resume)
+{
+    size_t i;
+
+    c->path = path;
+    c->n = ninputs;
+    c->saved = now();
+
+    if ((c->entries = calloc(ninputs ? ninputs : 1, sizeof(*c->entries))) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    for (i = 0; i < ninputs; i++) {
+        if ((c->entries[i].path = strdup(inputs[i])) == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            checkpoint_free(c);
+            return 0;
+        }
+    }
+
+    if (resume && !checkpoint_load(c)) {
+        checkpoint_free(c);
+        return 0;
+    }
+
+    return 1;
+}
+
+void checkpoint_free(struct adis_checkpoint *c)
+{
+    size_t i;
+
+    for (i = 0; i < c->n; i++) {
+        free(c->entries[i].path);
+    }
+
+    free(c->entries);
+    c->entries = NULL;
+    c->n = 0;
+}
+
+int checkpoint_due(const struct adis_checkpoint *c)
+{
+    return now() - c->saved >= ADIS_CHECKPOINT_SECS;
+}
+
+// Write to a temporary file and rename it, so the old one stays until then
+int checkpoint_save(struct adis_checkpoint *c)
+{
+    struct checkpoint_entry *e;
+    char tmp[4096];
+    FILE *fp;
+    size_t i;
+    int ok;
+
+    c->saved = now();
+    snprintf(tmp, sizeof(tmp), "%s.tmp", c->path);
+
+    if ((fp = fopen(tmp, "w")) == NULL) {
+        perror(tmp);
+        return 0;
+    }
+
+    fprintf(fp, "%s %d\n", ADIS_CHECKPOINT_MAGIC, ADIS_CHECKPOINT_VERSION);
+    for (i = 0; i < c->n; i++) {
+        e = &c->entries[i];
+        fprintf(fp, "%s %llu %llu %llu %s\n", state_names[e->state],
+            (unsigned long long)e->input_off, (unsigned long long)e->addr,
+            (unsigned long long)e->output_len, e->path);
+    }
+
+    ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0 || !ok || rename(tmp, c->path) != 0) {
+        perror(c->path);
+        unlink(tmp);
+        return 0;
+    }
+
+    return 1;
+}
+
+int checkpoint_rewind(const struct checkpoint_entry *e, FILE *fp,
+    const char *name)
+{
+    struct stat st;
+
+    if (fflush(fp) != 0 || fstat(fileno(fp), &st) != 0) {
+        perror(name);
+        return 0;
+    } else if ((uint64_t)st.st_size < e->output_len) {
+        fprintf(stderr, "ADIS_ERROR: %s is shorter than its checkpoint "
+            "(append with >> when resuming)\n", name);
+        return 0;
+    } else if (ftruncate(fileno(fp), e->output_len) != 0 ||
+        fseek(fp, 0, SEEK_END) != 0) {
+        perror(name);
+        return 0;
+    }
+
+    return 1;
+}
+
+long long checkpoint_output_len(FILE *fp)
+{
+    struct stat st;
+
+    // on disk before a checkpoint can count it
+    if (fflush(fp) != 0 || fdatasync(fileno(fp)) != 0 ||
+        fstat(fileno(fp), &st) != 0) {
+        return -1;
+    }
+
+    return st.st_size;
+}
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_CHECKPOINT_H__
+#define __ADIS_CHECKPOINT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ADIS_CHECKPOINT_MAGIC   "adis-checkpoint"
+#define ADIS_CHECKPOINT_VERSION 1
+
+// Progress is saved at most this often
+#define ADIS_CHECKPOINT_SECS    5
+
+// checkpoint_entry states
+#define ADIS_CHECKPOINT_RUN     0   // more to do from input_off
+#define ADIS_CHECKPOINT_DONE    1   // finished
+#define ADIS_CHECKPOINT_STOPPED 2   // stopped at an unrecognized word
+
+/*
+ * Progress of a long run, one entry per input (one for plain
+ * disassembly, one per file for --batch). Everything before input_off
+ * has been rendered into the first output_len bytes of the output, and
+ * the word at input_off is shown at addr. A resumed run truncates the
+ * output back to output_len and carries on from there.
+ *
+ * The file is text, a header line and one line per entry:
+ *
+ *      adis-checkpoint 1
+ *      run 1048576 1048576 22020096 path/to/input
+ *
+ * and is replaced atomically, by writing a temporary file next to it and
+ * renaming that over it. The output is flushed and synced before an
+ * entry is updated, so a checkpoint never claims more than is on disk,
+ * even after a crash.
+ */
+struct checkpoint_entry {
+    char *path;
+    int state;
+    uint64_t input_off;
+    uint64_t addr;
+    uint64_t output_len;
+};
+
+struct adis_checkpoint {
+    const char *path;
+    struct checkpoint_entry *entries;
+    size_t n;
+    double saved;               // when it was last saved
+};
+
+/*
+ * Start a checkpoint at path for the given inputs ("-" for stdin). With
+ * resume set, the saved progress is loaded, which has to be for the same
+ * inputs; if there is no checkpoint yet every input starts from the
+ * beginning. Returns 0 on error.
+ */
+int checkpoint_open(struct adis_checkpoint *c, const char *path,
+    char **inputs, size_t ninputs, int resume);
+void checkpoint_free(struct adis_checkpoint *c);
+
+// Has ADIS_CHECKPOINT_SECS passed since the last save?
+int checkpoint_due(const struct adis_checkpoint *c);
+
+// Write out every entry, returns 0 on error
+int checkpoint_save(struct adis_checkpoint *c);
+
+/*
+ * Cut the output of an entry being resumed back to output_len and move
+ * to its end. Fails if the output is shorter than that, e.g. because
+ * the shell truncated it (append with >> when resuming).
+ */
+int checkpoint_rewind(const struct checkpoint_entry *e, FILE *fp,
+    const char *name);
+
+// The length of fp once everything buffered is on disk, -1 on error
+long long checkpoint_output_len(FILE *fp);
+
+#endif  // __ADIS_CHECKPOINT_H__
@@ -27,7 +27,8 @@ void get_offset_string(uint32_t op, char *buffer, size_t bsize, uint8_t dp)
 {
     uint32_t shift;
 
-    if (ADIS_IMMOP_BIT(op)) {
+    // the I bit means an immediate for data processing, a register here
+    if (dp ? !ADIS_IMMOP_BIT(op) : ADIS_IMMOP_BIT(op)) {
         // shift + register
         uint32_t reg = ADIS_RM(op);
         shift = (op & 0x00000FF0) >> 4;
@@ -51,17 +52,49 @@ void get_offset_string(uint32_t op, char *buffer, size_t bsize, uint8_t dp)
         shift = (op & 0x00000F00) >> 8;
         // first two cases are only for dataproc
         if (dp && shift) {
+            // the rotation is in steps of two
             snprintf(buffer, ADIS_MIN(bsize, sizeof("#xxx,ROR #xxx")),
-                "#%d,ROR #%d", imm, shift);
+                "#%d,ROR #%d", imm, shift * 2);
         } else if (dp) {
             snprintf(buffer, ADIS_MIN(bsize, sizeof("#xxx")), "#%d", imm);
         } else {
-            snprintf(buffer, ADIS_MIN(bsize, sizeof("=0xFFF")),
-                "=0x%.3X", imm);
+            snprintf(buffer, ADIS_MIN(bsize, sizeof("=-0xFFF")),
+                ADIS_ADDOFFSET_BIT(op) ? "=0x%.3X" : "=-0x%.3X", imm);
         }
     }
 }
 
+/*
+ * Non-cryptographic 64-bit hash over a block of bytes, eight bytes at a
+ * time. Good enough to key page and content caches, which compare the
+ * actual bytes before trusting a match.
+ */
+uint64_t adis_hash64(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint64_t h = 0xCBF29CE484222325ULL ^ len, k;
+
+    for ( ; len >= 8; p += 8, len -= 8) {
+        memcpy(&k, p, sizeof(k));
+        k *= 0x87C37B91114253D5ULL;
+        k = (k << 31) | (k >> 33);
+        h ^= k * 0x4CF5AD432745937FULL;
+        h = ((h << 27) | (h >> 37)) * 5 + 0x52DCE729;
+    }
+
+    for ( ; len > 0; p++, len--) {
+        h = (h ^ *p) * 0x100000001B3ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
 char *get_condition_string(uint32_t op)
 {
     static char *cond[16] = { "EQ", "NE", "CS", "CC",
@@ -77,14 +110,14 @@ void get_shift_string(uint32_t shift, char *buffer, size_t bsize)
 
     if (shift & 0x01) {
         // shifted by amount in register
-        uint32_t s_reg = shift & 0xE0 >> 4;
+        uint32_t s_reg = (shift & 0xF0) >> 4;
         snprintf(buffer, ADIS_MIN(bsize, sizeof(",XXX Rxx")),
-            ",%s R%d", shiftstr[shift & 0x06 >> 1], s_reg);
+            ",%s R%d", shiftstr[(shift & 0x06) >> 1], s_reg);
     } else {
-        uint32_t imm = shift & 0xF0 >> 3;
+        uint32_t imm = (shift & 0xF8) >> 3;
         if (imm != 0) {
             snprintf(buffer, ADIS_MIN(bsize, sizeof(",XXX #xx")),
-                ",%s #%d", shiftstr[shift & 0x06 >> 1], imm);
+                ",%s #%d", shiftstr[(shift & 0x06) >> 1], imm);
         } else if (bsize > 0) {
             buffer[0] = 0;
         }
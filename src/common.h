@@ -21,6 +21,8 @@
 
 #include <stdint.h>
 
+#include "buffer.h"
+
 #define ADIS_MAX(_op1, _op2)        ((_op1 < _op2) ? _op2 : _op1)
 #define ADIS_MIN(_op1, _op2)        ((_op1 < _op2) ? _op1 : _op2)
 
@@ -41,6 +43,8 @@
 
 #define MAX_INSTR_LENGTH 64
 
+uint64_t adis_hash64(const void *data, size_t len);
+
 void get_offset_string(uint32_t op, char *buffer, size_t bsize, uint8_t dp);
 char *get_condition_string(uint32_t op);
 void get_shift_string(uint32_t shift, char *buffer, size_t bsize);
@@ -0,0 +1,311 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef ADIS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "common.h"
+#include "compress.h"
+#include "stream.h"
+
+// compress_block states
+#define ADIS_BLOCK_FREE         0   // empty or being filled
+#define ADIS_BLOCK_BUSY         1   // with a worker
+#define ADIS_BLOCK_DONE         2   // compressed, waiting to be written
+#define ADIS_BLOCK_FAILED       3
+
+/*
+ * The compressor of a block is set up the first time it is used and
+ * reset for the blocks after that. Only one worker has a block at a time.
+ */
+struct compress_block {
+    struct adis_compress *c;
+    int state;
+
+    uint8_t *in;
+    size_t len;
+    uint8_t *out;
+    size_t out_size;
+    size_t out_len;
+
+    z_stream z;
+    int z_init;
+#ifdef ADIS_HAVE_ZSTD
+    ZSTD_CCtx *cctx;
+#endif
+};
+
+int compress_parse(const char *name)
+{
+    if (strcmp(name, "gzip") == 0) {
+        return ADIS_STREAM_GZIP;
+    } else if (strcmp(name, "zstd") == 0) {
+        return ADIS_STREAM_ZSTD;
+    }
+
+    return ADIS_STREAM_NONE;
+}
+
+// One gzip member, header and trailer included
+static int compress_gzip(struct compress_block *b)
+{
+    z_stream *z = &b->z;
+
+    if (!b->z_init) {
+        memset(z, 0, sizeof(*z));
+        if (deflateInit2(z, ADIS_COMPRESS_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK) {
+            fprintf(stderr, "ADIS_ERROR: Failed to start gzip compression\n");
+            return 0;
+        }
+        b->z_init = 1;
+        b->out_size = deflateBound(z, ADIS_COMPRESS_BLOCK);
+    } else {
+        deflateReset(z);
+    }
+
+    if (b->out == NULL && (b->out = malloc(b->out_size)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    z->next_in = b->in;
+    z->avail_in = b->len;
+    z->next_out = b->out;
+    z->avail_out = b->out_size;
+
+    if (deflate(z, Z_FINISH) != Z_STREAM_END) {
+        fprintf(stderr, "ADIS_ERROR: gzip compression failed\n");
+        return 0;
+    }
+
+    b->out_len = b->out_size - z->avail_out;
+    return 1;
+}
+
+#ifdef ADIS_HAVE_ZSTD
+// One zstd frame, with the content size in its header
+static int compress_zstd(struct compress_block *b)
+{
+    size_t ret;
+
+    if (b->cctx == NULL && (b->cctx = ZSTD_createCCtx()) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Failed to start zstd compression\n");
+        return 0;
+    }
+
+    b->out_size = ZSTD_compressBound(ADIS_COMPRESS_BLOCK);
+    if (b->out == NULL && (b->out = malloc(b->out_size)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    ret = ZSTD_compressCCtx(b->cctx, b->out, b->out_size, b->in, b->len,
+        ADIS_COMPRESS_ZSTD_LEVEL);
+    if (ZSTD_isError(ret)) {
+        fprintf(stderr, "ADIS_ERROR: zstd compression failed (%s)\n",
+            ZSTD_getErrorName(ret));
+        return 0;
+    }
+
+    b->out_len = ret;
+    return 1;
+}
+#endif
+
+static void compress_task(void *arg)
+{
+    struct compress_block *b = arg;
+    struct adis_compress *c = b->c;
+    int ok;
+
+#ifdef ADIS_HAVE_ZSTD
+    ok = c->format == ADIS_STREAM_ZSTD ? compress_zstd(b) : compress_gzip(b);
+#else
+    ok = compress_gzip(b);
+#endif
+
+    pthread_mutex_lock(&c->lock);
+    b->state = ok ? ADIS_BLOCK_DONE : ADIS_BLOCK_FAILED;
+    pthread_cond_broadcast(&c->done);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void free_blocks(struct adis_compress *c)
+{
+    struct compress_block *b;
+    size_t i;
+
+    for (i = 0; i < c->nblocks; i++) {
+        b = &c->blocks[i];
+        if (b->z_init) {
+            deflateEnd(&b->z);
+        }
+#ifdef ADIS_HAVE_ZSTD
+        ZSTD_freeCCtx(b->cctx);
+#endif
+        free(b->in);
+        free(b->out);
+    }
+
+    free(c->blocks);
+    c->blocks = NULL;
+}
+
+int compress_open(struct adis_compress *c, int format, int nthreads,
+    FILE *fp)
+{
+    size_t i;
+
+#ifndef ADIS_HAVE_ZSTD
+    if (format == ADIS_STREAM_ZSTD) {
+        fprintf(stderr, "ADIS_ERROR: adis was built without zstd support\n");
+        return 0;
+    }
+#endif
+
+    memset(c, 0, sizeof(*c));
+    c->format = format;
+    c->fp = fp;
+
+    if ((c->pool = pool_new(nthreads)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Failed to start worker threads\n");
+        return 0;
+    }
+
+    c->nblocks = ADIS_COMPRESS_DEPTH * pool_size(c->pool);
+    if ((c->blocks = calloc(c->nblocks, sizeof(*c->blocks))) == NULL) {
+        goto oom;
+    }
+
+    for (i = 0; i < c->nblocks; i++) {
+        c->blocks[i].c = c;
+        if ((c->blocks[i].in = malloc(ADIS_COMPRESS_BLOCK)) == NULL) {
+            goto oom;
+        }
+    }
+
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->done, NULL);
+    return 1;
+
+oom:
+    fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+    if (c->blocks != NULL) {
+        free_blocks(c);
+    }
+    pool_free(c->pool);
+    return 0;
+}
+
+// Wait for the oldest block and write it out
+static void write_oldest(struct adis_compress *c)
+{
+    struct compress_block *b = &c->blocks[c->tail];
+
+    pthread_mutex_lock(&c->lock);
+    while (b->state == ADIS_BLOCK_BUSY) {
+        pthread_cond_wait(&c->done, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    if (b->state == ADIS_BLOCK_FAILED) {
+        c->error = 1;
+    } else if (!c->error) {
+        if (fwrite(b->out, 1, b->out_len, c->fp) != b->out_len) {
+            perror("ADIS_ERROR: Failed to write the compressed output");
+            c->error = 1;
+        }
+        c->out_bytes += b->out_len;
+    }
+
+    b->len = 0;
+    b->state = ADIS_BLOCK_FREE;
+    c->tail = (c->tail + 1) % c->nblocks;
+    c->busy--;
+}
+
+// Hand the block being filled to a worker and move on to the next one
+static void submit_block(struct adis_compress *c)
+{
+    struct compress_block *b = &c->blocks[c->head];
+
+    b->state = ADIS_BLOCK_BUSY;
+    c->busy++;
+    pool_submit(c->pool, compress_task, b);
+    c->head = (c->head + 1) % c->nblocks;
+
+    // the next one to fill is the oldest
+    if (c->busy == c->nblocks) {
+        write_oldest(c);
+    }
+}
+
+int compress_write(struct adis_compress *c, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    struct compress_block *b;
+    size_t n;
+
+    c->in_bytes += len;
+
+    while (len > 0 && !c->error) {
+        b = &c->blocks[c->head];
+        n = ADIS_MIN(len, ADIS_COMPRESS_BLOCK - b->len);
+        memcpy(b->in + b->len, p, n);
+        b->len += n;
+        p += n;
+        len -= n;
+
+        if (b->len == ADIS_COMPRESS_BLOCK) {
+            submit_block(c);
+        }
+    }
+
+    return !c->error;
+}
+
+int compress_close(struct adis_compress *c)
+{
+    int ok;
+
+    // an empty output is still one (empty) member
+    if (c->blocks[c->head].len > 0 || c->in_bytes == 0) {
+        submit_block(c);
+    }
+
+    while (c->busy > 0) {
+        write_oldest(c);
+    }
+
+    if (!c->error && fflush(c->fp) != 0) {
+        perror("ADIS_ERROR: Failed to write the compressed output");
+        c->error = 1;
+    }
+
+    ok = !c->error;
+    pool_free(c->pool);
+    free_blocks(c);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->done);
+    return ok;
+}
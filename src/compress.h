@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_COMPRESS_H__
+#define __ADIS_COMPRESS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+// Output bytes compressed into each gzip member or zstd frame
+#define ADIS_COMPRESS_BLOCK     (1024 * 1024)
+
+// Blocks in flight per worker thread
+#define ADIS_COMPRESS_DEPTH     2
+
+#define ADIS_COMPRESS_GZIP_LEVEL    6
+#define ADIS_COMPRESS_ZSTD_LEVEL    3
+
+struct compress_block;
+
+/*
+ * Compressed output, pigz style: the output is cut into blocks of
+ * ADIS_COMPRESS_BLOCK bytes that are compressed independently on the
+ * worker threads, each into a complete gzip member or zstd frame, and
+ * written to fp in order. Concatenated members (frames) are a valid
+ * gzip (zstd) file, so gunzip and zstd -d read the result like any
+ * other. At most ADIS_COMPRESS_DEPTH blocks per thread are in flight;
+ * the writer waits for the oldest one when they all are.
+ */
+struct adis_compress {
+    int format;                 // ADIS_STREAM_GZIP or ADIS_STREAM_ZSTD
+    FILE *fp;
+    struct adis_pool *pool;
+
+    struct compress_block *blocks;
+    size_t nblocks;
+    size_t head;                // block being filled
+    size_t tail;                // next block to write out
+    size_t busy;                // blocks submitted and not written yet
+    int error;
+
+    uint64_t in_bytes;
+    uint64_t out_bytes;
+
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+// ADIS_STREAM_* for "gzip" or "zstd", ADIS_STREAM_NONE if it is neither
+int compress_parse(const char *name);
+
+// nthreads <= 0 means one thread per online CPU, returns 0 on error
+int compress_open(struct adis_compress *c, int format, int nthreads,
+    FILE *fp);
+
+// Returns 0 once compressing or writing has failed
+int compress_write(struct adis_compress *c, const void *data, size_t len);
+
+// Compress and write the rest and free c, returns 0 on error
+int compress_close(struct adis_compress *c);
+
+#endif  // __ADIS_COMPRESS_H__
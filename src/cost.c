@@ -0,0 +1,385 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "branch.h"
+#include "common.h"
+#include "cost.h"
+#include "regs.h"
+
+struct cost_table {
+    const char *name;
+    const char *text;
+};
+
+/*
+ * Approximate Cortex-A9 timings, after the cycle timing tables of the
+ * Cortex-A9 TRM. Results of loads assume an L1 hit.
+ */
+static const char cortex_a9[] =
+    "*          1 1 alu\n"
+    "*.shift    1 2 alu\n"
+    "*.rshift   2 2 alu\n"
+    "MOVW       1 1 alu\n"
+    "MOVT       1 1 alu\n"
+    "CLZ        1 1 alu\n"
+    "QADD       1 2 alu\n"
+    "QSUB       1 2 alu\n"
+    "QDADD      2 3 alu\n"
+    "QDSUB      2 3 alu\n"
+    "MUL        2 4 mul\n"
+    "MLA        2 4 mul\n"
+    "MLS        2 4 mul\n"
+    "SMULL      3 5 mul\n"
+    "UMULL      3 5 mul\n"
+    "SMLAL      3 5 mul\n"
+    "UMLAL      3 5 mul\n"
+    "SMULxy     1 3 mul\n"
+    "SMLAxy     1 3 mul\n"
+    "SMULWy     1 3 mul\n"
+    "SMLAWy     1 3 mul\n"
+    "SMLALxy    2 4 mul\n"
+    "B          1 0 br\n"
+    "BL         1 0 br\n"
+    "BX         1 0 br\n"
+    "BLX        1 0 br\n"
+    "BXJ        1 0 br\n"
+    "LDR        1 3 ls\n"
+    "LDR.shift  1 4 ls\n"
+    "LDRB       1 3 ls\n"
+    "LDRB.shift 1 4 ls\n"
+    "LDRH       1 3 ls\n"
+    "LDRSB      1 4 ls\n"
+    "LDRSH      1 4 ls\n"
+    "LDRD       2 4 ls\n"
+    "STR        1 1 ls\n"
+    "STRB       1 1 ls\n"
+    "STRH       1 1 ls\n"
+    "STRSB      1 1 ls\n"
+    "STRSH      1 1 ls\n"
+    "STRD       2 1 ls\n"
+    "LDM        1 3 ls 2\n"
+    "STM        1 1 ls 2\n"
+    "SWP        2 4 ls\n"
+    "SWPB       2 4 ls\n"
+    "LDREX      1 3 ls\n"
+    "LDREXB     1 3 ls\n"
+    "LDREXH     1 3 ls\n"
+    "LDREXD     2 4 ls\n"
+    "STREX      1 2 ls\n"
+    "STREXB     1 2 ls\n"
+    "STREXH     1 2 ls\n"
+    "STREXD     2 2 ls\n"
+    "LDC        1 3 cp\n"
+    "STC        1 1 cp\n"
+    "MCR        1 1 cp\n"
+    "MRC        1 2 cp\n"
+    "CDP        1 1 cp\n"
+    "SWI        8 0 sys\n"
+    "SMC        8 0 sys\n"
+    "BKPT       8 0 sys\n"
+    "UNKNOWN    1 0 -\n";
+
+static const struct cost_table cost_tables[] = {
+    { "cortex-a9", cortex_a9 },
+};
+
+#define ADIS_COST_NUM_TABLES    (sizeof(cost_tables) / sizeof(cost_tables[0]))
+
+static int get_mode_by_name(const char *name)
+{
+    static const char *modes[ADIS_COST_MODES] = {
+        "", "imm", "reg", "shift", "rshift"
+    };
+    int i;
+
+    for (i = 1; i < ADIS_COST_MODES; i++) {
+        if (strcasecmp(name, modes[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int get_pipe(struct adis_cost *c, const char *name)
+{
+    int i;
+
+    for (i = 0; i < c->npipes; i++) {
+        if (strcmp(c->pipes[i], name) == 0) {
+            return i;
+        }
+    }
+
+    if (c->npipes == ADIS_COST_MAX_PIPES) {
+        return -1;
+    }
+
+    strcpy(c->pipes[c->npipes], name);
+    return c->npipes++;
+}
+
+// One line of a table, returns 0 if it's malformed
+static int cost_parse_line(struct adis_cost *c, char *line)
+{
+    unsigned issue, result, rpc = 0;
+    char key[32], pipe[ADIS_COST_PIPE_NAME], *dot;
+    struct cost_entry *e;
+    int id, mode = ADIS_COST_ANY, n;
+
+    if ((dot = strchr(line, '#')) != NULL) {
+        *dot = 0;
+    }
+
+    n = sscanf(line, "%31s %u %u %15s %u", key, &issue, &result, pipe, &rpc);
+    if (n <= 0) {
+        return 1;
+    } else if (n < 4 || issue > 255 || result > 255 || rpc > 255) {
+        return 0;
+    }
+
+    if ((dot = strchr(key, '.')) != NULL) {
+        *dot = 0;
+        if ((mode = get_mode_by_name(dot + 1)) < 0) {
+            return 0;
+        }
+    }
+
+    if (strcmp(key, "*") == 0) {
+        e = &c->any[mode];
+    } else {
+        for (id = 0; id < ADIS_NUM_OPS; id++) {
+            if (strcasecmp(key, get_opcode_string(id)) == 0) {
+                break;
+            }
+        }
+        if (id == ADIS_NUM_OPS) {
+            return 0;
+        }
+        e = &c->ops[id][mode];
+    }
+
+    if ((n = get_pipe(c, pipe)) < 0) {
+        return 0;
+    }
+
+    e->set = 1;
+    e->issue = issue;
+    e->result = result;
+    e->pipe = n;
+    e->regs_per_cycle = rpc;
+    return 1;
+}
+
+static int cost_parse(struct adis_cost *c, const char *text, size_t len,
+    const char *name)
+{
+    const char *end = text + len, *nl;
+    char line[256];
+    int lineno = 0;
+
+    memset(c, 0, sizeof(*c));
+
+    for (; text < end; text = nl + 1) {
+        if ((nl = memchr(text, '\n', end - text)) == NULL) {
+            nl = end;
+        }
+        lineno++;
+
+        if ((size_t)(nl - text) >= sizeof(line)) {
+            fprintf(stderr, "ADIS_ERROR: %s:%d: line too long\n", name,
+                lineno);
+            return 0;
+        }
+
+        memcpy(line, text, nl - text);
+        line[nl - text] = 0;
+
+        if (!cost_parse_line(c, line)) {
+            fprintf(stderr, "ADIS_ERROR: %s:%d: bad cost table entry\n", name,
+                lineno);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int cost_load(struct adis_cost *c, const char *name)
+{
+    struct adis_image img;
+    size_t i;
+    int ret;
+
+    for (i = 0; i < ADIS_COST_NUM_TABLES; i++) {
+        if (strcasecmp(name, cost_tables[i].name) == 0) {
+            return cost_parse(c, cost_tables[i].text,
+                strlen(cost_tables[i].text), name);
+        }
+    }
+
+    if (!image_open(&img, name)) {
+        return 0;
+    }
+
+    ret = cost_parse(c, (const char *)img.data, img.size, name);
+    image_close(&img);
+    return ret;
+}
+
+int get_instr_mode(const struct adis_instr *in)
+{
+    uint32_t op = in->op;
+
+    switch (in->cls) {
+    case ADIS_CLASS_DP_REG:
+        // LSL #0 is no shift at all
+        return (op & 0xFE0) ? ADIS_COST_SHIFT : ADIS_COST_REG;
+    case ADIS_CLASS_DP_RSR:
+        return ADIS_COST_RSHIFT;
+    case ADIS_CLASS_DP_IMM:
+    case ADIS_CLASS_DP_OTHER:
+        return ADIS_COST_IMM;
+    case ADIS_CLASS_DT_SINGLE:
+        // the I bit means a register offset here
+        if (!ADIS_IMMOP_BIT(op)) {
+            return ADIS_COST_IMM;
+        }
+        return (op & 0xFE0) ? ADIS_COST_SHIFT : ADIS_COST_REG;
+    case ADIS_CLASS_DT_EXTRA:
+        return ADIS_BYTE_BIT(op) ? ADIS_COST_IMM : ADIS_COST_REG;
+    default:
+        return ADIS_COST_ANY;
+    }
+}
+
+void get_instr_cost(const struct adis_cost *c, const struct adis_instr *in,
+    struct instr_cost *ic)
+{
+    int mode = get_instr_mode(in);
+    const struct cost_entry *e = &c->ops[in->id][mode];
+    unsigned nregs;
+
+    if (!e->set) {
+        e = &c->ops[in->id][ADIS_COST_ANY];
+    }
+    if (!e->set) {
+        e = &c->any[mode];
+    }
+    if (!e->set) {
+        e = &c->any[ADIS_COST_ANY];
+    }
+
+    ic->issue = e->issue;
+    ic->result = e->result;
+    ic->pipe = e->set ? c->pipes[e->pipe] : "-";
+
+    if (e->regs_per_cycle > 0 && in->cls == ADIS_CLASS_DT_BLOCK) {
+        nregs = __builtin_popcount(in->op & 0xFFFF);
+        ic->issue += (nregs + e->regs_per_cycle - 1) / e->regs_per_cycle;
+    }
+}
+
+static void cost_block(size_t first, size_t last, size_t n,
+    unsigned long issue)
+{
+    adis_printf("block: 0x%.8zX-0x%.8zX instructions=%zu issue=%lu\n",
+        first * 4, last * 4, n, issue);
+}
+
+long cost_disasm(const struct adis_cost *c, const struct adis_image *img,
+    int regs, FILE *fp)
+{
+    size_t nwords = image_words_size(img) / 4, i, n = 0, first = 0;
+    struct adis_buffer out, *prev;
+    unsigned long issue = 0;
+    struct instr_cost ic;
+    struct adis_instr in;
+    struct adis_regs r;
+    uint8_t *leaders;
+    uint32_t op, t;
+    long blocks = 0;
+
+    leaders = calloc(nwords / 8 + 1, 1);
+    if (leaders == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return -1;
+    }
+
+    // branch targets start a block
+    for (i = 0; i < nwords; i++) {
+        op = image_word(img, i * 4);
+        if (get_instr_class(op) == ADIS_CLASS_BRANCH) {
+            t = branch_target(op, i * 4) / 4;
+            if (t < nwords) {
+                leaders[t / 8] |= 1 << (t % 8);
+            }
+        }
+    }
+
+    buffer_init(&out);
+    prev = set_output_buffer(&out);
+
+    for (i = 0; i < nwords; i++) {
+        if (n > 0 && (leaders[i / 8] & (1 << (i % 8)))) {
+            cost_block(first, i - 1, n, issue);
+            blocks++;
+            n = 0;
+            issue = 0;
+        }
+
+        if (n == 0) {
+            first = i;
+        }
+
+        decode_instr(image_word(img, i * 4), &in);
+        disasm_decoded_line(&in, i * 4);
+        if (regs) {
+            disasm_regs(&in);
+        }
+
+        get_instr_cost(c, &in, &ic);
+        adis_printf("cost: issue=%u result=%u pipe=%s\n", ic.issue, ic.result,
+            ic.pipe);
+        issue += ic.issue;
+        n++;
+
+        get_instr_regs(&in, &r);
+        if (in.cls == ADIS_CLASS_BRANCH || in.cls == ADIS_CLASS_SW_INTERRUPT ||
+            (r.write & (1 << 15)) || i + 1 == nwords) {
+            cost_block(first, i, n, issue);
+            blocks++;
+            n = 0;
+            issue = 0;
+        }
+
+        if (out.len >= ADIS_FLUSH_SIZE) {
+            buffer_flush(&out, fp);
+        }
+    }
+
+    buffer_flush(&out, fp);
+    set_output_buffer(prev);
+    buffer_free(&out);
+    free(leaders);
+    return blocks;
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_COST_H__
+#define __ADIS_COST_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "decode.h"
+#include "image.h"
+#include "opcodes.h"
+
+// Addressing modes cost tables can tell apart
+#define ADIS_COST_ANY           0
+#define ADIS_COST_IMM           1   // immediate operand or offset
+#define ADIS_COST_REG           2   // plain register operand or offset
+#define ADIS_COST_SHIFT         3   // register shifted by an immediate
+#define ADIS_COST_RSHIFT        4   // register shifted by a register
+
+#define ADIS_COST_MODES         5
+#define ADIS_COST_MAX_PIPES     16
+#define ADIS_COST_PIPE_NAME     16
+
+struct cost_entry {
+    uint8_t set;
+    uint8_t issue;          // cycles the instruction occupies the pipeline
+    uint8_t result;         // cycles until its result can be used
+    uint8_t pipe;           // index into adis_cost.pipes
+    uint8_t regs_per_cycle; // block transfers: one more issue cycle per this
+                            // many registers, 0 for none
+};
+
+/*
+ * Static per-core cost table. Tables are text, one entry per line:
+ *
+ *      KEY ISSUE RESULT PIPE [REGS_PER_CYCLE]
+ *
+ * where KEY is an opcode name (as in get_opcode_string) or "*" for
+ * opcodes without an entry of their own, optionally followed by
+ * ".imm", ".reg", ".shift" or ".rshift" to only apply to that addressing
+ * mode. '#' starts a comment. The most specific of OP.MODE, OP, *.MODE
+ * and * wins.
+ */
+struct adis_cost {
+    struct cost_entry ops[ADIS_NUM_OPS][ADIS_COST_MODES];
+    struct cost_entry any[ADIS_COST_MODES];
+    char pipes[ADIS_COST_MAX_PIPES][ADIS_COST_PIPE_NAME];
+    int npipes;
+};
+
+struct instr_cost {
+    unsigned issue;
+    unsigned result;
+    const char *pipe;
+};
+
+// Built-in table by name (e.g. "cortex-a9"), otherwise a table file
+int cost_load(struct adis_cost *c, const char *name);
+
+int get_instr_mode(const struct adis_instr *in);
+void get_instr_cost(const struct adis_cost *c, const struct adis_instr *in,
+    struct instr_cost *ic);
+
+/*
+ * Linear disassembly with a "cost:" line after every instruction (and
+ * the "regs:" line if regs is set), and a "block:" line with the summed
+ * issue cycles after the last instruction of every basic block. Blocks
+ * end at branches and other writes to the PC, and before branch targets.
+ * Returns the number of blocks, or -1 on error.
+ */
+long cost_disasm(const struct adis_cost *c, const struct adis_image *img,
+    int regs, FILE *fp);
+
+#endif  // __ADIS_COST_H__
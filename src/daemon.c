@@ -0,0 +1,481 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "decode.h"
+#include "pool.h"
+#include "common.h"
+
+#define ADIS_DAEMON_MAX_EVENTS  64
+#define ADIS_DAEMON_READ_SIZE   65536
+
+struct daemon;
+
+struct daemon_conn {
+    int fd;
+    struct daemon *d;
+    struct adis_buffer in;
+    struct adis_buffer out;
+    size_t out_pos;
+    int busy;
+    int eof;
+    int closing;
+    struct daemon_conn *done_next;
+};
+
+struct daemon {
+    int epfd;
+    int listen_fd;
+    int event_fd;
+    struct adis_pool *pool;
+    pthread_mutex_t done_lock;
+    struct daemon_conn *done;
+    struct daemon_conn *dead;
+};
+
+static volatile sig_atomic_t stop_requested;
+
+static void handle_stop(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+static uint32_t get_le32(const void *p)
+{
+    const uint8_t *b = p;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+           ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void put_le32(void *p, uint32_t val)
+{
+    uint8_t *b = p;
+    b[0] = val;
+    b[1] = val >> 8;
+    b[2] = val >> 16;
+    b[3] = val >> 24;
+}
+
+static void set_response_header(struct adis_buffer *out, uint32_t status)
+{
+    char *p = out->data;
+
+    put_le32(p, ADIS_DAEMON_RESPONSE_MAGIC);
+    put_le32(p + 4, status);
+    put_le32(p + 8, out->len - sizeof(struct daemon_response));
+    put_le32(p + 12, 0);
+}
+
+static void conn_watch(struct daemon_conn *c, uint32_t events)
+{
+    struct epoll_event ev;
+
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(c->d->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/*
+ * Events for a closed connection may still be pending in the current
+ * batch, so it's only marked dead here and freed after the batch.
+ */
+static void conn_close(struct daemon_conn *c)
+{
+    epoll_ctl(c->d->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->done_next = c->d->dead;
+    c->d->dead = c;
+}
+
+static void daemon_reap(struct daemon *d)
+{
+    struct daemon_conn *c, *next;
+
+    for (c = d->dead; c != NULL; c = next) {
+        next = c->done_next;
+        buffer_free(&c->in);
+        buffer_free(&c->out);
+        free(c);
+    }
+
+    d->dead = NULL;
+}
+
+// Runs on a worker thread, the connection is left alone until it's done
+static void daemon_render(void *arg)
+{
+    struct daemon_conn *c = arg;
+    struct adis_buffer *prev;
+    const uint8_t *p = (const uint8_t *)c->in.data;
+    uint32_t flags, base, len, off, op;
+    uint32_t status = ADIS_DAEMON_OK;
+    uint64_t one = 1;
+
+    flags = get_le32(p + 4);
+    base = get_le32(p + 8);
+    len = get_le32(p + 12) & ~3U;
+    p += sizeof(struct daemon_request);
+
+    prev = set_output_buffer(&c->out);
+    buffer_reserve(&c->out, sizeof(struct daemon_response));
+    c->out.len = sizeof(struct daemon_response);
+
+    for (off = 0; off < len; off += 4) {
+        op = ((uint32_t)p[off] << 24) | ((uint32_t)p[off + 1] << 16) |
+             ((uint32_t)p[off + 2] << 8) | (uint32_t)p[off + 3];
+
+        if (!disasm_line(op, base + off) &&
+            !(flags & ADIS_DAEMON_CONTINUE)) {
+            status = ADIS_DAEMON_STOPPED;
+            break;
+        }
+    }
+
+    set_response_header(&c->out, status);
+    set_output_buffer(prev);
+
+    pthread_mutex_lock(&c->d->done_lock);
+    c->done_next = c->d->done;
+    c->d->done = c;
+    pthread_mutex_unlock(&c->d->done_lock);
+
+    if (write(c->d->event_fd, &one, sizeof(one)) < 0) {
+        // the counter can't overflow in practice, nothing to do
+    }
+}
+
+static void conn_write(struct daemon_conn *c);
+
+/*
+ * Start on the next complete request in the input buffer. Returns 0 if
+ * there isn't one yet.
+ */
+static int conn_dispatch(struct daemon_conn *c)
+{
+    uint32_t len;
+
+    if (c->in.len < sizeof(struct daemon_request)) {
+        return 0;
+    }
+
+    len = get_le32(c->in.data + 12);
+
+    if (get_le32(c->in.data) != ADIS_DAEMON_REQUEST_MAGIC ||
+        len > ADIS_DAEMON_MAX_REQUEST) {
+        buffer_reserve(&c->out, sizeof(struct daemon_response));
+        c->out.len = sizeof(struct daemon_response);
+        set_response_header(&c->out, ADIS_DAEMON_BAD_REQUEST);
+        c->in.len = 0;
+        c->closing = 1;
+        return 1;
+    }
+
+    if (c->in.len < sizeof(struct daemon_request) + len) {
+        return 0;
+    }
+
+    // stop reading until the response has gone out
+    c->busy = 1;
+    conn_watch(c, 0);
+    pool_submit(c->d->pool, daemon_render, c);
+    return 1;
+}
+
+// Called whenever nothing is in flight on the connection
+static void conn_next(struct daemon_conn *c)
+{
+    if (conn_dispatch(c)) {
+        if (!c->busy) {
+            conn_write(c);
+        }
+    } else if (c->eof) {
+        conn_close(c);
+    } else {
+        conn_watch(c, EPOLLIN);
+    }
+}
+
+static void conn_write(struct daemon_conn *c)
+{
+    ssize_t n;
+
+    while (c->out_pos < c->out.len) {
+        n = write(c->fd, c->out.data + c->out_pos, c->out.len - c->out_pos);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            conn_watch(c, EPOLLOUT);
+            return;
+        } else if (n < 0) {
+            conn_close(c);
+            return;
+        }
+
+        c->out_pos += n;
+    }
+
+    c->out.len = 0;
+    c->out_pos = 0;
+
+    if (c->closing) {
+        conn_close(c);
+    } else {
+        conn_next(c);
+    }
+}
+
+static void conn_read(struct daemon_conn *c)
+{
+    ssize_t n;
+
+    for (;;) {
+        buffer_reserve(&c->in, ADIS_DAEMON_READ_SIZE);
+        n = read(c->fd, c->in.data + c->in.len, c->in.size - c->in.len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            break;
+        } else if (n < 0) {
+            conn_close(c);
+            return;
+        } else if (n == 0) {
+            // the client may still be waiting for responses
+            c->eof = 1;
+            break;
+        }
+
+        c->in.len += n;
+
+        // don't buffer more than one request ahead
+        if (c->in.len >= sizeof(struct daemon_request) +
+                ADIS_DAEMON_MAX_REQUEST) {
+            break;
+        }
+    }
+
+    conn_next(c);
+}
+
+static void daemon_accept(struct daemon *d)
+{
+    struct daemon_conn *c;
+    struct epoll_event ev;
+    int fd;
+
+    while ((fd = accept4(d->listen_fd, NULL, NULL,
+            SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        c = calloc(1, sizeof(*c));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->d = d;
+        buffer_init(&c->in);
+        buffer_init(&c->out);
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+static void daemon_complete(struct daemon *d)
+{
+    struct daemon_conn *c, *next;
+    uint64_t count;
+    size_t used;
+
+    if (read(d->event_fd, &count, sizeof(count)) < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&d->done_lock);
+    c = d->done;
+    d->done = NULL;
+    pthread_mutex_unlock(&d->done_lock);
+
+    for ( ; c != NULL; c = next) {
+        next = c->done_next;
+        c->busy = 0;
+
+        used = sizeof(struct daemon_request) + get_le32(c->in.data + 12);
+        memmove(c->in.data, c->in.data + used, c->in.len - used);
+        c->in.len -= used;
+
+        if (c->closing) {
+            conn_close(c);
+        } else {
+            conn_write(c);
+        }
+    }
+}
+
+static int daemon_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return -1;
+    }
+
+    // clean up after a previous instance, but never remove anything else
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int daemon_run(const char *path, int nthreads)
+{
+    struct epoll_event ev, events[ADIS_DAEMON_MAX_EVENTS];
+    struct daemon_conn *c;
+    struct sigaction sa;
+    struct daemon d;
+    int i, n, ret = 0;
+
+    memset(&d, 0, sizeof(d));
+    pthread_mutex_init(&d.done_lock, NULL);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+    sa.sa_handler = handle_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if ((d.listen_fd = daemon_listen(path)) < 0) {
+        return 0;
+    }
+
+    d.epfd = epoll_create1(EPOLL_CLOEXEC);
+    d.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    d.pool = pool_new(nthreads);
+
+    if (d.epfd < 0 || d.event_fd < 0 || d.pool == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Failed to start daemon\n");
+        goto out;
+    }
+
+    // listen and event fds are told apart from connections by their fd
+    ev.events = EPOLLIN;
+    ev.data.ptr = &d.listen_fd;
+    epoll_ctl(d.epfd, EPOLL_CTL_ADD, d.listen_fd, &ev);
+    ev.data.ptr = &d.event_fd;
+    epoll_ctl(d.epfd, EPOLL_CTL_ADD, d.event_fd, &ev);
+
+    while (!stop_requested) {
+        n = epoll_wait(d.epfd, events, ADIS_DAEMON_MAX_EVENTS, -1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            perror("epoll_wait");
+            goto out;
+        }
+
+        for (i = 0; i < n; i++) {
+            if (events[i].data.ptr == &d.listen_fd) {
+                daemon_accept(&d);
+                continue;
+            } else if (events[i].data.ptr == &d.event_fd) {
+                daemon_complete(&d);
+                continue;
+            }
+
+            c = events[i].data.ptr;
+            if (c->fd < 0) {
+                continue;
+            } else if (c->busy) {
+                // hangup while a worker owns it, close it once it's back
+                c->closing = 1;
+                epoll_ctl(d.epfd, EPOLL_CTL_DEL, c->fd, NULL);
+            } else if (events[i].events & EPOLLOUT) {
+                conn_write(c);
+            } else {
+                conn_read(c);
+            }
+        }
+
+        daemon_reap(&d);
+    }
+
+    ret = 1;
+
+out:
+    // let in-flight requests finish before tearing down
+    if (d.pool != NULL) {
+        pool_wait(d.pool);
+        pool_free(d.pool);
+    }
+
+    if (d.event_fd >= 0) {
+        close(d.event_fd);
+    }
+    if (d.epfd >= 0) {
+        close(d.epfd);
+    }
+
+    close(d.listen_fd);
+    unlink(path);
+    pthread_mutex_destroy(&d.done_lock);
+    return ret;
+}
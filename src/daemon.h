@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_DAEMON_H__
+#define __ADIS_DAEMON_H__
+
+#include <stdint.h>
+
+/*
+ * Wire format of the disassembly daemon. A client connects to the Unix
+ * socket and sends any number of requests; responses come back on the
+ * same connection in the order the requests were sent. All header
+ * fields are little-endian.
+ *
+ *      request:    struct daemon_request, then len bytes of big-endian
+ *                  instruction words (a trailing partial word is ignored)
+ *      response:   struct daemon_response, then len bytes of text in the
+ *                  same format as the regular adis output
+ */
+#define ADIS_DAEMON_REQUEST_MAGIC   0x51524441  // "ADRQ"
+#define ADIS_DAEMON_RESPONSE_MAGIC  0x53524441  // "ADRS"
+
+#define ADIS_DAEMON_MAX_REQUEST     (64 << 20)
+
+// request flags
+#define ADIS_DAEMON_CONTINUE        0x00000001  // don't stop at bad words
+
+// response status
+#define ADIS_DAEMON_OK              0
+#define ADIS_DAEMON_STOPPED         1   // stopped at an unrecognized word
+#define ADIS_DAEMON_BAD_REQUEST     2   // connection is closed afterwards
+
+struct daemon_request {
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t base;
+    uint32_t len;
+};
+
+struct daemon_response {
+    uint32_t magic;
+    uint32_t status;
+    uint32_t len;
+    uint32_t reserved;
+};
+
+// Serve requests on a Unix socket at path until SIGINT or SIGTERM
+int daemon_run(const char *path, int nthreads);
+
+#endif  // __ADIS_DAEMON_H__
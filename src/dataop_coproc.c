@@ -20,6 +20,7 @@
 #include <stdlib.h>
 
 #include "dataop_coproc.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_OPCODE(_op)        ((_op & 0x00F00000) >> 20)
@@ -33,11 +34,17 @@ void dataop_coproc_instr(uint32_t op)
     coproc_info = ADIS_CPINFO(op);
 
     if (coproc_info > 0) {
-        printf("CDP%s p%d,%d,c%d,c%d,c%d\n", cond, ADIS_CPNUM(op),
+        adis_printf("CDP%s p%d,%d,c%d,c%d,c%d\n", cond, ADIS_CPNUM(op),
             ADIS_OPCODE(op), ADIS_RD(op), ADIS_RN(op), ADIS_RM(op));
     } else {
-        printf("CDP%s, p%d,%d,c%d,c%d,c%d,%d\n", cond, ADIS_CPNUM(op),
+        adis_printf("CDP%s, p%d,%d,c%d,c%d,c%d,%d\n", cond, ADIS_CPNUM(op),
             ADIS_OPCODE(op), ADIS_RD(op), ADIS_RN(op), 
             ADIS_RM(op), coproc_info);
     }
 }
+
+int dataop_coproc_opcode(uint32_t op)
+{
+    (void)op;
+    return ADIS_OP_CDP;
+}
@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void dataop_coproc_instr(uint32_t op);
+int dataop_coproc_opcode(uint32_t op);
 
 #endif // __ADIS_DATAOP_COPROC_H__
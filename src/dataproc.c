@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include "dataproc.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_OPCODE(_op)        ((_op & 0x01E00000) >> 21)
@@ -84,54 +85,85 @@ static void data_proc_instr(uint32_t op, uint32_t opc)
         setcond = ADIS_SETCOND_BIT(op) ? 'S' : 0;
 
         if (is_single_op(opc)) {
-            printf("%s%s%c R%d,%s\n", opstr, cond, setcond, ADIS_RD(op), offset);
+            adis_printf("%s%s%c R%d,%s\n", opstr, cond, setcond, ADIS_RD(op), offset);
         } else {
-            printf("%s%s%c R%d,R%d,%s\n", opstr, cond, setcond, ADIS_RD(op),
+            adis_printf("%s%s%c R%d,R%d,%s\n", opstr, cond, setcond, ADIS_RD(op),
                 ADIS_RN(op), offset);
         }
     } else {
-        printf("%s%s R%d,%s\n", opstr, cond, ADIS_RN(op), offset);
+        adis_printf("%s%s R%d,%s\n", opstr, cond, ADIS_RN(op), offset);
     }
 }
 
-void dp_reg_instr(uint32_t op)
+static uint32_t dp_imm_value(uint32_t op)
+{
+    uint32_t imm = op & 0xFF, rot = (op & 0x00000F00) >> 7;
+
+    return rot ? (imm >> rot) | (imm << (32 - rot)) : imm;
+}
+
+static int dp_reg_opc(uint32_t op)
 {
     int op1 = ADIS_OPCODE(op), op2 = op & 0x00000F80, opc;
 
     if ((op1 != 0b1101) || (op1 == 0b1101 && !op2)) {
         opc = op1;
     } else {
-        int op3 = (op & 0x00000060) >> 4;
+        int op3 = (op & 0x00000060) >> 5;
         opc = ADIS_DATAPROC_LSL + (op3 == 0b11 ? op3 + !op2 : op3);
     }
 
-    data_proc_instr(op, opc);
+    return opc;
 }
 
-void dp_rsr_instr(uint32_t op)
+static int dp_rsr_opc(uint32_t op)
 {
     int op1 = ADIS_OPCODE(op), opc;
 
     if (op1 != 0b1101) {
         opc = op1;
     } else {
-        int op2 = (op & 0x00000060) >> 4;
+        int op2 = (op & 0x00000060) >> 5;
         opc = ADIS_DATAPROC_LSL + op2;
     }
 
-    data_proc_instr(op, opc);
+    return opc;
 }
 
-void dp_imm_instr(uint32_t op)
+static int dp_imm_opc(uint32_t op)
 {
     int opc = ADIS_OPCODE(op);
 
-    if (ADIS_RN(op) == 0b1111 &&
+    // ADDS and SUBS from the PC are not ADR
+    if (ADIS_RN(op) == 0b1111 && !ADIS_SETCOND_BIT(op) &&
         (opc == ADIS_DATAPROC_SUB || opc == ADIS_DATAPROC_ADD)) {
         opc = ADIS_DATAPROC_ADR;
     }
 
-    data_proc_instr(op, opc);
+    return opc;
+}
+
+void dp_reg_instr(uint32_t op)
+{
+    data_proc_instr(op, dp_reg_opc(op));
+}
+
+void dp_rsr_instr(uint32_t op)
+{
+    data_proc_instr(op, dp_rsr_opc(op));
+}
+
+void dp_imm_instr(uint32_t op)
+{
+    int opc = dp_imm_opc(op);
+
+    // the offset from the PC, which is negative for the SUB form
+    if (opc == ADIS_DATAPROC_ADR) {
+        adis_printf("ADR%s R%d,#%s%u\n", get_condition_string(op), ADIS_RD(op),
+            ADIS_OPCODE(op) == ADIS_DATAPROC_SUB ? "-" : "", dp_imm_value(op));
+    } else {
+        data_proc_instr(op, opc);
+    }
 }
 
 void dp_other_instr(uint32_t op)
@@ -141,6 +173,26 @@ void dp_other_instr(uint32_t op)
     cond = get_condition_string(op);
     subinstr = ADIS_MOVT_BIT(op) ? 'T' : 'W';
 
-    printf("MOV%c R%d,=0x%x\n", subinstr, ADIS_RD(op),
+    adis_printf("MOV%c R%d,=0x%x\n", subinstr, ADIS_RD(op),
         ((op & 0x000F0000) >> 4 | (op & 0x00000FFF)));
 }
+
+int dp_reg_opcode(uint32_t op)
+{
+    return ADIS_OP_AND + dp_reg_opc(op);
+}
+
+int dp_rsr_opcode(uint32_t op)
+{
+    return ADIS_OP_AND + dp_rsr_opc(op);
+}
+
+int dp_imm_opcode(uint32_t op)
+{
+    return ADIS_OP_AND + dp_imm_opc(op);
+}
+
+int dp_other_opcode(uint32_t op)
+{
+    return ADIS_MOVT_BIT(op) ? ADIS_OP_MOVT : ADIS_OP_MOVW;
+}
@@ -26,4 +26,9 @@ void dp_rsr_instr(uint32_t op);
 void dp_imm_instr(uint32_t op);
 void dp_other_instr(uint32_t op);
 
+int dp_reg_opcode(uint32_t op);
+int dp_rsr_opcode(uint32_t op);
+int dp_imm_opcode(uint32_t op);
+int dp_other_opcode(uint32_t op);
+
 #endif  // __ADIS_DATAPROC_H__
@@ -0,0 +1,222 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "decode.h"
+#include "opcodes.h"
+#include "predicates.h"
+#include "common.h"
+#include "dataproc.h"
+#include "misc.h"
+#include "multi.h"
+#include "sync.h"
+#include "branch.h"
+#include "dt_single.h"
+#include "dt_block.h"
+#include "dt_extra.h"
+#include "dt_coproc.h"
+#include "rt_coproc.h"
+#include "dataop_coproc.h"
+#include "sw_interrupt.h"
+
+static void (*const class_instr[ADIS_NUM_CLASSES - 1])(uint32_t) = {
+    sync_instr, misc_instr, multi_instr, halfword_multi_instr,
+    dp_reg_instr, dp_rsr_instr, dp_imm_instr, dp_other_instr,
+    branch_instr, dt_single_instr, dt_block_instr, dt_extra_instr,
+    dt_coproc_instr, rt_coproc_instr, dataop_coproc_instr,
+    sw_interrupt_instr
+};
+
+static int (*const class_opcode[ADIS_NUM_CLASSES - 1])(uint32_t) = {
+    sync_opcode, misc_opcode, multi_opcode, halfword_multi_opcode,
+    dp_reg_opcode, dp_rsr_opcode, dp_imm_opcode, dp_other_opcode,
+    branch_opcode, dt_single_opcode, dt_block_opcode, dt_extra_opcode,
+    dt_coproc_opcode, rt_coproc_opcode, dataop_coproc_opcode,
+    sw_interrupt_opcode
+};
+
+int get_instr_class(uint32_t op)
+{
+    if (is_sync_primitive(op)) {
+        return ADIS_CLASS_SYNC;
+    } else if (is_misc(op)) {
+        return ADIS_CLASS_MISC;
+    } else if (is_multi(op)) {
+        return ADIS_CLASS_MULTI;
+    } else if (is_halfword_multi(op)) {
+        return ADIS_CLASS_HW_MULTI;
+    } else if (is_dp_reg(op)) {
+        return ADIS_CLASS_DP_REG;
+    } else if (is_dp_rsr(op)) {
+        return ADIS_CLASS_DP_RSR;
+    } else if (is_dp_imm(op)) {
+        return ADIS_CLASS_DP_IMM;
+    } else if (is_dp_other(op)) {
+        return ADIS_CLASS_DP_OTHER;
+    } else if (is_branch(op)) {
+        return ADIS_CLASS_BRANCH;
+    } else if (is_dt_single(op)) {
+        return ADIS_CLASS_DT_SINGLE;
+    } else if (is_dt_block(op)) {
+        return ADIS_CLASS_DT_BLOCK;
+    } else if (is_dt_extra(op)) {
+        return ADIS_CLASS_DT_EXTRA;
+    } else if (is_dt_coproc(op)) {
+        return ADIS_CLASS_DT_COPROC;
+    } else if (is_rt_coproc(op)) {
+        return ADIS_CLASS_RT_COPROC;
+    } else if (is_dataop_coproc(op)) {
+        return ADIS_CLASS_DATAOP_COPROC;
+    } else if (is_sw_interrupt(op)) {
+        return ADIS_CLASS_SW_INTERRUPT;
+    }
+
+    return ADIS_CLASS_UNKNOWN;
+}
+
+char *get_class_string(int cls)
+{
+    static char *clsstr[ADIS_NUM_CLASSES] = {
+        "sync", "misc", "multi", "hw_multi",
+        "dp_reg", "dp_rsr", "dp_imm", "dp_other",
+        "branch", "dt_single", "dt_block", "dt_extra",
+        "dt_coproc", "rt_coproc", "dataop_coproc", "sw_interrupt",
+        "unknown"
+    };
+    return clsstr[cls];
+}
+
+int get_class_by_name(const char *name)
+{
+    int cls;
+
+    for (cls = 0; cls < ADIS_NUM_CLASSES; cls++) {
+        if (!strcmp(name, get_class_string(cls))) {
+            return cls;
+        }
+    }
+
+    return -1;
+}
+
+char *get_opcode_string(int id)
+{
+    static char *opstr[ADIS_NUM_OPS] = {
+        "UNKNOWN", "AND", "EOR", "SUB", "RSB", "ADD", "ADC", "SBC", "RSC",
+        "TST", "TEQ", "CMP", "CMN", "ORR", "MOV", "BIC", "MVN", "LSL",
+        "LSR", "ASR", "ROR", "RRX", "ADR", "MOVW", "MOVT", "MUL", "MLA",
+        "MLS", "SMULL", "SMLAL", "UMULL", "UMLAL", "SMLAxy", "SMLALxy",
+        "SMULxy", "SMULWy", "SMLAWy", "BX", "CLZ", "BXJ", "BLX", "BKPT",
+        "SMC", "QADD", "QDADD", "QSUB", "QDSUB", "B", "BL", "SWP", "SWPB",
+        "LDREX", "STREX", "LDREXB", "STREXB", "LDREXH", "STREXH", "LDREXD",
+        "STREXD", "LDR", "STR", "LDRB", "STRB", "LDM", "STM", "LDRH",
+        "STRH", "LDRSB", "STRSB", "LDRSH", "STRSH", "LDRD", "STRD", "LDC",
+        "STC", "MCR", "MRC", "CDP", "SWI"
+    };
+    return opstr[id];
+}
+
+void decode_instr(uint32_t op, struct adis_instr *in)
+{
+    in->op = op;
+    in->cls = get_instr_class(op);
+    in->cond = op >> 28;
+    in->id = in->cls == ADIS_CLASS_UNKNOWN ?
+        ADIS_OP_UNKNOWN : class_opcode[in->cls](op);
+}
+
+static int32_t signed_offset(uint32_t op, int32_t imm)
+{
+    return ADIS_ADDOFFSET_BIT(op) ? imm : -imm;
+}
+
+int32_t get_instr_imm(const struct adis_instr *in)
+{
+    uint32_t op = in->op, rot;
+
+    switch (in->cls) {
+    case ADIS_CLASS_DP_IMM:
+        rot = (op & 0x00000F00) >> 7;
+        return rot ? ((op & 0xFF) >> rot) | ((op & 0xFF) << (32 - rot)) :
+            (op & 0xFF);
+    case ADIS_CLASS_DP_OTHER:
+        return ((op & 0x000F0000) >> 4) | (op & 0x00000FFF);
+    case ADIS_CLASS_BRANCH:
+        // sign extend the 24-bit word offset
+        return (int32_t)(op << 8) >> 6;
+    case ADIS_CLASS_DT_SINGLE:
+        return ADIS_IMMOP_BIT(op) ? 0 : signed_offset(op, op & 0x00000FFF);
+    case ADIS_CLASS_DT_EXTRA:
+        // bit 22 selects the immediate form here
+        return ADIS_BYTE_BIT(op) ?
+            signed_offset(op, ((op & 0x00000F00) >> 4) | (op & 0xF)) : 0;
+    case ADIS_CLASS_DT_COPROC:
+        return signed_offset(op, (op & 0xFF) << 2);
+    case ADIS_CLASS_SW_INTERRUPT:
+        return op & 0x00FFFFFF;
+    case ADIS_CLASS_MISC:
+        if (in->id == ADIS_OP_BKPT) {
+            return ((op & 0x000FFF00) >> 4) | (op & 0xF);
+        } else if (in->id == ADIS_OP_SMC) {
+            return op & 0xF;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+int disasm_instr(uint32_t op)
+{
+    int cls = get_instr_class(op);
+
+    if (cls == ADIS_CLASS_UNKNOWN) {
+        adis_printf("Unrecognized instruction 0x%x\n", op);
+        return 0;
+    }
+
+    class_instr[cls](op);
+    return 1;
+}
+
+int disasm_line(uint32_t op, uint32_t addr)
+{
+    adis_printf("op: 0x%.8X\n", op);
+    adis_printf("0x%.8X:\t", addr);
+    return disasm_instr(op);
+}
+
+int disasm_decoded(const struct adis_instr *in)
+{
+    if (in->cls == ADIS_CLASS_UNKNOWN) {
+        adis_printf("Unrecognized instruction 0x%x\n", in->op);
+        return 0;
+    }
+
+    class_instr[in->cls](in->op);
+    return 1;
+}
+
+int disasm_decoded_line(const struct adis_instr *in, uint32_t addr)
+{
+    adis_printf("op: 0x%.8X\n", in->op);
+    adis_printf("0x%.8X:\t", addr);
+    return disasm_decoded(in);
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_DECODE_H__
+#define __ADIS_DECODE_H__
+
+#include <stdint.h>
+
+// Instruction classes, in the order the predicates are tried
+#define ADIS_CLASS_SYNC             0
+#define ADIS_CLASS_MISC             1
+#define ADIS_CLASS_MULTI            2
+#define ADIS_CLASS_HW_MULTI         3
+#define ADIS_CLASS_DP_REG           4
+#define ADIS_CLASS_DP_RSR           5
+#define ADIS_CLASS_DP_IMM           6
+#define ADIS_CLASS_DP_OTHER         7
+#define ADIS_CLASS_BRANCH           8
+#define ADIS_CLASS_DT_SINGLE        9
+#define ADIS_CLASS_DT_BLOCK         10
+#define ADIS_CLASS_DT_EXTRA         11
+#define ADIS_CLASS_DT_COPROC        12
+#define ADIS_CLASS_RT_COPROC        13
+#define ADIS_CLASS_DATAOP_COPROC    14
+#define ADIS_CLASS_SW_INTERRUPT     15
+#define ADIS_CLASS_UNKNOWN          16
+
+#define ADIS_NUM_CLASSES            17
+
+// Length of the "op: 0x%.8X\n0x" prefix before the address column
+#define ADIS_ADDR_COLUMN            17
+
+// Length of the "op: 0x%.8X\n" line in front of the address line
+#define ADIS_OP_LINE                (ADIS_ADDR_COLUMN - 2)
+
+#define ADIS_COND_AL                0xE
+
+// An instruction word after classification, before any text is rendered
+struct adis_instr {
+    uint32_t op;
+    uint16_t id;
+    uint8_t cls;
+    uint8_t cond;
+};
+
+int get_instr_class(uint32_t op);
+char *get_class_string(int cls);
+int get_class_by_name(const char *name);
+char *get_opcode_string(int id);
+
+void decode_instr(uint32_t op, struct adis_instr *in);
+
+// Value of the immediate operand (branch offsets in bytes), 0 if none
+int32_t get_instr_imm(const struct adis_instr *in);
+
+/*
+ * Both append to the output buffer of the calling thread and return 0
+ * if the word isn't a recognized instruction.
+ */
+int disasm_instr(uint32_t op);
+int disasm_line(uint32_t op, uint32_t addr);
+
+// Same as above for words that were already classified
+int disasm_decoded(const struct adis_instr *in);
+int disasm_decoded_line(const struct adis_instr *in, uint32_t addr);
+
+#endif  // __ADIS_DECODE_H__
@@ -0,0 +1,465 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diff.h"
+#include "branch.h"
+#include "decode.h"
+#include "predicates.h"
+#include "common.h"
+
+// Words per hashed window; any common run of twice this is found
+#define ADIS_DIFF_WINDOW        8
+#define ADIS_DIFF_BASE          0x100000001B3ULL
+
+// Give up on a hash bucket after this many false candidates
+#define ADIS_DIFF_MAX_PROBES    16
+
+struct diff_anchor {
+    uint64_t hash;
+    size_t pos;
+};
+
+// old[old .. old + len) lines up with new[new .. new + len)
+struct diff_seg {
+    size_t old;
+    size_t new;
+    size_t len;
+};
+
+struct diff_hunk {
+    size_t old_start;
+    size_t old_end;
+    size_t new_start;
+    size_t new_end;
+};
+
+struct diff_state {
+    const struct adis_image *old;
+    const struct adis_image *new;
+    size_t nold;
+    size_t nnew;
+    struct diff_anchor *anchors;
+    size_t nanchors;
+    struct diff_seg *segs;
+    size_t nsegs;
+    size_t segs_size;
+    struct diff_hunk *hunks;
+    size_t nhunks;
+    size_t hunks_size;
+};
+
+static inline uint32_t word_at(const struct adis_image *img, size_t idx)
+{
+    return image_word(img, idx * 4);
+}
+
+// What has to match for two words to line up
+static inline uint32_t diff_key(uint32_t op)
+{
+    // branch offsets depend on where the code around them ended up
+    return is_branch(op) ? op & 0xFF000000 : op;
+}
+
+static inline int key_eq(const struct diff_state *d, size_t o, size_t n)
+{
+    return diff_key(word_at(d->old, o)) == diff_key(word_at(d->new, n));
+}
+
+static uint64_t window_hash(const struct adis_image *img, size_t pos)
+{
+    uint64_t h = 0;
+    size_t i;
+
+    for (i = 0; i < ADIS_DIFF_WINDOW; i++) {
+        h = h * ADIS_DIFF_BASE + diff_key(word_at(img, pos + i));
+    }
+
+    return h;
+}
+
+static int anchor_cmp(const void *a, const void *b)
+{
+    const struct diff_anchor *x = a, *y = b;
+
+    if (x->hash != y->hash) {
+        return x->hash < y->hash ? -1 : 1;
+    }
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+// Hash the old image at every window boundary
+static int diff_index(struct diff_state *d)
+{
+    size_t pos;
+
+    d->nanchors = d->nold / ADIS_DIFF_WINDOW;
+    d->anchors = malloc(sizeof(*d->anchors) * (d->nanchors + 1));
+    if (d->anchors == NULL) {
+        return 0;
+    }
+
+    for (pos = 0; pos < d->nanchors; pos++) {
+        d->anchors[pos].hash = window_hash(d->old, pos * ADIS_DIFF_WINDOW);
+        d->anchors[pos].pos = pos * ADIS_DIFF_WINDOW;
+    }
+
+    qsort(d->anchors, d->nanchors, sizeof(*d->anchors), anchor_cmp);
+    return 1;
+}
+
+// First old window at or after from that equals new[n ..], or -1
+static size_t diff_lookup(const struct diff_state *d, uint64_t hash,
+    size_t from, size_t n)
+{
+    struct diff_anchor key = { hash, from };
+    size_t lo = 0, hi = d->nanchors, mid, i, probes;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (anchor_cmp(&d->anchors[mid], &key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (probes = 0; lo < d->nanchors && d->anchors[lo].hash == hash &&
+         probes < ADIS_DIFF_MAX_PROBES; lo++, probes++) {
+        for (i = 0; i < ADIS_DIFF_WINDOW; i++) {
+            if (!key_eq(d, d->anchors[lo].pos + i, n + i)) {
+                break;
+            }
+        }
+        if (i == ADIS_DIFF_WINDOW) {
+            return d->anchors[lo].pos;
+        }
+    }
+
+    return (size_t)-1;
+}
+
+static int seg_push(struct diff_state *d, size_t o, size_t n, size_t len)
+{
+    struct diff_seg *tmp;
+
+    if (d->nsegs == d->segs_size) {
+        d->segs_size = d->segs_size ? d->segs_size * 2 : 256;
+        tmp = realloc(d->segs, sizeof(*tmp) * d->segs_size);
+        if (tmp == NULL) {
+            return 0;
+        }
+        d->segs = tmp;
+    }
+
+    d->segs[d->nsegs].old = o;
+    d->segs[d->nsegs].new = n;
+    d->segs[d->nsegs].len = len;
+    d->nsegs++;
+    return 1;
+}
+
+/*
+ * Walk both images, taking common runs as they come. On a mismatch,
+ * roll a window hash over the new image until a window also appears in
+ * the old one past the current position, then extend that match back
+ * towards the mismatch. Whatever is skipped on either side has changed.
+ *
+ * Repeated code means the first window found may line up with a copy
+ * far ahead, so the search goes on for one more window stride (by then
+ * the nearest true match has shown up) and keeps the candidate that
+ * skips the fewest words.
+ */
+static int diff_align(struct diff_state *d)
+{
+    size_t o = 0, n = 0, so, sn, m, p, limit, best_p, best_m, cost, best;
+    uint64_t h, top = 1;
+    int i;
+
+    for (i = 1; i < ADIS_DIFF_WINDOW; i++) {
+        top *= ADIS_DIFF_BASE;
+    }
+
+    while (o < d->nold && n < d->nnew) {
+        if (key_eq(d, o, n)) {
+            for (so = o, sn = n; o < d->nold && n < d->nnew &&
+                 key_eq(d, o, n); o++, n++)
+                ;
+            if (!seg_push(d, so, sn, o - so)) {
+                return 0;
+            }
+            continue;
+        }
+
+        if (d->nnew - n < ADIS_DIFF_WINDOW) {
+            break;
+        }
+
+        // identical images never need the index
+        if (d->anchors == NULL && !diff_index(d)) {
+            return 0;
+        }
+
+        h = window_hash(d->new, n);
+        best = (size_t)-1;
+        best_p = best_m = 0;
+        limit = (size_t)-1;
+
+        for (m = n; m < limit; m++) {
+            p = diff_lookup(d, h, o, m);
+            if (p != (size_t)-1 && (cost = (p - o) + (m - n)) < best) {
+                best = cost;
+                best_p = p;
+                best_m = m;
+                limit = ADIS_MIN(limit, m + ADIS_DIFF_WINDOW);
+            }
+
+            if (m + ADIS_DIFF_WINDOW >= d->nnew) {
+                break;
+            }
+            h = (h - top * diff_key(word_at(d->new, m))) * ADIS_DIFF_BASE +
+                diff_key(word_at(d->new, m + ADIS_DIFF_WINDOW));
+        }
+
+        if (best == (size_t)-1) {
+            break;
+        }
+
+        p = best_p;
+        m = best_m;
+        for (; p > o && m > n && key_eq(d, p - 1, m - 1); p--, m--)
+            ;
+
+        o = p;
+        n = m;
+    }
+
+    return 1;
+}
+
+static int hunk_push(struct diff_state *d, size_t os, size_t oe, size_t ns,
+    size_t ne)
+{
+    struct diff_hunk *h, *tmp;
+
+    // extend the previous hunk if this one follows on directly
+    if (d->nhunks > 0) {
+        h = &d->hunks[d->nhunks - 1];
+        if (h->old_end == os && h->new_end == ns) {
+            h->old_end = oe;
+            h->new_end = ne;
+            return 1;
+        }
+    }
+
+    if (d->nhunks == d->hunks_size) {
+        d->hunks_size = d->hunks_size ? d->hunks_size * 2 : 256;
+        tmp = realloc(d->hunks, sizeof(*tmp) * d->hunks_size);
+        if (tmp == NULL) {
+            return 0;
+        }
+        d->hunks = tmp;
+    }
+
+    h = &d->hunks[d->nhunks++];
+    h->old_start = os;
+    h->old_end = oe;
+    h->new_start = ns;
+    h->new_end = ne;
+    return 1;
+}
+
+// Does the old branch target correspond to the new one?
+static int targets_match(const struct diff_state *d, uint32_t to,
+    uint32_t tn)
+{
+    size_t idx = to / 4, lo = 0, hi = d->nsegs, mid;
+    const struct diff_seg *s;
+
+    if (idx >= d->nold) {
+        // outside the image, nothing moved there
+        return to == tn;
+    }
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (d->segs[mid].old + d->segs[mid].len <= idx) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == d->nsegs || d->segs[lo].old > idx) {
+        return 0;
+    }
+
+    s = &d->segs[lo];
+    return (uint64_t)tn == (uint64_t)(s->new + idx - s->old) * 4;
+}
+
+static int diff_hunks(struct diff_state *d)
+{
+    size_t i, k, po = 0, pn = 0;
+    const struct diff_seg *s;
+    uint32_t a, b;
+
+    for (i = 0; i < d->nsegs; i++) {
+        s = &d->segs[i];
+        if ((po < s->old || pn < s->new) &&
+            !hunk_push(d, po, s->old, pn, s->new)) {
+            return 0;
+        }
+
+        for (k = 0; k < s->len; k++) {
+            a = word_at(d->old, s->old + k);
+            b = word_at(d->new, s->new + k);
+            if (a != b && !targets_match(d,
+                    branch_target(a, (s->old + k) * 4),
+                    branch_target(b, (s->new + k) * 4)) &&
+                !hunk_push(d, s->old + k, s->old + k + 1, s->new + k,
+                    s->new + k + 1)) {
+                return 0;
+            }
+        }
+
+        po = s->old + s->len;
+        pn = s->new + s->len;
+    }
+
+    if (po < d->nold || pn < d->nnew) {
+        return hunk_push(d, po, d->nold, pn, d->nnew);
+    }
+
+    return 1;
+}
+
+struct diff_out {
+    struct adis_buffer out;
+    struct adis_buffer line;
+    FILE *fp;
+};
+
+// Render one word and prefix each of its lines
+static void diff_word(struct diff_out *o, char prefix,
+    const struct adis_image *img, size_t idx)
+{
+    struct adis_buffer *prev;
+    const char *p, *end, *nl;
+    size_t len;
+
+    o->line.len = 0;
+    prev = set_output_buffer(&o->line);
+    disasm_line(word_at(img, idx), idx * 4);
+    set_output_buffer(prev);
+
+    for (p = o->line.data, end = p + o->line.len; p < end; p += len) {
+        nl = memchr(p, '\n', end - p);
+        len = nl != NULL ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+        buffer_write(&o->out, &prefix, 1);
+        buffer_write(&o->out, p, len);
+    }
+
+    if (o->out.len >= ADIS_FLUSH_SIZE) {
+        buffer_flush(&o->out, o->fp);
+    }
+}
+
+static void diff_range(struct diff_out *o, char prefix,
+    const struct adis_image *img, size_t start, size_t end)
+{
+    for (; start < end; start++) {
+        diff_word(o, prefix, img, start);
+    }
+}
+
+static void diff_print(const struct diff_state *d, size_t context, FILE *fp)
+{
+    const struct diff_hunk *h, *first, *last;
+    size_t i, j, lead, trail;
+    struct diff_out o;
+
+    buffer_init(&o.out);
+    buffer_init(&o.line);
+    o.fp = fp;
+
+    for (i = 0; i < d->nhunks; i = j + 1) {
+        // hunks whose context would touch are printed together
+        for (j = i; j + 1 < d->nhunks &&
+             d->hunks[j + 1].old_start - d->hunks[j].old_end <= 2 * context;
+             j++)
+            ;
+
+        first = &d->hunks[i];
+        last = &d->hunks[j];
+        lead = ADIS_MIN(context, first->new_start);
+        trail = ADIS_MIN(context, d->nnew - last->new_end);
+
+        buffer_printf(&o.out, "@@ -0x%.8zX,%zu +0x%.8zX,%zu @@\n",
+            (first->old_start - lead) * 4,
+            last->old_end + trail - (first->old_start - lead),
+            (first->new_start - lead) * 4,
+            last->new_end + trail - (first->new_start - lead));
+
+        diff_range(&o, ' ', d->new, first->new_start - lead, first->new_start);
+
+        for (h = first; h <= last; h++) {
+            diff_range(&o, '-', d->old, h->old_start, h->old_end);
+            diff_range(&o, '+', d->new, h->new_start, h->new_end);
+            if (h < last) {
+                diff_range(&o, ' ', d->new, h->new_end, h[1].new_start);
+            }
+        }
+
+        diff_range(&o, ' ', d->new, last->new_end, last->new_end + trail);
+    }
+
+    buffer_flush(&o.out, fp);
+    buffer_free(&o.out);
+    buffer_free(&o.line);
+}
+
+int diff_images(const struct adis_image *old, const struct adis_image *new,
+    size_t context, FILE *fp)
+{
+    struct diff_state d;
+    int ret = -1;
+
+    memset(&d, 0, sizeof(d));
+    d.old = old;
+    d.new = new;
+    d.nold = image_words_size(old) / 4;
+    d.nnew = image_words_size(new) / 4;
+
+    if (!diff_align(&d) || !diff_hunks(&d)) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        goto out;
+    }
+
+    diff_print(&d, context, fp);
+    ret = d.nhunks > 0;
+
+out:
+    free(d.anchors);
+    free(d.segs);
+    free(d.hunks);
+    return ret;
+}
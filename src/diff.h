@@ -0,0 +1,41 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_DIFF_H__
+#define __ADIS_DIFF_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "image.h"
+
+/*
+ * Instruction-level diff of two images. The word streams are aligned on
+ * windows of words whose rolling hashes match, with branch offsets
+ * masked out, and a branch only counts as changed if its target doesn't
+ * line up with the other side's target under that alignment. Changed
+ * regions are printed as hunks of disassembly with context words around
+ * them, in the style of a unified diff.
+ *
+ * Returns 0 if the images are the same, 1 if they differ and -1 on
+ * error, like diff(1).
+ */
+int diff_images(const struct adis_image *old, const struct adis_image *new,
+    size_t context, FILE *fp);
+
+#endif  // __ADIS_DIFF_H__
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 
 #include "dt_block.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_INIT_ALLOC 16
@@ -29,16 +30,16 @@
 static char *get_addr_mode_string(uint32_t op)
 {
     static char *addr_mode[4] = { "DA", "IA", "DB", "IB" };
-    return addr_mode[ADIS_ADDOFFSET_BIT(op) | (ADIS_PREINDEX_BIT(op) << 1)];
+    return addr_mode[(ADIS_ADDOFFSET_BIT(op) >> 23) | (ADIS_PREINDEX_BIT(op) >> 23)];
 }
 
 static void get_register_list_string(uint32_t op, char **buffer)
 {
-    char *ret = malloc(sizeof(char)*ADIS_INIT_ALLOC);
+    char *ret = malloc(sizeof(char)*ADIS_INIT_ALLOC), *tmp;
     uint32_t pos = 0, max = ADIS_INIT_ALLOC, before = 0, i = 0;
 
     if (ret == NULL) {
-        printf("BDT: Failed to allocate memory.\n");
+        adis_printf("BDT: Failed to allocate memory.\n");
         return;
     }
 
@@ -46,14 +47,18 @@ static void get_register_list_string(uint32_t op, char **buffer)
     op &= 0x0000FFFF;
     ret[0] = '{';
 
+    // room for the next register, the closing brace and the terminator
     for ( ; (i < 16) && (op > 0); i++) {
-        if ((pos + sizeof("Rxx,") + 1) >= max) {
+        if ((pos + sizeof("-Rxx,") + 2) >= max) {
             // reallocate
             max *= 2;
-            if (realloc(ret, sizeof(char)*max) == NULL) {
-                printf("BDT: Failed to allocate memory.\n");
+            tmp = realloc(ret, sizeof(char)*max);
+            if (tmp == NULL) {
+                adis_printf("BDT: Failed to allocate memory.\n");
+                free(ret);
                 return;
             }
+            ret = tmp;
         }
 
         if ((op & 0x00000001) && !before) {
@@ -71,6 +76,7 @@ static void get_register_list_string(uint32_t op, char **buffer)
     }
 
     ret[pos] = '}';
+    ret[pos + 1] = 0;
     *buffer = ret;
 }
 
@@ -80,7 +86,7 @@ void dt_block_instr(uint32_t op)
 
     get_register_list_string(op, &r_list);
     if (r_list == NULL) {
-        printf("ADIS_ERROR: Out of memory\n");
+        adis_printf("ADIS_ERROR: Out of memory\n");
         return;
     }
 
@@ -90,12 +96,17 @@ void dt_block_instr(uint32_t op)
     wb = ADIS_WRITE_BIT(op) ? '!' : 0;
 
     if (ADIS_LOAD_BIT(op)) {
-        printf("LDR%s%s R%d%c,%s%c\n", cond, addr_mode, ADIS_RN(op), wb,
+        adis_printf("LDR%s%s R%d%c,%s%c\n", cond, addr_mode, ADIS_RN(op), wb,
             r_list, psr);
     } else {
-        printf("STM%s%s R%d%c,%s%c\n", cond, addr_mode, ADIS_RN(op), wb,
+        adis_printf("STM%s%s R%d%c,%s%c\n", cond, addr_mode, ADIS_RN(op), wb,
             r_list, psr);
     }
 
     free(r_list);
 }
+
+int dt_block_opcode(uint32_t op)
+{
+    return ADIS_LOAD_BIT(op) ? ADIS_OP_LDM : ADIS_OP_STM;
+}
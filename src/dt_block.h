@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void dt_block_instr(uint32_t op);
+int dt_block_opcode(uint32_t op);
 
 #endif  // __ADIS_DT_BLOCK_H__
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 
 #include "dt_coproc.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_LONG_BIT(_op)      (_op & 0x00400000)
@@ -41,10 +42,15 @@ void dt_coproc_instr(uint32_t op) {
 
     // load / store
     if (ADIS_LOAD_BIT(op)) {
-        printf("LDC%s%c p%d,c%d,%s\n", cond, long_bit,
+        adis_printf("LDC%s%c p%d,c%d,%s\n", cond, long_bit,
             ADIS_CPNUM(op), ADIS_RD(op), addr);
     } else {
-        printf("STC%s%c p%d,c%d,%s\n", cond, long_bit,
+        adis_printf("STC%s%c p%d,c%d,%s\n", cond, long_bit,
             ADIS_CPNUM(op), ADIS_RD(op), addr);
     }
 }
+
+int dt_coproc_opcode(uint32_t op)
+{
+    return ADIS_LOAD_BIT(op) ? ADIS_OP_LDC : ADIS_OP_STC;
+}
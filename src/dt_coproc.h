@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void dt_coproc_instr(uint32_t op);
+int dt_coproc_opcode(uint32_t op);
 
 #endif  // __ADIS_DT_COPROC_H__
@@ -21,6 +21,7 @@
 
 #include "dt_extra.h"
 #include "sync.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_HW_BIT(_op)            (_op & 0x00000020)
@@ -75,8 +76,29 @@ have_subinstr:
     get_addr_string(op, ADIS_RN(op), offset, addr, sizeof(addr));
 
     if (ADIS_LOAD_BIT(op)) {
-        printf("LDR%s%c%s R%d,%s\n", subinstr, unpriv, cond, ADIS_RD(op), addr);
+        adis_printf("LDR%s%c%s R%d,%s\n", subinstr, unpriv, cond, ADIS_RD(op), addr);
     } else {
-        printf("STR%s%c%s R%d,%s\n", subinstr, unpriv, cond, ADIS_RD(op), addr);
+        adis_printf("STR%s%c%s R%d,%s\n", subinstr, unpriv, cond, ADIS_RD(op), addr);
     }
 }
+
+int dt_extra_opcode(uint32_t op)
+{
+    int opc;
+
+    if (is_dt_dual(op)) {
+        // both are L=0, a store has bit 5 set
+        return ADIS_HW_BIT(op) ? ADIS_OP_STRD : ADIS_OP_LDRD;
+    } else if (!ADIS_HW_BIT(op) && !ADIS_SIGNED_BIT(op)) {
+        return sync_opcode(op);
+    } else if (ADIS_HW_BIT(op) && ADIS_SIGNED_BIT(op)) {
+        opc = ADIS_OP_LDRSH;
+    } else if (!ADIS_HW_BIT(op) && ADIS_SIGNED_BIT(op)) {
+        opc = ADIS_OP_LDRSB;
+    } else {
+        opc = ADIS_OP_LDRH;
+    }
+
+    // every store ID follows its load ID
+    return opc + (ADIS_LOAD_BIT(op) ? 0 : 1);
+}
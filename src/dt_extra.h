@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void dt_extra_instr(uint32_t op);
+int dt_extra_opcode(uint32_t op);
 
 #endif  // __ADIS_DT_EXTRA_H__
@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "dt_single.h"
+#include "opcodes.h"
 #include "common.h"
 
 void dt_single_instr(uint32_t op)
@@ -33,8 +34,14 @@ void dt_single_instr(uint32_t op)
 
     // load / store
     if (ADIS_LOAD_BIT(op)) {
-        printf("LDR%s%c R%d,%s\n", cond, tsize, ADIS_RD(op), addr);
+        adis_printf("LDR%s%c R%d,%s\n", cond, tsize, ADIS_RD(op), addr);
     } else {
-        printf("STR%s%c R%d,%s\n", cond, tsize, ADIS_RD(op), addr);
+        adis_printf("STR%s%c R%d,%s\n", cond, tsize, ADIS_RD(op), addr);
     }
 }
+
+int dt_single_opcode(uint32_t op)
+{
+    return ADIS_OP_LDR + (ADIS_BYTE_BIT(op) ? 2 : 0) +
+        (ADIS_LOAD_BIT(op) ? 0 : 1);
+}
@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void dt_single_instr(uint32_t op);
+int dt_single_opcode(uint32_t op);
 
 #endif  // __ADIS_DT_SINGLE_H__
@@ -0,0 +1,262 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "common.h"
+
+#define ADIS_ELFCLASS32     1
+#define ADIS_ELFDATA2LSB    1
+#define ADIS_ELFDATA2MSB    2
+#define ADIS_EM_ARM         40
+
+#define ADIS_PT_LOAD        1
+#define ADIS_PF_X           0x1
+
+#define ADIS_SHT_SYMTAB     2
+#define ADIS_STT_NOTYPE     0
+#define ADIS_STT_FUNC       2
+
+// Offsets into the ELF32 header, program header, section header and symbol
+#define ADIS_EH_ENTRY       24
+#define ADIS_EH_PHOFF       28
+#define ADIS_EH_SHOFF       32
+#define ADIS_EH_PHENTSIZE   42
+#define ADIS_EH_PHNUM       44
+#define ADIS_EH_SHENTSIZE   46
+#define ADIS_EH_SHNUM       48
+#define ADIS_EH_SIZE        52
+
+#define ADIS_PH_TYPE        0
+#define ADIS_PH_OFFSET      4
+#define ADIS_PH_VADDR       8
+#define ADIS_PH_FILESZ      16
+#define ADIS_PH_FLAGS       24
+
+#define ADIS_SH_TYPE        4
+#define ADIS_SH_OFFSET      16
+#define ADIS_SH_SIZE        20
+#define ADIS_SH_LINK        24
+#define ADIS_SH_ENTSIZE     36
+
+#define ADIS_SYM_NAME       0
+#define ADIS_SYM_VALUE      4
+#define ADIS_SYM_INFO       12
+#define ADIS_SYM_SHNDX      14
+#define ADIS_SYM_SIZE       16
+
+struct elf_reader {
+    const uint8_t *data;
+    size_t size;
+    int little_endian;
+};
+
+static uint32_t rd32(const struct elf_reader *r, size_t off)
+{
+    const uint8_t *p = r->data + off;
+
+    if (r->little_endian) {
+        return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+               ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+    }
+
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint16_t rd16(const struct elf_reader *r, size_t off)
+{
+    const uint8_t *p = r->data + off;
+    return r->little_endian ? (p[1] << 8) | p[0] : (p[0] << 8) | p[1];
+}
+
+// Is [off, off + len) inside the file?
+static int in_file(const struct elf_reader *r, uint64_t off, uint64_t len)
+{
+    return off <= r->size && len <= r->size - off;
+}
+
+int is_elf(const struct adis_image *img)
+{
+    return img->size >= ADIS_EH_SIZE && !memcmp(img->data, "\x7F" "ELF", 4);
+}
+
+static int elf_add_symbol(struct adis_elf *elf, uint32_t addr, size_t *max)
+{
+    uint32_t *tmp;
+
+    if (elf->nsymbols == *max) {
+        *max = *max ? *max * 2 : 64;
+        tmp = realloc(elf->symbols, sizeof(*tmp) * *max);
+        if (tmp == NULL) {
+            return 0;
+        }
+        elf->symbols = tmp;
+    }
+
+    elf->symbols[elf->nsymbols++] = addr;
+    return 1;
+}
+
+static int elf_load_symbols(struct adis_elf *elf, const struct elf_reader *r)
+{
+    uint32_t shoff = rd32(r, ADIS_EH_SHOFF), sh, str, off, size, i;
+    uint16_t shentsize = rd16(r, ADIS_EH_SHENTSIZE);
+    uint16_t shnum = rd16(r, ADIS_EH_SHNUM), s;
+    uint32_t value, name, stroff = 0, strsize = 0;
+    const char *sym_name;
+    size_t max = 0;
+    uint8_t type;
+
+    if (shoff == 0 || shentsize < 40 ||
+        !in_file(r, shoff, (uint64_t)shentsize * shnum)) {
+        return 1;
+    }
+
+    for (s = 0; s < shnum; s++) {
+        sh = shoff + s * shentsize;
+        if (rd32(r, sh + ADIS_SH_TYPE) != ADIS_SHT_SYMTAB) {
+            continue;
+        }
+
+        off = rd32(r, sh + ADIS_SH_OFFSET);
+        size = rd32(r, sh + ADIS_SH_SIZE);
+        if (!in_file(r, off, size) ||
+            rd32(r, sh + ADIS_SH_ENTSIZE) != ADIS_SYM_SIZE) {
+            continue;
+        }
+
+        // the linked string table, only needed for mapping symbols
+        str = rd32(r, sh + ADIS_SH_LINK);
+        if (str < shnum) {
+            stroff = rd32(r, shoff + str * shentsize + ADIS_SH_OFFSET);
+            strsize = rd32(r, shoff + str * shentsize + ADIS_SH_SIZE);
+            if (!in_file(r, stroff, strsize)) {
+                strsize = 0;
+            }
+        }
+
+        for (i = 0; i + ADIS_SYM_SIZE <= size; i += ADIS_SYM_SIZE) {
+            value = rd32(r, off + i + ADIS_SYM_VALUE);
+            name = rd32(r, off + i + ADIS_SYM_NAME);
+            type = r->data[off + i + ADIS_SYM_INFO] & 0xF;
+
+            if (rd16(r, off + i + ADIS_SYM_SHNDX) == 0 || (value & 1)) {
+                // undefined, or Thumb code
+                continue;
+            }
+
+            if (type == ADIS_STT_NOTYPE && name < strsize &&
+                strsize - name > 2) {
+                sym_name = (const char *)r->data + stroff + name;
+                if (sym_name[0] != '$' || sym_name[1] != 'a' ||
+                    (sym_name[2] != 0 && sym_name[2] != '.')) {
+                    continue;
+                }
+            } else if (type != ADIS_STT_FUNC) {
+                continue;
+            }
+
+            if (!elf_add_symbol(elf, value & ~3U, &max)) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+int elf_load(struct adis_elf *elf, const struct adis_image *img)
+{
+    struct elf_reader r;
+    uint32_t phoff, ph, off, size, i;
+    uint16_t phentsize, phnum;
+    struct image_region *reg;
+
+    memset(elf, 0, sizeof(*elf));
+
+    if (!is_elf(img) || img->data[4] != ADIS_ELFCLASS32 ||
+        (img->data[5] != ADIS_ELFDATA2LSB &&
+         img->data[5] != ADIS_ELFDATA2MSB)) {
+        fprintf(stderr, "ADIS_ERROR: Not a 32-bit ELF file\n");
+        return 0;
+    }
+
+    r.data = img->data;
+    r.size = img->size;
+    r.little_endian = img->data[5] == ADIS_ELFDATA2LSB;
+
+    if (rd16(&r, 18) != ADIS_EM_ARM) {
+        fprintf(stderr, "ADIS_ERROR: Not an ARM ELF file\n");
+        return 0;
+    }
+
+    elf->entry = rd32(&r, ADIS_EH_ENTRY);
+    phoff = rd32(&r, ADIS_EH_PHOFF);
+    phentsize = rd16(&r, ADIS_EH_PHENTSIZE);
+    phnum = rd16(&r, ADIS_EH_PHNUM);
+
+    if (phentsize < 32 || !in_file(&r, phoff, (uint64_t)phentsize * phnum)) {
+        fprintf(stderr, "ADIS_ERROR: Bad ELF program headers\n");
+        return 0;
+    }
+
+    elf->regions = calloc(phnum ? phnum : 1, sizeof(*elf->regions));
+    if (elf->regions == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    for (i = 0; i < phnum; i++) {
+        ph = phoff + i * phentsize;
+        if (rd32(&r, ph + ADIS_PH_TYPE) != ADIS_PT_LOAD ||
+            !(rd32(&r, ph + ADIS_PH_FLAGS) & ADIS_PF_X)) {
+            continue;
+        }
+
+        off = rd32(&r, ph + ADIS_PH_OFFSET);
+        size = rd32(&r, ph + ADIS_PH_FILESZ);
+        if (!in_file(&r, off, 0)) {
+            continue;
+        }
+
+        reg = &elf->regions[elf->nregions++];
+        reg->data = img->data + off;
+        reg->addr = rd32(&r, ph + ADIS_PH_VADDR);
+        reg->size = ADIS_MIN((size_t)size, img->size - off);
+        reg->little_endian = r.little_endian;
+    }
+
+    if (!elf_load_symbols(elf, &r)) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        elf_free(elf);
+        return 0;
+    }
+
+    return 1;
+}
+
+void elf_free(struct adis_elf *elf)
+{
+    free(elf->regions);
+    free(elf->symbols);
+    memset(elf, 0, sizeof(*elf));
+}
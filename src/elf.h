@@ -0,0 +1,44 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_ELF_H__
+#define __ADIS_ELF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/*
+ * Just enough of 32-bit ARM ELF files to find the code: the executable
+ * segments, the entry point and the addresses of ARM code symbols
+ * (functions and $a mapping symbols). Thumb symbols are left out.
+ */
+struct adis_elf {
+    uint32_t entry;
+    struct image_region *regions;
+    size_t nregions;
+    uint32_t *symbols;
+    size_t nsymbols;
+};
+
+int is_elf(const struct adis_image *img);
+int elf_load(struct adis_elf *elf, const struct adis_image *img);
+void elf_free(struct adis_elf *elf);
+
+#endif  // __ADIS_ELF_H__
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "follow.h"
+
+#define ADIS_FOLLOW_EVENTS  (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                             IN_DELETE_SELF | IN_MOVE_SELF)
+
+int follow_open(struct adis_follow *f, const char *path)
+{
+    struct stat st;
+
+    f->path = path;
+    f->off = 0;
+    f->gone = 0;
+
+    if ((f->fd = open(path, O_RDONLY)) < 0) {
+        perror(path);
+        return 0;
+    } else if (fstat(f->fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "ADIS_ERROR: %s: --follow needs a regular file\n",
+            path);
+        close(f->fd);
+        return 0;
+    }
+
+    // watching before the first size check means no growth is missed
+    if ((f->inotify = inotify_init1(IN_CLOEXEC)) < 0 ||
+        inotify_add_watch(f->inotify, path, ADIS_FOLLOW_EVENTS) < 0) {
+        perror("inotify");
+        if (f->inotify >= 0) {
+            close(f->inotify);
+        }
+        close(f->fd);
+        return 0;
+    }
+
+    return 1;
+}
+
+void follow_close(struct adis_follow *f)
+{
+    close(f->inotify);
+    close(f->fd);
+}
+
+// Block until something happens to the file
+static int follow_wait(struct adis_follow *f)
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    ssize_t n, i;
+
+    do {
+        n = read(f->inotify, events, sizeof(events));
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        perror("inotify");
+        return 0;
+    }
+
+    for (i = 0; i < n; i += sizeof(*ev) + ev->len) {
+        ev = (const struct inotify_event *)(events + i);
+        if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+            f->gone = 1;
+        }
+    }
+
+    return 1;
+}
+
+ssize_t follow_read(struct adis_follow *f, uint8_t *buf, size_t size)
+{
+    struct stat st;
+    uint64_t avail;
+    ssize_t n;
+
+    for (;;) {
+        if (fstat(f->fd, &st) < 0) {
+            perror(f->path);
+            return -1;
+        }
+
+        // unlinked files stay readable through fd, but won't grow
+        if (st.st_nlink == 0) {
+            f->gone = 1;
+        }
+
+        if ((uint64_t)st.st_size < f->off) {
+            fprintf(stderr, "adis: %s: file truncated, starting over\n",
+                f->path);
+            f->off = 0;
+        }
+
+        avail = ((uint64_t)st.st_size - f->off) & ~(uint64_t)3;
+        if (avail == 0) {
+            if (f->gone) {
+                return 0;
+            } else if (!follow_wait(f)) {
+                return -1;
+            }
+            continue;
+        }
+
+        do {
+            n = pread(f->fd, buf, avail < size ? avail : size & ~(size_t)3,
+                f->off);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0) {
+            perror(f->path);
+            return -1;
+        }
+
+        // less than asked for if the file was truncated in between
+        n &= ~(ssize_t)3;
+        if (n > 0) {
+            f->off += n;
+            return n;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_FOLLOW_H__
+#define __ADIS_FOLLOW_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Most new data handed out by one follow_read in the tools
+#define ADIS_FOLLOW_CHUNK   (256 * 1024)
+
+/*
+ * Reads a file that is still being appended to, like tail -f. Growth is
+ * waited for with inotify, and only whole instruction words are handed
+ * out, so a word that is half written is picked up once it's complete.
+ * off is the file offset (and address) of the next word.
+ */
+struct adis_follow {
+    const char *path;
+    int fd;
+    int inotify;
+    uint64_t off;
+    int gone;
+};
+
+int follow_open(struct adis_follow *f, const char *path);
+void follow_close(struct adis_follow *f);
+
+/*
+ * Read up to size bytes of new whole words into buf, waiting for the file
+ * to grow if there are none. Returns 0 once the file was deleted or moved
+ * away and everything written to it was read, -1 on error. If the file
+ * was truncated, reading starts over from its beginning.
+ */
+ssize_t follow_read(struct adis_follow *f, uint8_t *buf, size_t size);
+
+#endif  // __ADIS_FOLLOW_H__
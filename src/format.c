@@ -0,0 +1,212 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+#include <strings.h>
+
+#include "common.h"
+#include "format.h"
+#include "regs.h"
+
+// Rendered text of a single instruction, to pick the operands out of
+static __thread struct adis_buffer scratch;
+
+int get_format_by_name(const char *name)
+{
+    if (strcasecmp(name, "text") == 0) {
+        return ADIS_FORMAT_TEXT;
+    } else if (strcasecmp(name, "jsonl") == 0) {
+        return ADIS_FORMAT_JSONL;
+    } else if (strcasecmp(name, "bin") == 0) {
+        return ADIS_FORMAT_BIN;
+    }
+
+    return -1;
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+void format_begin(int format)
+{
+    uint8_t hdr[sizeof(struct format_header)];
+
+    if (format != ADIS_FORMAT_BIN) {
+        return;
+    }
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, ADIS_FORMAT_MAGIC, sizeof(ADIS_FORMAT_MAGIC));
+    put_le32(hdr + 8, ADIS_FORMAT_VERSION);
+    put_le32(hdr + 12, sizeof(struct format_record));
+    buffer_write(get_output_buffer(), hdr, sizeof(hdr));
+}
+
+static int format_bin(const struct adis_instr *in, uint32_t addr)
+{
+    uint8_t rec[sizeof(struct format_record)];
+    struct adis_regs regs;
+
+    get_instr_regs(in, &regs);
+
+    put_le32(rec, addr);
+    put_le32(rec + 4, in->op);
+    put_le16(rec + 8, in->id);
+    rec[10] = in->cls;
+    rec[11] = in->cond;
+    put_le32(rec + 12, get_instr_imm(in));
+    put_le16(rec + 16, regs.read);
+    put_le16(rec + 18, regs.write);
+    rec[20] = regs.flags_read;
+    rec[21] = regs.flags_write;
+    put_le16(rec + 22, 0);
+
+    buffer_write(get_output_buffer(), rec, sizeof(rec));
+    return in->cls != ADIS_CLASS_UNKNOWN;
+}
+
+// Decimal digits of v, written backwards from end
+static char *put_dec(char *end, uint32_t v)
+{
+    do {
+        *--end = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+
+    return end;
+}
+
+static void put_field(struct adis_buffer *out, const char *name, uint32_t v)
+{
+    char digits[10], *p = put_dec(digits + sizeof(digits), v);
+
+    buffer_write(out, name, strlen(name));
+    buffer_write(out, p, digits + sizeof(digits) - p);
+}
+
+// JSON string from len bytes of text, dropping NULs
+static void put_string(struct adis_buffer *out, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    char *p;
+    size_t i;
+
+    // worst case is every byte escaped as \u00XX
+    buffer_reserve(out, len * 6 + 2);
+    p = out->data + out->len;
+
+    *p++ = '"';
+    for (i = 0; i < len; i++) {
+        unsigned char c = s[i];
+
+        if (c == 0) {
+            continue;
+        } else if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (c < 0x20) {
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 0xF];
+            p += 6;
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+
+    out->len = p - out->data;
+}
+
+/*
+ * The operands are whatever the decoder printed after the mnemonic, which
+ * may have a NUL or a space in front of it.
+ */
+static void get_operands(const char *text, size_t len, size_t *start,
+    size_t *end)
+{
+    size_t i = 0;
+
+    while (i < len && text[i] != ' ' && text[i] != 0 && text[i] != '\n') {
+        i++;
+    }
+    while (i < len && (text[i] == ' ' || text[i] == 0)) {
+        i++;
+    }
+    *start = i;
+
+    while (i < len && text[i] != '\n') {
+        i++;
+    }
+    *end = i;
+}
+
+static int format_jsonl(const struct adis_instr *in, uint32_t addr)
+{
+    struct adis_buffer *out = get_output_buffer(), *prev;
+    const char *cls = get_class_string(in->cls);
+    const char *mnemonic = get_opcode_string(in->id);
+    const char *cond = get_condition_string(in->op);
+    size_t start = 0, end = 0;
+    int ret = 0;
+
+    if (in->cls != ADIS_CLASS_UNKNOWN) {
+        scratch.len = 0;
+        prev = set_output_buffer(&scratch);
+        ret = disasm_decoded(in);
+        set_output_buffer(prev);
+        get_operands(scratch.data, scratch.len, &start, &end);
+    }
+
+    put_field(out, "{\"addr\":", addr);
+    put_field(out, ",\"op\":", in->op);
+    buffer_write(out, ",\"class\":", 9);
+    put_string(out, cls, strlen(cls));
+    buffer_write(out, ",\"mnemonic\":", 12);
+    put_string(out, mnemonic, strlen(mnemonic));
+    buffer_write(out, ",\"cond\":", 8);
+    put_string(out, cond, strlen(cond));
+    buffer_write(out, ",\"operands\":", 12);
+    put_string(out, scratch.data + start, end - start);
+    buffer_write(out, "}\n", 2);
+
+    return ret;
+}
+
+int format_instr(int format, const struct adis_instr *in, uint32_t addr)
+{
+    switch (format) {
+    case ADIS_FORMAT_JSONL:
+        return format_jsonl(in, addr);
+    case ADIS_FORMAT_BIN:
+        return format_bin(in, addr);
+    default:
+        return disasm_decoded_line(in, addr);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_FORMAT_H__
+#define __ADIS_FORMAT_H__
+
+#include <stdint.h>
+
+#include "decode.h"
+
+#define ADIS_FORMAT_TEXT        0
+#define ADIS_FORMAT_JSONL       1
+#define ADIS_FORMAT_BIN         2
+
+/*
+ * --format=bin output is a format_header followed by one format_record
+ * per instruction word. All fields are little-endian regardless of the
+ * host, and records are fixed-size, so the record for the nth word is at
+ * sizeof(struct format_header) + n * record_size.
+ */
+#define ADIS_FORMAT_MAGIC       "ADISBIN"
+#define ADIS_FORMAT_VERSION     1
+
+struct format_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct format_record {
+    uint32_t addr;
+    uint32_t op;
+    uint16_t id;            // ADIS_OP_*
+    uint8_t cls;            // ADIS_CLASS_*
+    uint8_t cond;
+    int32_t imm;            // see get_instr_imm()
+    uint16_t regs_read;     // see regs.h
+    uint16_t regs_write;
+    uint8_t flags_read;
+    uint8_t flags_write;
+    uint16_t reserved;
+};
+
+// ADIS_FORMAT_* for a --format name, -1 if unknown
+int get_format_by_name(const char *name);
+
+// Whatever has to come before the first instruction
+void format_begin(int format);
+
+/*
+ * Append one instruction in the given format to the output buffer of the
+ * calling thread. Like disasm_decoded_line, returns 0 if the word isn't a
+ * recognized instruction; jsonl and bin still emit a record for it.
+ */
+int format_instr(int format, const struct adis_instr *in, uint32_t addr);
+
+#endif  // __ADIS_FORMAT_H__
@@ -0,0 +1,288 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "branch.h"
+#include "buffer.h"
+#include "common.h"
+#include "decode.h"
+#include "funcs.h"
+#include "opcodes.h"
+#include "pool.h"
+
+// Functions handed to the workers at once, bounded by their total size
+#define ADIS_FUNCS_BATCH_SIZE   (1024 * 1024)
+#define ADIS_FUNCS_BATCH_MAX    4096
+
+// A push this close after a BL target belongs to the same function
+#define ADIS_FUNCS_PUSH_SLACK   2
+
+struct func_task {
+    const struct adis_image *img;
+    struct func *fn;
+    int disasm;
+    struct adis_buffer out;
+};
+
+// Only the conditional space holds the instructions below
+static int is_cond(const struct adis_instr *in)
+{
+    return in->cls != ADIS_CLASS_UNKNOWN && in->cond != 0xF;
+}
+
+// STMDB SP!,{...,LR}
+static int is_push_lr(const struct adis_instr *in)
+{
+    return is_cond(in) && in->id == ADIS_OP_STM &&
+           (in->op & 0x01FF4000) == 0x012D4000;
+}
+
+// LDM with the PC in the list, BX LR, MOV PC,LR or LDR PC,[SP],#4
+static int is_return(const struct adis_instr *in)
+{
+    uint32_t op = in->op;
+
+    if (!is_cond(in)) {
+        return 0;
+    }
+
+    switch (in->id) {
+    case ADIS_OP_LDM:
+        return (op & 0x8000) != 0;
+    case ADIS_OP_BX:
+        return ADIS_RM(op) == 14;
+    case ADIS_OP_MOV:
+        return in->cls == ADIS_CLASS_DP_REG && (op & 0x000FFFFF) == 0xF00E;
+    case ADIS_OP_LDR:
+        return (op & 0x03FFFFFF) == 0x009DF004;
+    default:
+        return 0;
+    }
+}
+
+static int is_call(const struct adis_instr *in)
+{
+    return is_cond(in) && in->id == ADIS_OP_BL;
+}
+
+// 1 for loads, 2 for stores (single, extra and block transfers)
+static int get_transfer(const struct adis_instr *in)
+{
+    if (!is_cond(in)) {
+        return 0;
+    }
+
+    switch (in->id) {
+    case ADIS_OP_LDR:
+    case ADIS_OP_LDRB:
+    case ADIS_OP_LDM:
+    case ADIS_OP_LDRH:
+    case ADIS_OP_LDRSB:
+    case ADIS_OP_LDRSH:
+    case ADIS_OP_LDRD:
+        return 1;
+    case ADIS_OP_STR:
+    case ADIS_OP_STRB:
+    case ADIS_OP_STM:
+    case ADIS_OP_STRH:
+    case ADIS_OP_STRD:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static inline int test_bit(const uint8_t *bits, size_t i)
+{
+    return bits[i / 8] & (1 << (i % 8));
+}
+
+static inline void set_bit(uint8_t *bits, size_t i)
+{
+    bits[i / 8] |= 1 << (i % 8);
+}
+
+int funcs_find(struct adis_funcs *f, const struct adis_image *img)
+{
+    size_t nwords = image_words_size(img) / 4, i, last = 0, n = 0;
+    struct adis_instr in;
+    struct func *fn;
+    uint8_t *starts;
+    uint32_t t;
+
+    memset(f, 0, sizeof(*f));
+
+    if (nwords == 0) {
+        return 1;
+    } else if ((starts = calloc(nwords / 8 + 1, 1)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    set_bit(starts, 0);
+
+    // BL targets first, pushes are only starts if no BL lands just before
+    for (i = 0; i < nwords; i++) {
+        decode_instr(image_word(img, i * 4), &in);
+        if (is_call(&in)) {
+            t = branch_target(in.op, i * 4) / 4;
+            if (t < nwords) {
+                set_bit(starts, t);
+            }
+        }
+    }
+
+    for (i = 0; i < nwords; i++) {
+        if (test_bit(starts, i)) {
+            last = i;
+            n++;
+            continue;
+        }
+
+        decode_instr(image_word(img, i * 4), &in);
+        if (is_push_lr(&in) && i - last > ADIS_FUNCS_PUSH_SLACK) {
+            set_bit(starts, i);
+            last = i;
+            n++;
+        }
+    }
+
+    if ((f->funcs = calloc(n, sizeof(*f->funcs))) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(starts);
+        return 0;
+    }
+
+    for (i = 0; i < nwords; i++) {
+        if (test_bit(starts, i)) {
+            fn = &f->funcs[f->n++];
+            fn->start = i * 4;
+        }
+    }
+
+    for (i = 0; i < f->n; i++) {
+        fn = &f->funcs[i];
+        fn->size = (i + 1 < f->n ? f->funcs[i + 1].start : nwords * 4) -
+            fn->start;
+    }
+
+    free(starts);
+    return 1;
+}
+
+void funcs_free(struct adis_funcs *f)
+{
+    free(f->funcs);
+    memset(f, 0, sizeof(*f));
+}
+
+static void func_task(void *arg)
+{
+    struct func_task *task = arg;
+    struct func *fn = task->fn;
+    struct adis_buffer *prev;
+    struct adis_instr in;
+    uint32_t addr;
+
+    fn->end = fn->start + fn->size - 4;
+
+    for (addr = fn->start; addr - fn->start < fn->size; addr += 4) {
+        decode_instr(image_word(task->img, addr), &in);
+        fn->instrs++;
+
+        if (is_call(&in)) {
+            fn->calls++;
+        } else if (is_return(&in)) {
+            fn->returns++;
+            if (in.cond == ADIS_COND_AL) {
+                fn->end = addr;
+            }
+        }
+
+        switch (get_transfer(&in)) {
+        case 1:
+            fn->loads++;
+            break;
+        case 2:
+            fn->stores++;
+            break;
+        }
+    }
+
+    prev = set_output_buffer(&task->out);
+
+    adis_printf("function 0x%.8X-0x%.8X size=%u instructions=%zu calls=%zu "
+        "returns=%zu loads=%zu stores=%zu\n", fn->start, fn->end, fn->size,
+        fn->instrs, fn->calls, fn->returns, fn->loads, fn->stores);
+
+    if (task->disasm) {
+        for (addr = fn->start; addr - fn->start < fn->size; addr += 4) {
+            disasm_line(image_word(task->img, addr), addr);
+        }
+    }
+
+    set_output_buffer(prev);
+}
+
+int funcs_report(struct adis_funcs *f, const struct adis_image *img,
+    int disasm, int nthreads, FILE *fp)
+{
+    struct func_task *tasks;
+    size_t i, j, n, bytes;
+    struct adis_pool *pool;
+    int ret = 1;
+
+    tasks = calloc(ADIS_FUNCS_BATCH_MAX, sizeof(*tasks));
+    if (tasks == NULL || (pool = pool_new(nthreads)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(tasks);
+        return 0;
+    }
+
+    for (i = 0; i < ADIS_FUNCS_BATCH_MAX; i++) {
+        buffer_init(&tasks[i].out);
+        tasks[i].img = img;
+        tasks[i].disasm = disasm;
+    }
+
+    // in batches, so the output doesn't pile up before it is written
+    for (i = 0; i < f->n && ret; i += n) {
+        for (n = 0, bytes = 0; i + n < f->n && n < ADIS_FUNCS_BATCH_MAX &&
+             bytes < ADIS_FUNCS_BATCH_SIZE; n++) {
+            tasks[n].fn = &f->funcs[i + n];
+            tasks[n].out.len = 0;
+            bytes += f->funcs[i + n].size;
+            pool_submit(pool, func_task, &tasks[n]);
+        }
+
+        pool_wait(pool);
+
+        for (j = 0; j < n && ret; j++) {
+            ret = buffer_flush(&tasks[j].out, fp);
+        }
+    }
+
+    pool_free(pool);
+    for (i = 0; i < ADIS_FUNCS_BATCH_MAX; i++) {
+        buffer_free(&tasks[i].out);
+    }
+    free(tasks);
+    return ret;
+}
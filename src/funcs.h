@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_FUNCS_H__
+#define __ADIS_FUNCS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+
+/*
+ * Function boundaries of a stripped image, from prologue and epilogue
+ * idioms. A function starts at the start of the image, at every BL
+ * target and at every STMDB SP!,{...,LR} that isn't right after one of
+ * those, and runs up to the next start. Returns are LDM with the PC in
+ * the register list, BX LR, MOV PC,LR and LDR PC,[SP],#4; end is the
+ * last unconditional one (or the last word if there is none).
+ */
+struct func {
+    uint32_t start;
+    uint32_t end;
+    uint32_t size;          // bytes up to the next function
+    size_t instrs;
+    size_t calls;
+    size_t returns;
+    size_t loads;
+    size_t stores;
+};
+
+struct adis_funcs {
+    struct func *funcs;
+    size_t n;
+};
+
+int funcs_find(struct adis_funcs *f, const struct adis_image *img);
+void funcs_free(struct adis_funcs *f);
+
+/*
+ * Print one line of statistics per function, with the functions handed
+ * out to nthreads workers (<= 0 for one per CPU), in address order. If
+ * disasm is set, each line is followed by the function's disassembly.
+ */
+int funcs_report(struct adis_funcs *f, const struct adis_image *img,
+    int disasm, int nthreads, FILE *fp);
+
+#endif  // __ADIS_FUNCS_H__
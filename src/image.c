@@ -0,0 +1,212 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "image.h"
+
+#define ADIS_READ_CHUNK     65536
+
+// The first nprefix bytes were already read into prefix
+static int read_all(struct adis_image *img, int fd, const uint8_t *prefix,
+    size_t nprefix)
+{
+    uint8_t *data = NULL, *tmp;
+    size_t size = 0, max = 0;
+    ssize_t n = nprefix;
+
+    for (;;) {
+        if (size + ADIS_READ_CHUNK > max) {
+            max = max ? max * 2 : ADIS_READ_CHUNK * 4;
+            tmp = realloc(data, max);
+            if (tmp == NULL) {
+                free(data);
+                fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+                return 0;
+            }
+            data = tmp;
+        }
+
+        if (size == 0 && nprefix > 0) {
+            memcpy(data, prefix, nprefix);
+        } else {
+            n = read(fd, data + size, max - size);
+        }
+
+        if (n < 0) {
+            perror("read");
+            free(data);
+            return 0;
+        } else if (n == 0) {
+            break;
+        }
+
+        size += n;
+    }
+
+    img->data = data;
+    img->size = size;
+    img->mapped = 0;
+    return 1;
+}
+
+// Read up to size bytes, short only at the end of the input
+static ssize_t read_full(int fd, uint8_t *buf, size_t size)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < size) {
+        if ((n = read(fd, buf + done, size - done)) < 0) {
+            return -1;
+        } else if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+
+    return done;
+}
+
+int image_open_stream(struct adis_image *img, struct adis_stream *s,
+    const char *path)
+{
+    uint8_t magic[ADIS_STREAM_MAGIC_SIZE];
+    int fd, ret, format;
+    struct stat st;
+    ssize_t n = 0;
+    void *map;
+
+    if (path == NULL || (path[0] == '-' && path[1] == 0)) {
+        path = NULL;
+        fd = STDIN_FILENO;
+    } else if ((fd = open(path, O_RDONLY)) < 0) {
+        perror(path);
+        return 0;
+    }
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            format = stream_detect(map, st.st_size);
+            if (format == ADIS_STREAM_NONE) {
+                img->data = map;
+                img->size = st.st_size;
+                img->mapped = 1;
+                if (fd != STDIN_FILENO) {
+                    close(fd);
+                }
+                return 1;
+            }
+
+            // the stream reads the file itself, from where fd is now
+            munmap(map, st.st_size);
+            goto stream;
+        }
+    }
+
+    // anything else can't be peeked at, the magic goes in front
+    if ((n = read_full(fd, magic, sizeof(magic))) < 0) {
+        perror(path != NULL ? path : "stdin");
+        ret = 0;
+    } else if ((format = stream_detect(magic, n)) != ADIS_STREAM_NONE) {
+        goto stream;
+    } else {
+        ret = read_all(img, fd, magic, n);
+    }
+
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+
+    return ret;
+
+stream:
+    if (!stream_open(s, fd, path, format, magic, n)) {
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+        return 0;
+    }
+
+    return 2;
+}
+
+int image_read_stream(struct adis_image *img, struct adis_stream *s)
+{
+    uint8_t *data = NULL, *tmp;
+    size_t size = 0, max = 0, len;
+    const uint8_t *p;
+
+    while ((p = stream_next(s, &len)) != NULL) {
+        if (size + len > max) {
+            max = max ? max * 2 : ADIS_STREAM_CHUNK_SIZE * 4;
+            tmp = realloc(data, max);
+            if (tmp == NULL) {
+                fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+                free(data);
+                stream_close(s);
+                return 0;
+            }
+            data = tmp;
+        }
+
+        memcpy(data + size, p, len);
+        size += len;
+    }
+
+    if (!stream_close(s)) {
+        free(data);
+        return 0;
+    }
+
+    img->data = data;
+    img->size = size;
+    img->mapped = 0;
+    return 1;
+}
+
+int image_open(struct adis_image *img, const char *path)
+{
+    struct adis_stream s;
+    int ret = image_open_stream(img, &s, path);
+
+    if (ret == 2) {
+        ret = image_read_stream(img, &s);
+    }
+
+    return ret;
+}
+
+void image_close(struct adis_image *img)
+{
+    if (img->mapped) {
+        munmap((void *)img->data, img->size);
+    } else {
+        free((void *)img->data);
+    }
+
+    img->data = NULL;
+    img->size = 0;
+}
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_IMAGE_H__
+#define __ADIS_IMAGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stream.h"
+
+/*
+ * A whole input image held in memory. Regular files are mapped, anything
+ * else (pipes, terminals) is read in full. gzip and zstd compressed
+ * inputs are decompressed.
+ */
+struct adis_image {
+    const uint8_t *data;
+    size_t size;
+    int mapped;
+};
+
+int image_open(struct adis_image *img, const char *path);
+void image_close(struct adis_image *img);
+
+/*
+ * Same as image_open, except that a compressed input is left in s to be
+ * read as it is decompressed (returns 2) instead of being decompressed
+ * into img first.
+ */
+int image_open_stream(struct adis_image *img, struct adis_stream *s,
+    const char *path);
+
+// Decompress the rest of s into img and close it
+int image_read_stream(struct adis_image *img, struct adis_stream *s);
+
+// Instruction words are stored most significant byte first
+static inline uint32_t image_word(const struct adis_image *img, size_t off)
+{
+    const uint8_t *p = img->data + off;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// Number of bytes covered by whole instruction words
+static inline size_t image_words_size(const struct adis_image *img)
+{
+    return img->size & ~(size_t)3;
+}
+
+/*
+ * Part of an image that is loaded at a known address. Raw images are a
+ * single big-endian region at address 0, ELF files have one region per
+ * executable segment in the byte order of the file.
+ */
+struct image_region {
+    const uint8_t *data;
+    uint32_t addr;
+    uint32_t size;
+    int little_endian;
+};
+
+static inline int region_contains(const struct image_region *r, uint32_t addr)
+{
+    return addr >= r->addr && addr - r->addr < (r->size & ~3U);
+}
+
+static inline uint32_t region_word(const struct image_region *r, uint32_t addr)
+{
+    const uint8_t *p = r->data + (addr - r->addr);
+
+    if (r->little_endian) {
+        return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+               ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+    }
+
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+#endif  // __ADIS_IMAGE_H__
@@ -0,0 +1,340 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "opcodes.h"
+#include "decode.h"
+#include "common.h"
+
+#define ADIS_INDEX_NSECTIONS    3
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static int write_padding(FILE *fp, size_t len)
+{
+    static const uint8_t zero[8];
+    return fwrite(zero, 1, align8(len) - len, fp) == align8(len) - len;
+}
+
+int index_write(const char *path, const struct adis_image *img, uint32_t base)
+{
+    struct index_header hdr;
+    struct index_section sec[ADIS_INDEX_NSECTIONS];
+    struct index_class classes[ADIS_NUM_CLASSES];
+    struct index_record rec;
+    struct adis_instr in;
+    uint64_t i, n;
+    uint32_t *pos = NULL;
+    uint8_t *cls = NULL;
+    size_t off;
+    FILE *fp;
+    int ok = 0;
+
+    // the class list holds 32-bit record numbers
+    n = image_words_size(img) / 4;
+    if (n > UINT32_MAX) {
+        fprintf(stderr, "ADIS_ERROR: Too many words for an index\n");
+        return 0;
+    }
+
+    cls = malloc(n ? n : 1);
+    pos = malloc(sizeof(*pos) * (n ? n : 1));
+    if (cls == NULL || pos == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        goto out;
+    }
+
+    if ((fp = fopen(path, "wb")) == NULL) {
+        perror(path);
+        goto out;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ADIS_INDEX_MAGIC, sizeof(ADIS_INDEX_MAGIC));
+    hdr.version = ADIS_INDEX_VERSION;
+    hdr.byte_order = ADIS_INDEX_BYTE_ORDER;
+    hdr.record_size = sizeof(struct index_record);
+    hdr.nsections = ADIS_INDEX_NSECTIONS;
+    hdr.base = base;
+    hdr.nrecords = n;
+
+    off = sizeof(hdr) + sizeof(sec);
+    sec[0].type = ADIS_INDEX_RECORDS;
+    sec[0].entry_size = sizeof(struct index_record);
+    sec[0].offset = off;
+    sec[0].size = (uint64_t)n * sizeof(struct index_record);
+    off = align8(off + sec[0].size);
+
+    sec[1].type = ADIS_INDEX_CLASS_TABLE;
+    sec[1].entry_size = sizeof(struct index_class);
+    sec[1].offset = off;
+    sec[1].size = sizeof(classes);
+    off = align8(off + sec[1].size);
+
+    sec[2].type = ADIS_INDEX_CLASS_LIST;
+    sec[2].entry_size = sizeof(uint32_t);
+    sec[2].offset = off;
+    sec[2].size = (uint64_t)n * sizeof(uint32_t);
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        fwrite(sec, sizeof(sec), 1, fp) != 1) {
+        goto write_error;
+    }
+
+    memset(classes, 0, sizeof(classes));
+
+    for (i = 0; i < n; i++) {
+        decode_instr(image_word(img, (size_t)i * 4), &in);
+        rec.op = in.op;
+        rec.id = in.id;
+        rec.cls = in.cls;
+        rec.cond = in.cond;
+
+        if (fwrite(&rec, sizeof(rec), 1, fp) != 1) {
+            goto write_error;
+        }
+
+        cls[i] = in.cls;
+        classes[in.cls].count++;
+    }
+
+    if (!write_padding(fp, sec[0].size)) {
+        goto write_error;
+    }
+
+    // counting sort of the record numbers by class
+    for (i = 1; i < ADIS_NUM_CLASSES; i++) {
+        classes[i].first = classes[i - 1].first + classes[i - 1].count;
+    }
+
+    if (fwrite(classes, sizeof(classes), 1, fp) != 1 ||
+        !write_padding(fp, sizeof(classes))) {
+        goto write_error;
+    }
+
+    for (i = 0; i < n; i++) {
+        pos[classes[cls[i]].first++] = (uint32_t)i;
+    }
+
+    if (n > 0 && fwrite(pos, sizeof(*pos), n, fp) != n) {
+        goto write_error;
+    }
+
+    if (fclose(fp) != 0) {
+        perror(path);
+        goto out;
+    }
+
+    ok = 1;
+    goto out;
+
+write_error:
+    perror(path);
+    fclose(fp);
+
+out:
+    free(cls);
+    free(pos);
+    return ok;
+}
+
+static const struct index_section *
+find_section(const struct adis_index *idx, const struct index_section *sec,
+    uint32_t type, uint32_t entry_size, uint64_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < idx->hdr->nsections; i++) {
+        if (sec[i].type != type) {
+            continue;
+        }
+
+        if (sec[i].entry_size != entry_size ||
+            sec[i].size != count * entry_size ||
+            sec[i].offset > idx->size ||
+            sec[i].size > idx->size - sec[i].offset ||
+            sec[i].offset % 8) {
+            return NULL;
+        }
+
+        return &sec[i];
+    }
+
+    return NULL;
+}
+
+int index_open(struct adis_index *idx, const char *path)
+{
+    const struct index_section *sec, *rs, *ct, *cl;
+    struct stat st;
+    void *map;
+    int fd, i;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        perror(path);
+        return 0;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*idx->hdr)) {
+        fprintf(stderr, "%s: not an adis index\n", path);
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return 0;
+    }
+
+    idx->map = map;
+    idx->size = st.st_size;
+    idx->hdr = map;
+
+    if (memcmp(idx->hdr->magic, ADIS_INDEX_MAGIC, sizeof(ADIS_INDEX_MAGIC)) ||
+        idx->hdr->byte_order != ADIS_INDEX_BYTE_ORDER ||
+        idx->hdr->version != ADIS_INDEX_VERSION ||
+        idx->hdr->record_size != sizeof(struct index_record) ||
+        idx->hdr->nrecords > UINT32_MAX ||
+        idx->hdr->nsections > (idx->size - sizeof(*idx->hdr)) / sizeof(*sec)) {
+        goto bad_index;
+    }
+
+    sec = (const struct index_section *)(idx->map + sizeof(*idx->hdr));
+    rs = find_section(idx, sec, ADIS_INDEX_RECORDS,
+        sizeof(struct index_record), idx->hdr->nrecords);
+    ct = find_section(idx, sec, ADIS_INDEX_CLASS_TABLE,
+        sizeof(struct index_class), ADIS_NUM_CLASSES);
+    cl = find_section(idx, sec, ADIS_INDEX_CLASS_LIST,
+        sizeof(uint32_t), idx->hdr->nrecords);
+
+    if (rs == NULL || ct == NULL || cl == NULL) {
+        goto bad_index;
+    }
+
+    idx->records = (const struct index_record *)(idx->map + rs->offset);
+    idx->classes = (const struct index_class *)(idx->map + ct->offset);
+    idx->class_list = (const uint32_t *)(idx->map + cl->offset);
+
+    for (i = 0; i < ADIS_NUM_CLASSES; i++) {
+        if ((uint64_t)idx->classes[i].first + idx->classes[i].count >
+            idx->hdr->nrecords) {
+            goto bad_index;
+        }
+    }
+
+    return 1;
+
+bad_index:
+    fprintf(stderr, "%s: not an adis index or wrong version\n", path);
+    index_close(idx);
+    return 0;
+}
+
+void index_close(struct adis_index *idx)
+{
+    if (idx->map != NULL) {
+        munmap((void *)idx->map, idx->size);
+    }
+
+    idx->map = NULL;
+    idx->size = 0;
+}
+
+static int index_disasm_record(const struct adis_index *idx, uint32_t i)
+{
+    const struct index_record *rec = &idx->records[i];
+    struct adis_instr in;
+
+    // records index the renderer tables, a corrupt file must not get there
+    if (rec->cls >= ADIS_NUM_CLASSES || rec->id >= ADIS_NUM_OPS) {
+        fprintf(stderr, "ADIS_ERROR: Corrupt index record at 0x%08llX\n",
+            (unsigned long long)idx->hdr->base + (uint64_t)i * 4);
+        return 0;
+    }
+
+    in.op = rec->op;
+    in.id = rec->id;
+    in.cls = rec->cls;
+    in.cond = rec->cond;
+
+    disasm_decoded_line(&in, idx->hdr->base + i * 4);
+    return 1;
+}
+
+int index_disasm(const struct adis_index *idx, uint64_t start, uint64_t end,
+    int cls)
+{
+    uint64_t n = idx->hdr->nrecords, base = idx->hdr->base;
+    uint32_t first, last, lo, hi, mid, i;
+    const uint32_t *list;
+
+    // clamp the address range to record numbers
+    first = start < base ? 0 : ADIS_MIN((start - base) / 4, n);
+    last = end < base ? 0 : ADIS_MIN((end - base + 3) / 4, n);
+
+    if (first >= last) {
+        return 1;
+    }
+
+    if (cls < 0) {
+        for (i = first; i < last; i++) {
+            if (!index_disasm_record(idx, i)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    // the class list is sorted, find the first record in range
+    list = idx->class_list + idx->classes[cls].first;
+    lo = 0;
+    hi = idx->classes[cls].count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (list[mid] < first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /*
+     * Only entries below last are rendered, so one pointing past the
+     * records ends the range instead of being followed.
+     */
+    for (i = lo; i < idx->classes[cls].count && list[i] < last; i++) {
+        if (!index_disasm_record(idx, list[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
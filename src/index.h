@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_INDEX_H__
+#define __ADIS_INDEX_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/*
+ * Decoded-instruction index file. Everything is stored in host byte
+ * order (byte_order lets a reader detect a mismatch) and every section is
+ * 8 byte aligned, so the file can be mapped and used in place:
+ *
+ *      struct index_header
+ *      struct index_section[nsections]
+ *      section data...
+ *
+ * The records section holds one fixed-size record per instruction word,
+ * so the record for an address is found without any searching. The class
+ * sections list record numbers grouped by instruction class, in address
+ * order, for filtering by class.
+ */
+#define ADIS_INDEX_MAGIC        "ADISIDX"
+#define ADIS_INDEX_VERSION      3
+#define ADIS_INDEX_BYTE_ORDER   0x01020304
+
+#define ADIS_INDEX_RECORDS      1   // struct index_record[nrecords]
+#define ADIS_INDEX_CLASS_TABLE  2   // struct index_class[ADIS_NUM_CLASSES]
+#define ADIS_INDEX_CLASS_LIST   3   // uint32_t[nrecords]
+
+struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t record_size;
+    uint32_t nsections;
+    uint32_t base;
+    uint32_t reserved;
+    uint64_t nrecords;
+};
+
+struct index_section {
+    uint32_t type;
+    uint32_t entry_size;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct index_record {
+    uint32_t op;
+    uint16_t id;
+    uint8_t cls;
+    uint8_t cond;
+};
+
+// Range of the class list holding the record numbers of one class
+struct index_class {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct adis_index {
+    const uint8_t *map;
+    size_t size;
+    const struct index_header *hdr;
+    const struct index_record *records;
+    const struct index_class *classes;
+    const uint32_t *class_list;
+};
+
+int index_write(const char *path, const struct adis_image *img, uint32_t base);
+
+int index_open(struct adis_index *idx, const char *path);
+void index_close(struct adis_index *idx);
+
+/*
+ * Render the instructions in [start, end) into the output buffer of the
+ * calling thread, optionally only those of class cls (-1 for all).
+ * Records are checked as they are rendered; returns 0 at a corrupt one.
+ */
+int index_disasm(const struct adis_index *idx, uint64_t start, uint64_t end,
+    int cls);
+
+#endif  // __ADIS_INDEX_H__
@@ -0,0 +1,149 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "common.h"
+#include "decode.h"
+#include "literals.h"
+#include "opcodes.h"
+
+// ADR is ADD or SUB Rd,PC,#imm
+#define ADIS_LITERAL_SUB(_op)   (((_op) & 0x01E00000) == 0x00400000)
+
+int get_literal(uint32_t op, uint32_t addr, uint32_t *target)
+{
+    struct adis_instr in;
+    uint32_t pc = addr + 8;
+
+    decode_instr(op, &in);
+
+    // unconditional space is a different set of instructions
+    if (in.cond == 0xF) {
+        return ADIS_LITERAL_NONE;
+    }
+
+    switch (in.id) {
+    case ADIS_OP_LDR:
+    case ADIS_OP_LDRB:
+        // immediate offset from the PC, without writeback
+        if (ADIS_RN(op) != 15 || ADIS_IMMOP_BIT(op) ||
+            !ADIS_PREINDEX_BIT(op) || ADIS_WRITE_BIT(op)) {
+            return ADIS_LITERAL_NONE;
+        }
+        *target = pc + get_instr_imm(&in);
+        return ADIS_LITERAL_LOAD;
+    case ADIS_OP_ADR:
+        *target = ADIS_LITERAL_SUB(op) ? pc - get_instr_imm(&in) :
+            pc + get_instr_imm(&in);
+        return ADIS_LITERAL_ADDR;
+    default:
+        return ADIS_LITERAL_NONE;
+    }
+}
+
+int literals_find(struct adis_literals *l, const struct adis_image *img)
+{
+    size_t i, t;
+    uint32_t op, target;
+
+    l->nwords = image_words_size(img) / 4;
+    l->count = 0;
+
+    if ((l->bitmap = calloc(l->nwords / 8 + 1, 1)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    for (i = 0; i < l->nwords; i++) {
+        op = image_word(img, i * 4);
+        if (get_literal(op, i * 4, &target) != ADIS_LITERAL_LOAD ||
+            ADIS_BYTE_BIT(op) || (target & 3)) {
+            continue;
+        }
+
+        t = target / 4;
+        if (t < l->nwords && !(l->bitmap[t / 8] & (1 << (t % 8)))) {
+            l->bitmap[t / 8] |= 1 << (t % 8);
+            l->count++;
+        }
+    }
+
+    return 1;
+}
+
+void literals_free(struct adis_literals *l)
+{
+    free(l->bitmap);
+    l->bitmap = NULL;
+}
+
+// The "literal:" line, with the value if it is inside the image
+static void literal_line(const struct adis_image *img, int kind, uint32_t op,
+    uint32_t target)
+{
+    size_t size = image_words_size(img);
+    int byte = kind == ADIS_LITERAL_LOAD && ADIS_BYTE_BIT(op);
+
+    if (byte && target < size) {
+        adis_printf("literal: 0x%.8X = 0x%.2X\n", target, img->data[target]);
+    } else if (!byte && size >= 4 && target <= size - 4) {
+        adis_printf("literal: 0x%.8X = 0x%.8X\n", target,
+            image_word(img, target));
+    } else {
+        adis_printf("literal: 0x%.8X\n", target);
+    }
+}
+
+long literals_disasm(const struct adis_literals *l,
+    const struct adis_image *img, int mark_data, FILE *fp)
+{
+    struct adis_buffer out, *prev;
+    size_t off, end = image_words_size(img);
+    uint32_t op, target;
+    long count = 0;
+    int kind;
+
+    buffer_init(&out);
+    prev = set_output_buffer(&out);
+
+    for (off = 0; off < end; off += 4) {
+        op = image_word(img, off);
+
+        if (mark_data && is_literal(l, off)) {
+            adis_printf("op: 0x%.8X\n0x%.8X:\t.word 0x%.8X\n", op,
+                (uint32_t)off, op);
+        } else {
+            disasm_line(op, off);
+            if ((kind = get_literal(op, off, &target)) != ADIS_LITERAL_NONE) {
+                literal_line(img, kind, op, target);
+                count++;
+            }
+        }
+
+        if (out.len >= ADIS_FLUSH_SIZE) {
+            buffer_flush(&out, fp);
+        }
+    }
+
+    buffer_flush(&out, fp);
+    set_output_buffer(prev);
+    buffer_free(&out);
+    return count;
+}
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_LITERALS_H__
+#define __ADIS_LITERALS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+
+// get_literal() kinds
+#define ADIS_LITERAL_NONE       0
+#define ADIS_LITERAL_LOAD       1   // LDR/LDRB Rt,[PC,#+/-imm12]
+#define ADIS_LITERAL_ADDR       2   // ADR Rd,label (ADD/SUB Rd,PC,#imm)
+
+/*
+ * The address a PC-relative instruction at addr refers to, which is the
+ * address of the instruction plus 8 and the offset. Returns one of
+ * ADIS_LITERAL_*.
+ */
+int get_literal(uint32_t op, uint32_t addr, uint32_t *target);
+
+/*
+ * Words of an image loaded by LDR Rt,[PC,#imm] somewhere in it, one bit
+ * per word. Raw images are shown at their offset, so bit n is the word
+ * at address n * 4.
+ */
+struct adis_literals {
+    uint8_t *bitmap;
+    size_t nwords;
+    size_t count;           // distinct literal words
+};
+
+// Find every literal load of img, returns 0 on error
+int literals_find(struct adis_literals *l, const struct adis_image *img);
+void literals_free(struct adis_literals *l);
+
+static inline int is_literal(const struct adis_literals *l, uint32_t addr)
+{
+    size_t i = addr / 4;
+
+    return i < l->nwords && (l->bitmap[i / 8] & (1 << (i % 8)));
+}
+
+/*
+ * Linear disassembly with a "literal:" line after every PC-relative
+ * instruction, giving the address it refers to and, for loads from (and
+ * ADR of a word in) the image, the value there:
+ *
+ *      literal: 0x00001F40 = 0x0804A000
+ *
+ * The words that are loaded as literals are rendered as ".word 0x..."
+ * data instead of being decoded if mark_data is set. Returns the number
+ * of PC-relative instructions, or -1 on error.
+ */
+long literals_disasm(const struct adis_literals *l,
+    const struct adis_image *img, int mark_data, FILE *fp);
+
+#endif  // __ADIS_LITERALS_H__
@@ -0,0 +1,197 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "branch.h"
+#include "buffer.h"
+#include "decode.h"
+#include "loops.h"
+#include "opcodes.h"
+
+struct loop {
+    uint32_t start;
+    uint32_t end;           // address of the last backward branch
+    size_t parent;          // index + 1, 0 for outermost loops
+    unsigned backedges;
+    unsigned depth;
+};
+
+struct loop_list {
+    struct loop *loops;
+    size_t n;
+    size_t size;
+};
+
+static struct loop *loop_add(struct loop_list *l)
+{
+    struct loop *tmp;
+
+    if (l->n == l->size) {
+        l->size = l->size ? l->size * 2 : 64;
+        tmp = realloc(l->loops, sizeof(*tmp) * l->size);
+        if (tmp == NULL) {
+            return NULL;
+        }
+        l->loops = tmp;
+    }
+
+    memset(&l->loops[l->n], 0, sizeof(*l->loops));
+    return &l->loops[l->n++];
+}
+
+// Address order, an outer loop before the loops inside it
+static int loop_order(const void *a, const void *b)
+{
+    const struct loop *x = a, *y = b;
+
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+
+    return (x->end < y->end) - (x->end > y->end);
+}
+
+static void loop_print(const struct loop *lp, const uint8_t *classes)
+{
+    size_t mix[ADIS_NUM_CLASSES], i, n = (lp->end - lp->start) / 4 + 1;
+    const char *sep = "";
+
+    memset(mix, 0, sizeof(mix));
+    for (i = lp->start / 4; i <= lp->end / 4; i++) {
+        mix[classes[i]]++;
+    }
+
+    adis_printf("loop 0x%.8X-0x%.8X depth=%u instructions=%zu bytes=%zu "
+        "backedges=%u mix=", lp->start, lp->end, lp->depth, n, n * 4,
+        lp->backedges);
+
+    for (i = 0; i < ADIS_NUM_CLASSES; i++) {
+        if (mix[i] > 0) {
+            adis_printf("%s%s:%zu", sep, get_class_string(i), mix[i]);
+            sep = ",";
+        }
+    }
+
+    adis_printf("\n");
+}
+
+long loops_report(const struct adis_image *img, FILE *fp)
+{
+    size_t nwords = image_words_size(img) / 4, i, j, k, top = 0;
+    size_t idx, first, nstack = 0;
+    struct loop_list l = { NULL, 0, 0 };
+    size_t *stack = NULL, *tmp;
+    struct adis_buffer out, *prev;
+    struct adis_instr in;
+    uint8_t *classes;
+    uint32_t t;
+    long ret = -1;
+
+    // kept for the class mix of each loop body
+    if ((classes = malloc(nwords + 1)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return -1;
+    }
+
+    for (i = 0; i < nwords; i++) {
+        decode_instr(image_word(img, i * 4), &in);
+        classes[i] = in.cls;
+
+        if (in.id != ADIS_OP_B) {
+            continue;
+        }
+
+        t = branch_target(in.op, i * 4);
+        if (t > i * 4 || (t & 3)) {
+            continue;
+        }
+
+        /*
+         * Starts on the stack go up towards the top, so the loops inside
+         * this one are all at the top. One starting at the same address
+         * is the same loop with another back edge.
+         */
+        k = top;
+        while (k > 0 && l.loops[stack[k - 1]].start >= t) {
+            k--;
+        }
+
+        if (k < top && l.loops[stack[k]].start == t) {
+            idx = stack[k];
+            first = k + 1;
+        } else if (loop_add(&l) == NULL) {
+            goto oom;
+        } else {
+            idx = l.n - 1;
+            l.loops[idx].start = t;
+            first = k;
+        }
+
+        for (j = first; j < top; j++) {
+            l.loops[stack[j]].parent = idx + 1;
+        }
+
+        l.loops[idx].end = i * 4;
+        l.loops[idx].backedges++;
+
+        if (k == nstack) {
+            nstack = nstack ? nstack * 2 : 64;
+            tmp = realloc(stack, sizeof(*stack) * nstack);
+            if (tmp == NULL) {
+                goto oom;
+            }
+            stack = tmp;
+        }
+        stack[k] = idx;
+        top = k + 1;
+    }
+
+    for (i = 0; i < l.n; i++) {
+        for (j = i; j != (size_t)-1; j = l.loops[j].parent - 1) {
+            l.loops[i].depth++;
+        }
+    }
+
+    qsort(l.loops, l.n, sizeof(*l.loops), loop_order);
+
+    buffer_init(&out);
+    prev = set_output_buffer(&out);
+
+    for (i = 0; i < l.n; i++) {
+        loop_print(&l.loops[i], classes);
+        if (out.len >= ADIS_FLUSH_SIZE) {
+            buffer_flush(&out, fp);
+        }
+    }
+
+    buffer_flush(&out, fp);
+    set_output_buffer(prev);
+    buffer_free(&out);
+    ret = l.n;
+    goto done;
+
+oom:
+    fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+done:
+    free(classes);
+    free(stack);
+    free(l.loops);
+    return ret;
+}
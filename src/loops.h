@@ -0,0 +1,40 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_LOOPS_H__
+#define __ADIS_LOOPS_H__
+
+#include <stdio.h>
+
+#include "image.h"
+
+/*
+ * Report the loops of an image: every backward B<cond> closes a loop
+ * from its target to the branch. Branches back to the same target are
+ * one loop. Loops are found in one pass with a stack of open intervals,
+ * each loop popping the loops inside it off the stack as their parent.
+ * One line per loop, in address order, outer loops first:
+ *
+ *      loop 0x00001000-0x00001040 depth=1 instructions=17 bytes=68
+ *          backedges=1 mix=dp_reg:9,dt_single:6,branch:2
+ *
+ * (on one line). Returns the number of loops, or -1 on error.
+ */
+long loops_report(const struct adis_image *img, FILE *fp);
+
+#endif  // __ADIS_LOOPS_H__
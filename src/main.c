@@ -17,90 +17,1425 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-#include "predicates.h"
-#include "dataproc.h"
-#include "misc.h"
-#include "multi.h"
-#include "sync.h"
-#include "branch.h"
-#include "dt_single.h"
-#include "dt_block.h"
-#include "dt_extra.h"
-#include "dt_coproc.h"
-#include "rt_coproc.h"
-#include "dataop_coproc.h"
-#include "sw_interrupt.h"
-
-static int readop(/*out */ uint32_t * op)
-{
-    char c;
-    uint8_t i;
-
-    for (i = 0; i < 4; i++) {
-        c = getc(stdin);
-        if (c == EOF) {
+#include "batch.h"
+#include "checkpoint.h"
+#include "common.h"
+#include "compress.h"
+#include "cost.h"
+#include "daemon.h"
+#include "decode.h"
+#include "diff.h"
+#include "elf.h"
+#include "follow.h"
+#include "format.h"
+#include "funcs.h"
+#include "image.h"
+#include "index.h"
+#include "literals.h"
+#include "loops.h"
+#include "match.h"
+#include "page.h"
+#include "pool.h"
+#include "profile.h"
+#include "recursive.h"
+#include "regs.h"
+#include "ring.h"
+#include "sample.h"
+#include "segment.h"
+#include "seq.h"
+#include "stream.h"
+#include "trace.h"
+
+struct adis_options {
+    int dedup;
+    int verbose;
+    int cls;
+    int threads;
+    int batch;
+    int recursive;
+    int regs;
+    int diff;
+    int format;
+    int follow;
+    int trace;
+    int trace_summary;
+    const char *profile;
+    const char *cost;
+    int loops;
+    int funcs;          // 1 for the table, 2 with disassembly
+    const char *shm;
+    size_t shm_size;
+    int compress;       // ADIS_STREAM_GZIP or ADIS_STREAM_ZSTD
+    double sample;
+    int stride;
+    int literals;       // 1 to resolve them, 2 to also show them as data
+    int segment;        // 1 to disassemble the code, 2 for the map
+    const char *checkpoint;
+    int resume;
+    uint64_t start;
+    uint64_t end;
+    const char *cache_dir;
+    const char *write_index;
+    const char *index;
+    const char *daemon;
+    const char *manifest;
+    const char *outdir;
+    const char *input;
+    char **inputs;
+    int ninputs;
+    uint32_t *entries;
+    size_t nentries;
+    struct adis_match match;
+    struct adis_seq seq;
+    size_t context;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [file]\n"
+        "       %s --batch [options] [file...]\n"
+        "       %s --diff [options] old new\n"
+        "Disassemble ARMv7 instruction words read from file (or stdin).\n"
+        "\n"
+        "  -d, --dedup          render repeated %d byte pages only once\n"
+        "  -C, --cache-dir=DIR  keep rendered pages in DIR across runs\n"
+        "                       (implies --dedup)\n"
+        "  -w, --write-index=FILE\n"
+        "                       write a decoded-instruction index to FILE\n"
+        "                       instead of disassembling\n"
+        "  -i, --index=FILE     disassemble from an index written by\n"
+        "                       --write-index instead of an image\n"
+        "  -r, --range=START:END\n"
+        "                       only addresses in [START, END) (--index)\n"
+        "  -c, --class=NAME     only instructions of class NAME (--index)\n"
+        "  -D, --daemon=SOCKET  serve disassembly requests on a Unix socket\n"
+        "  -j, --threads=N      number of worker threads (default: one per\n"
+        "                       CPU)\n"
+        "  -b, --batch          disassemble every file to its own output\n"
+        "                       file, in parallel\n"
+        "  -M, --manifest=FILE  read batch inputs from FILE, one per line\n"
+        "                       (implies --batch)\n"
+        "  -o, --output-dir=DIR write batch outputs to DIR instead of next\n"
+        "                       to their inputs\n"
+        "  -R, --recursive      only disassemble code reachable from the\n"
+        "                       entry points (recursive descent)\n"
+        "  -e, --entry=ADDR[,ADDR...]\n"
+        "                       entry points for --recursive (default: the\n"
+        "                       ELF entry and code symbols, or 0)\n"
+        "  -m, --match=SPEC[,SPEC...]\n"
+        "                       only disassemble words matching MASK:VALUE\n"
+        "                       (hex) or class=NAME\n"
+        "  -s, --seq=PATTERN    only disassemble sequences of words matching\n"
+        "                       the ';' separated elements of PATTERN\n"
+        "  -f, --diff           compare two images given as OLD NEW\n"
+        "  -x, --context=N      with --match, --seq, --diff or --profile,\n"
+        "                       also show N words around each match\n"
+        "                       (--diff: 3, at most %d)\n"
+        "  -u, --regs           print the registers and flags each\n"
+        "                       instruction reads and writes\n"
+        "  -F, --format=FORMAT  text (default), jsonl or bin\n"
+        "  -t, --follow         keep disassembling words appended to file\n"
+        "  -T, --trace          input is an execution trace of (pc, opcode)\n"
+        "                       records\n"
+        "  -S, --trace-summary  only print how often each traced\n"
+        "                       instruction ran, most executed first\n"
+        "                       (implies --trace)\n"
+        "  -P, --profile=FILE   only disassemble the regions sampled in\n"
+        "                       FILE, hottest first, with sample counts\n"
+        "  -k, --cost=TABLE     annotate instructions and basic blocks with\n"
+        "                       cycle costs from TABLE (cortex-a9 or a file)\n"
+        "  -L, --loops          report the loops closed by backward branches\n"
+        "  -n, --functions      list the functions found from prologues,\n"
+        "                       epilogues and BL targets\n"
+        "  -N, --by-function    disassemble function by function, in\n"
+        "                       parallel\n"
+        "  -l, --literals       resolve PC-relative loads and ADR, and show\n"
+        "                       the literal they refer to\n"
+        "  -A, --literal-data   same as --literals, with the loaded words\n"
+        "                       shown as data\n"
+        "  -g, --segment        only disassemble the regions that look like\n"
+        "                       code\n"
+        "  -G, --region-map     print the code and data regions found by\n"
+        "                       --segment\n"
+        "  -a, --sample=RATE    estimate the instruction mix from a random\n"
+        "                       sample of RATE (e.g. 0.001 or 1/1000) of\n"
+        "                       the words\n"
+        "  -y, --stride         sample every (1 / RATE)th word instead\n"
+        "  -K, --checkpoint=FILE\n"
+        "                       save progress to FILE every %d seconds\n"
+        "  -E, --resume         carry on from the --checkpoint FILE, with\n"
+        "                       the output appended to (>>) instead\n"
+        "  -O, --shm=PATH       publish the output into a shared memory ring\n"
+        "                       at PATH (e.g. /dev/shm/adis) instead of\n"
+        "                       stdout\n"
+        "  -z, --compress=FORMAT\n"
+        "                       compress the output with gzip or zstd, in\n"
+        "                       blocks on the worker threads\n"
+        "  -W, --shm-size=BYTES size of the --shm ring (default: %d, from\n"
+        "                       %d to %d)\n"
+        "  -v, --verbose        print statistics to stderr\n"
+        "  -h, --help           show this message\n",
+        prog, prog, prog, ADIS_PAGE_SIZE, ADIS_MATCH_MAX_CONTEXT,
+        ADIS_CHECKPOINT_SECS, ADIS_RING_SIZE, ADIS_RING_MIN_SIZE,
+        ADIS_RING_MAX_SIZE);
+}
+
+// START:END, either may be left out
+static int parse_range(const char *arg, uint64_t *start, uint64_t *end)
+{
+    char *p;
+
+    *start = 0;
+    *end = UINT64_MAX;
+
+    if (*arg != ':') {
+        *start = strtoull(arg, &p, 0);
+        if (p == arg || *p != ':') {
+            return 0;
+        }
+        arg = p;
+    }
+
+    arg++;
+    if (*arg != 0) {
+        *end = strtoull(arg, &p, 0);
+        if (*p != 0) {
+            return 0;
+        }
+    }
+
+    return *start <= *end;
+}
+
+// Comma separated addresses, appended to *list
+static int parse_addr_list(const char *arg, uint32_t **list, size_t *count)
+{
+    uint32_t *tmp;
+    char *p;
+
+    for (;;) {
+        tmp = realloc(*list, sizeof(*tmp) * (*count + 1));
+        if (tmp == NULL) {
+            return 0;
+        }
+        *list = tmp;
+
+        (*list)[(*count)++] = strtoul(arg, &p, 0);
+        if (p == arg || (*p != ',' && *p != 0)) {
             return 0;
+        } else if (*p == 0) {
+            return 1;
         }
 
-        *op |= (c & 0xFF);
+        arg = p + 1;
+    }
+}
+
+// A fraction in (0, 1], either as a number or as 1/N
+static int parse_rate(const char *arg, double *rate)
+{
+    double n;
+    char *p;
+
+    *rate = strtod(arg, &p);
+    if (p != arg && *p == '/') {
+        arg = p + 1;
+        n = strtod(arg, &p);
+        *rate = n > 0 ? *rate / n : 0;
+    }
+
+    return p != arg && *p == 0 && *rate > 0 && *rate <= 1;
+}
+
+// 0 for one thread per CPU, up to ADIS_POOL_MAX_THREADS
+static int parse_threads(const char *arg, int *threads)
+{
+    char *p;
+    long n;
+
+    n = strtol(arg, &p, 0);
+    *threads = n;
+
+    return p != arg && *p == 0 && n >= 0 && n <= ADIS_POOL_MAX_THREADS;
+}
+
+/*
+ * A number from min to max, nothing else. Unlike strtoull() this doesn't
+ * take a sign, so -1 can't wrap around.
+ */
+static int parse_size(const char *arg, size_t min, size_t max, size_t *size)
+{
+    unsigned long long n;
+    char *p;
+
+    if (*arg < '0' || *arg > '9') {
+        return 0;
+    }
+
+    n = strtoull(arg, &p, 0);
+    *size = n;
+
+    return *p == 0 && n >= min && n <= max;
+}
+
+// Modes that don't disassemble a single image
+static int other_input(const struct adis_options *opts)
+{
+    return opts->batch || opts->diff || opts->daemon != NULL ||
+        opts->index != NULL;
+}
+
+/*
+ * Modes that need a whole image in memory instead of plain disassembly,
+ * returns how many of them are set
+ */
+static int whole_image(const struct adis_options *opts)
+{
+    return (opts->write_index != NULL) + opts->recursive + opts->dedup +
+        (opts->profile != NULL) + (opts->cost != NULL) + opts->loops +
+        !!opts->funcs + (opts->sample > 0) + !!opts->literals +
+        !!opts->segment + (opts->match.nterms > 0) + (opts->seq.npats > 0);
+}
+
+static int parse_options(int argc, char **argv, struct adis_options *opts)
+{
+    static struct option long_opts[] = {
+        { "dedup",      no_argument,        NULL, 'd' },
+        { "cache-dir",  required_argument,  NULL, 'C' },
+        { "write-index", required_argument, NULL, 'w' },
+        { "index",      required_argument,  NULL, 'i' },
+        { "range",      required_argument,  NULL, 'r' },
+        { "class",      required_argument,  NULL, 'c' },
+        { "daemon",     required_argument,  NULL, 'D' },
+        { "threads",    required_argument,  NULL, 'j' },
+        { "batch",      no_argument,        NULL, 'b' },
+        { "manifest",   required_argument,  NULL, 'M' },
+        { "output-dir", required_argument,  NULL, 'o' },
+        { "recursive",  no_argument,        NULL, 'R' },
+        { "entry",      required_argument,  NULL, 'e' },
+        { "match",      required_argument,  NULL, 'm' },
+        { "seq",        required_argument,  NULL, 's' },
+        { "context",    required_argument,  NULL, 'x' },
+        { "regs",       no_argument,        NULL, 'u' },
+        { "diff",       no_argument,        NULL, 'f' },
+        { "format",     required_argument,  NULL, 'F' },
+        { "follow",     no_argument,        NULL, 't' },
+        { "trace",      no_argument,        NULL, 'T' },
+        { "trace-summary", no_argument,     NULL, 'S' },
+        { "profile",    required_argument,  NULL, 'P' },
+        { "cost",       required_argument,  NULL, 'k' },
+        { "loops",      no_argument,        NULL, 'L' },
+        { "functions",  no_argument,        NULL, 'n' },
+        { "by-function", no_argument,       NULL, 'N' },
+        { "literals",   no_argument,        NULL, 'l' },
+        { "literal-data", no_argument,      NULL, 'A' },
+        { "segment",    no_argument,        NULL, 'g' },
+        { "region-map", no_argument,        NULL, 'G' },
+        { "sample",     required_argument,  NULL, 'a' },
+        { "stride",     no_argument,        NULL, 'y' },
+        { "checkpoint", required_argument,  NULL, 'K' },
+        { "resume",     no_argument,        NULL, 'E' },
+        { "shm",        required_argument,  NULL, 'O' },
+        { "shm-size",   required_argument,  NULL, 'W' },
+        { "compress",   required_argument,  NULL, 'z' },
+        { "verbose",    no_argument,        NULL, 'v' },
+        { "help",       no_argument,        NULL, 'h' },
+        { NULL,         0,                  NULL, 0 }
+    };
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->cls = -1;
+    opts->end = UINT64_MAX;
+    opts->context = SIZE_MAX;
+    opts->shm_size = ADIS_RING_SIZE;
 
-        if (i != 3) {
-            *op <<= 8;
+    while ((c = getopt_long(argc, argv, "dC:w:i:r:c:D:j:bM:o:Re:m:s:x:ufF:tTSP:k:LnNlAgGa:yK:EO:W:z:vh", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'd':
+            opts->dedup = 1;
+            break;
+        case 'C':
+            opts->cache_dir = optarg;
+            opts->dedup = 1;
+            break;
+        case 'w':
+            opts->write_index = optarg;
+            break;
+        case 'i':
+            opts->index = optarg;
+            break;
+        case 'r':
+            if (!parse_range(optarg, &opts->start, &opts->end)) {
+                fprintf(stderr, "%s: bad range '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'c':
+            if ((opts->cls = get_class_by_name(optarg)) < 0) {
+                fprintf(stderr, "%s: unknown class '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'D':
+            opts->daemon = optarg;
+            break;
+        case 'j':
+            if (!parse_threads(optarg, &opts->threads)) {
+                fprintf(stderr, "%s: bad thread count '%s'\n", argv[0],
+                    optarg);
+                return 0;
+            }
+            break;
+        case 'b':
+            opts->batch = 1;
+            break;
+        case 'M':
+            opts->manifest = optarg;
+            opts->batch = 1;
+            break;
+        case 'o':
+            opts->outdir = optarg;
+            break;
+        case 'R':
+            opts->recursive = 1;
+            break;
+        case 'e':
+            if (!parse_addr_list(optarg, &opts->entries, &opts->nentries)) {
+                fprintf(stderr, "%s: bad entry list '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'm':
+            if (!match_add(&opts->match, optarg)) {
+                fprintf(stderr, "%s: bad match '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 's':
+            if (!seq_add(&opts->seq, optarg)) {
+                fprintf(stderr, "%s: bad sequence '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'x':
+            if (!parse_size(optarg, 0, ADIS_MATCH_MAX_CONTEXT,
+                &opts->context)) {
+                fprintf(stderr, "%s: bad context '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'u':
+            opts->regs = 1;
+            break;
+        case 'f':
+            opts->diff = 1;
+            break;
+        case 'F':
+            if ((opts->format = get_format_by_name(optarg)) < 0) {
+                fprintf(stderr, "%s: unknown format '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 't':
+            opts->follow = 1;
+            break;
+        case 'T':
+            opts->trace = 1;
+            break;
+        case 'S':
+            opts->trace = 1;
+            opts->trace_summary = 1;
+            break;
+        case 'P':
+            opts->profile = optarg;
+            break;
+        case 'k':
+            opts->cost = optarg;
+            break;
+        case 'L':
+            opts->loops = 1;
+            break;
+        case 'n':
+            opts->funcs = 1;
+            break;
+        case 'N':
+            opts->funcs = 2;
+            break;
+        case 'l':
+            opts->literals = 1;
+            break;
+        case 'A':
+            opts->literals = 2;
+            break;
+        case 'g':
+            opts->segment = 1;
+            break;
+        case 'G':
+            opts->segment = 2;
+            break;
+        case 'a':
+            if (!parse_rate(optarg, &opts->sample)) {
+                fprintf(stderr, "%s: bad sample rate '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'y':
+            opts->stride = 1;
+            break;
+        case 'K':
+            opts->checkpoint = optarg;
+            break;
+        case 'E':
+            opts->resume = 1;
+            break;
+        case 'O':
+            opts->shm = optarg;
+            break;
+        case 'W':
+            if (!parse_size(optarg, ADIS_RING_MIN_SIZE, ADIS_RING_MAX_SIZE,
+                &opts->shm_size)) {
+                fprintf(stderr, "%s: bad ring size '%s'\n", argv[0], optarg);
+                return 0;
+            }
+            break;
+        case 'z':
+            if ((opts->compress = compress_parse(optarg)) == ADIS_STREAM_NONE) {
+                fprintf(stderr, "%s: unknown compression '%s'\n", argv[0],
+                    optarg);
+                return 0;
+            }
+            break;
+        case 'v':
+            opts->verbose = 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            return 0;
         }
     }
 
+    opts->inputs = argv + optind;
+    opts->ninputs = argc - optind;
+
+    if (opts->context == SIZE_MAX) {
+        opts->context = opts->diff ? 3 : 0;
+    }
+
+    if (whole_image(opts) > 1) {
+        fprintf(stderr, "%s: only one of --write-index, --recursive, "
+            "--dedup, --profile, --cost, --loops, --functions, --sample, "
+            "--literals, --segment, --match and --seq can be given\n",
+            argv[0]);
+        return 0;
+    }
+
+    // the renderers that have a "regs:" line
+    if (opts->regs && (other_input(opts) ||
+        (whole_image(opts) && opts->cost == NULL))) {
+        fprintf(stderr, "%s: --regs only applies to plain disassembly, "
+            "--follow and --cost\n", argv[0]);
+        return 0;
+    }
+
+    if (opts->format != ADIS_FORMAT_TEXT && (other_input(opts) ||
+        opts->trace || opts->regs || whole_image(opts))) {
+        fprintf(stderr, "%s: --format only applies to plain disassembly\n",
+            argv[0]);
+        return 0;
+    }
+
+    if (opts->trace && (other_input(opts) || opts->regs || opts->follow ||
+        whole_image(opts))) {
+        fprintf(stderr, "%s: --trace can't be combined with other modes\n",
+            argv[0]);
+        return 0;
+    }
+
+    if (opts->follow && (opts->ninputs != 1 || other_input(opts) ||
+        whole_image(opts))) {
+        fprintf(stderr, "%s: --follow only applies to plain disassembly of "
+            "a file\n", argv[0]);
+        return 0;
+    }
+
+    // the modes that still write to stdout themselves
+    if (opts->shm != NULL && (opts->batch || opts->diff ||
+        opts->daemon != NULL || (whole_image(opts) && !opts->dedup))) {
+        fprintf(stderr, "%s: --shm only applies to plain disassembly, "
+            "--dedup, --index, --trace and --follow\n", argv[0]);
+        return 0;
+    }
+
+    // blocks are only written out once full, which --follow can't wait for
+    if (opts->compress != ADIS_STREAM_NONE && (opts->batch || opts->diff ||
+        opts->daemon != NULL || opts->follow || opts->shm != NULL ||
+        (whole_image(opts) && !opts->dedup))) {
+        fprintf(stderr, "%s: --compress only applies to plain disassembly, "
+            "--dedup, --index and --trace\n", argv[0]);
+        return 0;
+    } else if (opts->compress != ADIS_STREAM_NONE && isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "%s: compressed output not written to a terminal\n",
+            argv[0]);
+        return 0;
+    }
+
+    if (opts->checkpoint != NULL && (opts->diff || opts->daemon != NULL ||
+        opts->index != NULL || opts->trace || opts->follow ||
+        opts->shm != NULL || opts->compress != ADIS_STREAM_NONE ||
+        (whole_image(opts) && !opts->dedup))) {
+        fprintf(stderr, "%s: --checkpoint only applies to plain disassembly, "
+            "--dedup and --batch\n", argv[0]);
+        return 0;
+    } else if (opts->resume && opts->checkpoint == NULL) {
+        fprintf(stderr, "%s: --resume needs --checkpoint\n", argv[0]);
+        return 0;
+    }
+
+    if (opts->batch) {
+        return 1;
+    } else if (opts->diff && opts->ninputs != 2) {
+        usage(argv[0]);
+        return 0;
+    } else if (opts->diff) {
+        return 1;
+    }
+
+    if (optind < argc) {
+        opts->input = argv[optind++];
+    }
+
+    if (optind < argc) {
+        usage(argv[0]);
+        return 0;
+    }
+
     return 1;
 }
 
-int main()
-{
-    uint32_t op = 0;
-    uint32_t count = 0;
-
-    while (readop(&op)) {
-        printf("op: 0x%.8X\n", op);
-        printf("0x%.8X:\t", count);
-        if (is_sync_primitive(op)) {
-            sync_instr(op);
-        } else if (is_misc(op)) {
-            misc_instr(op);
-        } else if (is_multi(op)) {
-            multi_instr(op);
-        } else if (is_halfword_multi(op)) {
-            halfword_multi_instr(op);
-        } else if (is_dp_reg(op)) {
-            dp_reg_instr(op);
-        } else if (is_dp_rsr(op)) {
-            dp_rsr_instr(op);
-        } else if (is_dp_imm(op)) {
-            dp_imm_instr(op);
-        } else if (is_dp_other(op)) {
-            dp_other_instr(op);
-        } else if (is_branch(op)) {
-            branch_instr(op);
-        } else if (is_dt_single(op)) {
-            dt_single_instr(op);
-        } else if (is_dt_block(op)) {
-            dt_block_instr(op);
-        } else if (is_dt_extra(op)) {
-            dt_extra_instr(op);
-        } else if (is_dt_coproc(op)) {
-            dt_coproc_instr(op);
-        } else if (is_rt_coproc(op)) {
-            rt_coproc_instr(op);
-        } else if (is_dataop_coproc(op)) {
-            dataop_coproc_instr(op);
-        } else if (is_sw_interrupt(op)) {
-            sw_interrupt_instr(op);
-        } else {
-            printf("Unrecognized instruction 0x%x\n", op);
-            return 1;
+// Where flush_output() publishes with --shm, instead of stdout
+static struct adis_ring *shm;
+
+// What flush_output() compresses to stdout with --compress
+static struct adis_compress *compressor;
+
+static void flush_output(struct adis_buffer *out, int force)
+{
+    if (out->len < ADIS_FLUSH_SIZE && !(force && out->len > 0)) {
+        return;
+    } else if (compressor != NULL) {
+        if (!compress_write(compressor, out->data, out->len)) {
+            exit(2);
+        }
+        out->len = 0;
+    } else if (shm == NULL) {
+        buffer_flush(out, stdout);
+    } else if (ring_write(shm, out->data, out->len)) {
+        out->len = 0;
+    } else {
+        // like a write to a pipe nobody reads anymore
+        exit(1);
+    }
+}
+
+// --checkpoint progress of plain disassembly (--batch keeps its own)
+static struct adis_checkpoint *ckpt;
+
+// flush_output() in loops that could carry on at input offset next
+static void flush_progress(struct adis_buffer *out, uint64_t next)
+{
+    struct checkpoint_entry *e;
+    long long len;
+
+    if (out->len < ADIS_FLUSH_SIZE) {
+        return;
+    }
+
+    flush_output(out, 0);
+
+    if (ckpt != NULL && checkpoint_due(ckpt) &&
+        (len = checkpoint_output_len(stdout)) >= 0) {
+        // raw words are shown at their offset
+        e = &ckpt->entries[0];
+        e->input_off = e->addr = next;
+        e->output_len = len;
+        checkpoint_save(ckpt);
+    }
+}
+
+/*
+ * Record that the run finished with exit status 0 or 1, so resuming it
+ * does nothing; a finished run got to end, the size of its input.
+ * Anything else leaves the last checkpoint to resume from.
+ */
+static void finish_checkpoint(int status, uint64_t end)
+{
+    struct checkpoint_entry *e;
+    long long len;
+
+    if (ckpt == NULL) {
+        return;
+    }
+
+    e = &ckpt->entries[0];
+    if (status <= 1 && (len = checkpoint_output_len(stdout)) >= 0) {
+        e->state = status ? ADIS_CHECKPOINT_STOPPED : ADIS_CHECKPOINT_DONE;
+        if (!status) {
+            e->input_off = e->addr = end;
+        }
+        e->output_len = len;
+        checkpoint_save(ckpt);
+    }
+
+    checkpoint_free(ckpt);
+    ckpt = NULL;
+}
+
+// Write out the rest and mark the end of the --shm ring
+static void finish_output(struct adis_buffer *out,
+    const struct adis_options *opts, int ok)
+{
+    flush_output(out, 1);
+    buffer_free(out);
+
+    if (compressor != NULL) {
+        if (!compress_close(compressor)) {
+            exit(2);
+        }
+        if (opts->verbose) {
+            fprintf(stderr, "adis: %llu bytes compressed to %llu\n",
+                (unsigned long long)compressor->in_bytes,
+                (unsigned long long)compressor->out_bytes);
+        }
+        compressor = NULL;
+    }
+
+    if (shm == NULL) {
+        return;
+    }
+
+    if (opts->verbose) {
+        fprintf(stderr, "adis: %llu bytes through %s, %llu waits for the "
+            "consumer\n", (unsigned long long)shm->hdr->head, opts->shm,
+            (unsigned long long)shm->waits);
+    }
+
+    ring_close(shm, ok);
+    shm = NULL;
+}
+
+// Words at img are shown at addresses from base
+static int disasm_linear(const struct adis_image *img, size_t base,
+    struct adis_buffer *out)
+{
+    size_t off, end = image_words_size(img);
+
+    for (off = 0; off < end; off += 4) {
+        if (!disasm_line(image_word(img, off), base + off)) {
+            return 0;
+        }
+        flush_progress(out, base + off + 4);
+    }
+
+    return 1;
+}
+
+// Same as above, with a "regs:" line after every instruction
+static int disasm_linear_regs(const struct adis_image *img, size_t base,
+    struct adis_buffer *out)
+{
+    size_t off, end = image_words_size(img);
+    struct adis_instr in;
+
+    for (off = 0; off < end; off += 4) {
+        decode_instr(image_word(img, off), &in);
+        if (!disasm_decoded_line(&in, base + off)) {
+            return 0;
+        }
+        disasm_regs(&in);
+        flush_progress(out, base + off + 4);
+    }
+
+    return 1;
+}
+
+// Same as disasm_linear, in one of the structured formats
+static int disasm_linear_format(const struct adis_image *img, size_t base,
+    int format, struct adis_buffer *out)
+{
+    size_t off, end = image_words_size(img);
+    struct adis_instr in;
+
+    for (off = 0; off < end; off += 4) {
+        decode_instr(image_word(img, off), &in);
+        if (!format_instr(format, &in, base + off)) {
+            return 0;
+        }
+        flush_progress(out, base + off + 4);
+    }
+
+    return 1;
+}
+
+// Linear disassembly of part of the input in whichever form was asked for
+static int disasm_chunk(const struct adis_image *chunk, size_t base,
+    const struct adis_options *opts, struct adis_buffer *out)
+{
+    if (opts->format != ADIS_FORMAT_TEXT) {
+        return disasm_linear_format(chunk, base, opts->format, out);
+    } else if (opts->regs) {
+        return disasm_linear_regs(chunk, base, out);
+    }
+
+    return disasm_linear(chunk, base, out);
+}
+
+/*
+ * Linear disassembly of a compressed input from offset start, one chunk
+ * at a time while the rest is still being decompressed. Returns the exit
+ * status, with the offset it got to in *end.
+ */
+static int disasm_stream(struct adis_stream *s, uint64_t start,
+    const struct adis_options *opts, struct adis_buffer *out, uint64_t *end)
+{
+    struct adis_image chunk;
+    uint64_t base = 0;
+    size_t skip;
+    int ret = 1;
+
+    chunk.mapped = 0;
+
+    while (ret && (chunk.data = stream_next(s, &chunk.size)) != NULL) {
+        // everything before start only has to be decompressed
+        skip = start > base ? ADIS_MIN(start - base, chunk.size) : 0;
+        base += skip;
+        chunk.data += skip;
+        chunk.size -= skip;
+
+        ret = disasm_chunk(&chunk, base, opts, out);
+        base += chunk.size;
+    }
+
+    *end = base;
+    if (!stream_close(s)) {
+        return 2;
+    }
+
+    return ret ? 0 : 1;
+}
+
+/*
+ * Linear disassembly of a file that is still growing, with the output of
+ * each batch of new words written out straight away. Returns the exit
+ * status.
+ */
+static int disasm_follow(const struct adis_options *opts,
+    struct adis_buffer *out)
+{
+    struct adis_follow f;
+    struct adis_image chunk;
+    uint8_t *buf;
+    ssize_t n;
+    int ret = 1;
+
+    if ((buf = malloc(ADIS_FOLLOW_CHUNK)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 2;
+    } else if (!follow_open(&f, opts->input)) {
+        free(buf);
+        return 2;
+    }
+
+    chunk.data = buf;
+    chunk.mapped = 0;
+
+    while (ret && (n = follow_read(&f, buf, ADIS_FOLLOW_CHUNK)) > 0) {
+        chunk.size = n;
+        ret = disasm_chunk(&chunk, f.off - n, opts, out);
+        flush_output(out, 1);
+        fflush(stdout);
+    }
+
+    follow_close(&f);
+    free(buf);
+
+    if (ret && n < 0) {
+        return 2;
+    }
+
+    return ret ? 0 : 1;
+}
+
+static int disasm_trace(const struct adis_options *opts,
+    struct adis_buffer *out)
+{
+    struct adis_trace *t = trace_new();
+    struct adis_image img;
+    struct adis_stream s;
+    const uint8_t *p;
+    size_t off, len;
+    uint64_t records;
+    int ret;
+
+    if (t == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 2;
+    }
+
+    ret = image_open_stream(&img, &s, opts->input);
+    if (ret == 1) {
+        // in slices so the output can be flushed along the way
+        for (off = 0; off < img.size; off += len) {
+            len = ADIS_MIN(img.size - off, (size_t)ADIS_FLUSH_SIZE);
+            trace_feed(t, img.data + off, len, !opts->trace_summary);
+            flush_output(out, 0);
+        }
+        image_close(&img);
+    } else if (ret == 2) {
+        while ((p = stream_next(&s, &len)) != NULL) {
+            trace_feed(t, p, len, !opts->trace_summary);
+            flush_output(out, 0);
+        }
+        ret = stream_close(&s);
+    }
+
+    if (ret && opts->trace_summary) {
+        trace_summary(t);
+    }
+
+    if (ret && opts->verbose) {
+        trace_stats(t, &records, &len);
+        fprintf(stderr, "adis: %llu trace records, %zu distinct "
+            "instructions\n", (unsigned long long)records, len);
+    }
+
+    trace_free(t);
+    return ret ? 0 : 2;
+}
+
+static int disasm_dedup(const struct adis_image *img, uint64_t start,
+    const struct adis_options *opts, struct adis_buffer *out)
+{
+    struct page_cache *pc = page_cache_new(opts->cache_dir);
+    size_t off, len, end = image_words_size(img);
+    size_t pages, unique, disk_hits;
+    int ret = 1;
+
+    if (pc == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Failed to create page cache\n");
+        return 0;
+    }
+
+    for (off = start; off < end && ret; off += ADIS_PAGE_SIZE) {
+        len = ADIS_MIN(end - off, (size_t)ADIS_PAGE_SIZE);
+        ret = page_disasm(pc, img->data + off, len, off, out);
+        flush_progress(out, off + len);
+    }
+
+    if (opts->verbose) {
+        page_cache_stats(pc, &pages, &unique, &disk_hits);
+        fprintf(stderr, "adis: %zu pages, %zu unique, %zu from cache\n",
+            pages, unique, disk_hits);
+    }
+
+    page_cache_free(pc);
+    return ret;
+}
+
+static int disasm_index(const struct adis_options *opts, struct adis_buffer *out)
+{
+    struct adis_index idx;
+    uint64_t addr, base, limit;
+    int ok = 1;
+
+    if (!index_open(&idx, opts->index)) {
+        return 0;
+    }
+
+    base = idx.hdr->base;
+    limit = ADIS_MIN(opts->end, base + idx.hdr->nrecords * 4);
+
+    // from the start of a record, so no record falls in two chunks
+    addr = opts->start < base ? base : opts->start - (opts->start - base) % 4;
+
+    // render in chunks so the output can be flushed along the way
+    for ( ; ok && addr < limit; addr += ADIS_FLUSH_SIZE) {
+        ok = index_disasm(&idx, addr, ADIS_MIN(addr + ADIS_FLUSH_SIZE, limit),
+            opts->cls);
+        flush_output(out, 0);
+    }
+
+    index_close(&idx);
+    return ok;
+}
+
+static int disasm_batch(const struct adis_options *opts)
+{
+    struct adis_checkpoint cp;
+    struct adis_batch b;
+    int i, ret;
+
+    batch_init(&b);
+
+    for (i = 0; i < opts->ninputs; i++) {
+        if (!batch_add(&b, opts->inputs[i])) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            batch_free(&b);
+            return 2;
+        }
+    }
+
+    if (opts->manifest != NULL && !batch_add_manifest(&b, opts->manifest)) {
+        batch_free(&b);
+        return 2;
+    }
+
+    if (opts->checkpoint != NULL && !checkpoint_open(&cp, opts->checkpoint,
+        b.paths, b.count, opts->resume)) {
+        batch_free(&b);
+        return 2;
+    }
+
+    ret = batch_run(&b, opts->outdir, opts->threads, opts->verbose,
+        opts->checkpoint != NULL ? &cp : NULL);
+
+    if (opts->checkpoint != NULL) {
+        checkpoint_free(&cp);
+    }
+    batch_free(&b);
+    return ret;
+}
+
+/*
+ * Where the code of an image is loaded: the executable segments of an ELF
+ * file, otherwise the whole image as one big-endian region at 0.
+ */
+static int get_regions(const struct adis_image *img, struct adis_elf *elf,
+    struct image_region *raw, struct image_region **regions,
+    size_t *nregions)
+{
+    memset(elf, 0, sizeof(*elf));
+
+    if (is_elf(img)) {
+        if (!elf_load(elf, img)) {
+            return 0;
         }
+        *regions = elf->regions;
+        *nregions = elf->nregions;
+    } else {
+        raw->data = img->data;
+        raw->addr = 0;
+        raw->size = ADIS_MIN(image_words_size(img), (size_t)0xFFFFFFFC);
+        raw->little_endian = 0;
+        *regions = raw;
+        *nregions = 1;
+    }
+
+    return 1;
+}
+
+static int disasm_recursive(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct image_region raw, *regions;
+    size_t nregions, nseeds = 0, i;
+    uint32_t *seeds;
+    struct adis_elf elf;
+    long count;
+
+    if (!get_regions(img, &elf, &raw, &regions, &nregions)) {
+        return 0;
+    }
+
+    seeds = malloc(sizeof(*seeds) * (elf.nsymbols + opts->nentries + 1));
+    if (seeds == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        elf_free(&elf);
+        return 0;
+    }
+
+    for (i = 0; i < opts->nentries; i++) {
+        seeds[nseeds++] = opts->entries[i];
+    }
+
+    if (nseeds == 0 && regions != &raw) {
+        // Thumb entry points are marked by their low bit
+        if (!(elf.entry & 1)) {
+            seeds[nseeds++] = elf.entry;
+        }
+        for (i = 0; i < elf.nsymbols; i++) {
+            seeds[nseeds++] = elf.symbols[i];
+        }
+    } else if (nseeds == 0) {
+        seeds[nseeds++] = 0;
+    }
+
+    count = recursive_disasm(regions, nregions, seeds, nseeds, stdout);
+    if (opts->verbose && count >= 0) {
+        fprintf(stderr, "adis: %ld reachable instructions from %zu entry "
+            "points\n", count, nseeds);
+    }
 
-        count += 4;
+    free(seeds);
+    elf_free(&elf);
+    return count >= 0;
+}
+
+static int disasm_profile(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct image_region raw, *regions;
+    struct adis_profile prof;
+    struct adis_elf elf;
+    size_t nregions;
+    long inside = -1;
+
+    if (!profile_load(&prof, opts->profile)) {
+        return 0;
+    }
+
+    if (get_regions(img, &elf, &raw, &regions, &nregions)) {
+        inside = profile_disasm(&prof, regions, nregions, opts->context,
+            stdout);
+        elf_free(&elf);
     }
 
-    return 0;
+    if (opts->verbose && inside >= 0) {
+        fprintf(stderr, "adis: %llu samples at %zu addresses, %ld in the "
+            "image, %llu not 32-bit\n", (unsigned long long)prof.total,
+            prof.n, inside, (unsigned long long)prof.ignored);
+    }
+
+    profile_free(&prof);
+    return inside >= 0;
+}
+
+static int disasm_cost(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct adis_cost cost;
+    long blocks;
+
+    if (!cost_load(&cost, opts->cost)) {
+        return 0;
+    }
+
+    blocks = cost_disasm(&cost, img, opts->regs, stdout);
+    if (opts->verbose && blocks >= 0) {
+        fprintf(stderr, "adis: %ld basic blocks\n", blocks);
+    }
+
+    return blocks >= 0;
+}
+
+static int report_loops(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    long count = loops_report(img, stdout);
+
+    if (opts->verbose && count >= 0) {
+        fprintf(stderr, "adis: %ld loops\n", count);
+    }
+
+    return count >= 0;
+}
+
+static int disasm_funcs(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct adis_funcs f;
+    int ret;
+
+    if (!funcs_find(&f, img)) {
+        return 0;
+    }
+
+    ret = funcs_report(&f, img, opts->funcs > 1, opts->threads, stdout);
+    if (opts->verbose && ret) {
+        fprintf(stderr, "adis: %zu functions\n", f.n);
+    }
+
+    funcs_free(&f);
+    return ret;
+}
+
+static int disasm_literals(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct adis_literals l;
+    long count;
+
+    if (!literals_find(&l, img)) {
+        return 0;
+    }
+
+    count = literals_disasm(&l, img, opts->literals > 1, stdout);
+    if (opts->verbose && count >= 0) {
+        fprintf(stderr, "adis: %ld PC-relative instructions, %zu literal "
+            "words\n", count, l.count);
+    }
+
+    literals_free(&l);
+    return count >= 0;
+}
+
+static int disasm_segments(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct adis_segments s;
+    size_t i, code = 0;
+    long count = 0;
+
+    if (!segment_image(&s, img)) {
+        return 0;
+    }
+
+    if (opts->segment > 1) {
+        segments_report(&s, stdout);
+    } else {
+        count = segments_disasm(&s, img, stdout);
+    }
+
+    if (opts->verbose && count >= 0) {
+        for (i = 0; i < s.n; i++) {
+            code += s.regions[i].code;
+        }
+        fprintf(stderr, "adis: %zu regions, %zu of them code\n", s.n, code);
+    }
+
+    segments_free(&s);
+    return count >= 0;
+}
+
+static int sample_mix(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    struct adis_sample s;
+
+    sample_init(&s, opts->sample, opts->stride);
+    if (!sample_image(&s, img)) {
+        return 0;
+    }
+
+    sample_report(&s, stdout);
+    return 1;
+}
+
+static int disasm_match(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    long count = match_disasm(&opts->match, img, opts->context, stdout);
+
+    if (opts->verbose && count >= 0) {
+        fprintf(stderr, "adis: %ld of %zu words matched\n", count,
+            image_words_size(img) / 4);
+    }
+
+    return count >= 0;
+}
+
+static int disasm_seq(const struct adis_image *img,
+    const struct adis_options *opts)
+{
+    long count = seq_disasm(&opts->seq, img, opts->context, stdout);
+
+    if (opts->verbose && count >= 0) {
+        fprintf(stderr, "adis: %ld matches of %zu patterns\n", count,
+            opts->seq.npats);
+    }
+
+    return count >= 0;
+}
+
+static int disasm_diff(const struct adis_options *opts)
+{
+    struct adis_image old, new;
+    int ret;
+
+    if (!image_open(&old, opts->inputs[0])) {
+        return 2;
+    } else if (!image_open(&new, opts->inputs[1])) {
+        image_close(&old);
+        return 2;
+    }
+
+    ret = diff_images(&old, &new, opts->context, stdout);
+
+    image_close(&old);
+    image_close(&new);
+    return ret < 0 ? 2 : ret;
+}
+
+/*
+ * Set up --checkpoint for plain disassembly. Returns the offset to start
+ * from, or -1 with the exit status in *status if there is nothing to do.
+ */
+static int64_t start_checkpoint(const struct adis_options *opts,
+    struct adis_checkpoint *cp, int *status)
+{
+    char *input = (char *)(opts->input != NULL ? opts->input : "-");
+    struct checkpoint_entry *e;
+    struct stat st;
+
+    *status = 2;
+
+    if (fstat(STDOUT_FILENO, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "ADIS_ERROR: --checkpoint needs the output "
+            "redirected to a file\n");
+        return -1;
+    } else if (!checkpoint_open(cp, opts->checkpoint, &input, 1,
+        opts->resume)) {
+        return -1;
+    }
+
+    e = &cp->entries[0];
+    if (e->state != ADIS_CHECKPOINT_RUN) {
+        *status = e->state == ADIS_CHECKPOINT_STOPPED;
+        checkpoint_free(cp);
+        return -1;
+    } else if (opts->resume && !checkpoint_rewind(e, stdout, "stdout")) {
+        checkpoint_free(cp);
+        return -1;
+    }
+
+    ckpt = cp;
+    return e->input_off;
+}
+
+int main(int argc, char **argv)
+{
+    struct adis_options opts;
+    struct adis_image img, view;
+    struct adis_buffer out;
+    struct adis_stream s;
+    struct adis_ring ring;
+    struct adis_compress comp;
+    struct adis_checkpoint cp;
+    int64_t start = 0;
+    uint64_t end;
+    int ret;
+
+    if (!parse_options(argc, argv, &opts)) {
+        return 2;
+    }
+
+    if (opts.daemon != NULL) {
+        return daemon_run(opts.daemon, opts.threads) ? 0 : 2;
+    } else if (opts.batch) {
+        return disasm_batch(&opts);
+    } else if (opts.diff) {
+        return disasm_diff(&opts);
+    }
+
+    buffer_init(&out);
+    set_output_buffer(&out);
+
+    if (opts.shm != NULL) {
+        if (!ring_create(&ring, opts.shm, opts.shm_size, opts.format)) {
+            return 2;
+        }
+        shm = &ring;
+    } else if (opts.compress != ADIS_STREAM_NONE) {
+        if (!compress_open(&comp, opts.compress, opts.threads, stdout)) {
+            return 2;
+        }
+        compressor = &comp;
+    }
+
+    if (opts.index != NULL) {
+        ret = disasm_index(&opts, &out);
+        finish_output(&out, &opts, ret);
+        return ret ? 0 : 2;
+    }
+
+    if (opts.checkpoint != NULL &&
+        (start = start_checkpoint(&opts, &cp, &ret)) < 0) {
+        return ret;
+    }
+
+    // a resumed run already has the header
+    if (start == 0) {
+        format_begin(opts.format);
+    }
+
+    if (opts.trace) {
+        ret = disasm_trace(&opts, &out);
+        finish_output(&out, &opts, ret == 0);
+        return ret;
+    } else if (opts.follow) {
+        ret = disasm_follow(&opts, &out);
+        finish_output(&out, &opts, ret == 0);
+        return ret;
+    }
+
+    ret = image_open_stream(&img, &s, opts.input);
+    if (ret == 0) {
+        finish_output(&out, &opts, 0);
+        return 2;
+    } else if (ret == 2 && !whole_image(&opts)) {
+        ret = disasm_stream(&s, start, &opts, &out, &end);
+        finish_output(&out, &opts, ret == 0);
+        finish_checkpoint(ret, end);
+        return ret;
+    } else if (ret == 2 && !image_read_stream(&img, &s)) {
+        finish_output(&out, &opts, 0);
+        return 2;
+    }
+
+    if ((uint64_t)start > img.size) {
+        fprintf(stderr, "ADIS_ERROR: Checkpoint is past the end of the "
+            "input\n");
+        image_close(&img);
+        return 2;
+    }
+
+    if (opts.write_index != NULL) {
+        ret = index_write(opts.write_index, &img, 0);
+        image_close(&img);
+        return ret ? 0 : 2;
+    } else if (opts.recursive) {
+        ret = disasm_recursive(&img, &opts);
+    } else if (opts.profile != NULL) {
+        ret = disasm_profile(&img, &opts);
+    } else if (opts.cost != NULL) {
+        ret = disasm_cost(&img, &opts);
+    } else if (opts.loops) {
+        ret = report_loops(&img, &opts);
+    } else if (opts.funcs) {
+        ret = disasm_funcs(&img, &opts);
+    } else if (opts.sample > 0) {
+        ret = sample_mix(&img, &opts);
+    } else if (opts.literals) {
+        ret = disasm_literals(&img, &opts);
+    } else if (opts.segment) {
+        ret = disasm_segments(&img, &opts);
+    } else if (opts.seq.npats > 0) {
+        ret = disasm_seq(&img, &opts);
+    } else if (opts.match.nterms > 0) {
+        ret = disasm_match(&img, &opts);
+    } else if (opts.dedup) {
+        ret = disasm_dedup(&img, start, &opts, &out);
+    } else {
+        view.data = img.data + start;
+        view.size = img.size - start;
+        view.mapped = 0;
+        ret = disasm_chunk(&view, start, &opts, &out);
+    }
+
+    finish_output(&out, &opts, ret);
+    finish_checkpoint(ret ? 0 : 1, img.size);
+    image_close(&img);
+
+    return ret ? 0 : 1;
 }
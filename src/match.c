@@ -0,0 +1,297 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "match.h"
+#include "opcodes.h"
+#include "predicates.h"
+#include "common.h"
+
+// Words compared per vector, and vectors per step of the scan loop
+#define ADIS_MATCH_LANES    4
+#define ADIS_MATCH_UNROLL   2
+#define ADIS_MATCH_STEP     (ADIS_MATCH_LANES * ADIS_MATCH_UNROLL)
+
+typedef uint32_t match_vec
+    __attribute__((vector_size(sizeof(uint32_t) * ADIS_MATCH_LANES)));
+
+#define ADIS_CLASS_TERM(_cls) \
+    { ADIS_##_cls##_MASK, ADIS_##_cls##_BITS, ADIS_CLASS_##_cls, -1 }
+
+// Prefilter for every class but unknown, in ADIS_CLASS_* order
+static const struct match_term class_terms[ADIS_NUM_CLASSES - 1] = {
+    ADIS_CLASS_TERM(SYNC), ADIS_CLASS_TERM(MISC), ADIS_CLASS_TERM(MULTI),
+    ADIS_CLASS_TERM(HW_MULTI), ADIS_CLASS_TERM(DP_REG),
+    ADIS_CLASS_TERM(DP_RSR), ADIS_CLASS_TERM(DP_IMM),
+    ADIS_CLASS_TERM(DP_OTHER), ADIS_CLASS_TERM(BRANCH),
+    ADIS_CLASS_TERM(DT_SINGLE), ADIS_CLASS_TERM(DT_BLOCK),
+    ADIS_CLASS_TERM(DT_EXTRA), ADIS_CLASS_TERM(DT_COPROC),
+    ADIS_CLASS_TERM(RT_COPROC), ADIS_CLASS_TERM(DATAOP_COPROC),
+    ADIS_CLASS_TERM(SW_INTERRUPT),
+};
+
+static int match_push(struct adis_match *m, const struct match_term *t)
+{
+    struct match_term *tmp;
+
+    if (m->nterms == m->size) {
+        m->size = m->size ? m->size * 2 : 8;
+        tmp = realloc(m->terms, sizeof(*tmp) * m->size);
+        if (tmp == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            return 0;
+        }
+        m->terms = tmp;
+    }
+
+    m->terms[m->nterms++] = *t;
+    return 1;
+}
+
+int match_parse_term(const char *spec, size_t len, struct match_term *t)
+{
+    char buf[64], *p;
+    int cls, id;
+
+    if (len == 0 || len >= sizeof(buf)) {
+        return 0;
+    }
+
+    memcpy(buf, spec, len);
+    buf[len] = 0;
+
+    if (!strncmp(buf, "class=", 6)) {
+        if ((cls = get_class_by_name(buf + 6)) < 0) {
+            return 0;
+        } else if (cls == ADIS_CLASS_UNKNOWN) {
+            // anything can fail to decode, there's nothing to prefilter on
+            t->mask = t->bits = 0;
+            t->cls = cls;
+        } else {
+            *t = class_terms[cls];
+        }
+        t->id = -1;
+        return 1;
+    }
+
+    if (!strncmp(buf, "op=", 3)) {
+        for (id = ADIS_OP_UNKNOWN + 1; id < ADIS_NUM_OPS; id++) {
+            if (!strcasecmp(buf + 3, get_opcode_string(id))) {
+                break;
+            }
+        }
+        t->mask = t->bits = 0;
+        t->cls = -1;
+        t->id = id;
+        return id < ADIS_NUM_OPS;
+    }
+
+    t->cls = -1;
+    t->id = -1;
+    t->mask = strtoul(buf, &p, 16);
+    if (p == buf || *p != ':') {
+        return 0;
+    }
+
+    spec = p + 1;
+    t->bits = strtoul(spec, &p, 16);
+    if (p == spec || *p != 0) {
+        return 0;
+    }
+
+    // bits outside the mask could never match
+    return (t->bits & ~t->mask) == 0;
+}
+
+int match_add(struct adis_match *m, const char *spec)
+{
+    struct match_term t;
+    const char *end;
+
+    for (;;) {
+        end = strchr(spec, ',');
+        if (end == NULL) {
+            end = spec + strlen(spec);
+        }
+
+        if (!match_parse_term(spec, end - spec, &t) || !match_push(m, &t)) {
+            return 0;
+        } else if (*end == 0) {
+            return 1;
+        }
+
+        spec = end + 1;
+    }
+}
+
+void match_free(struct adis_match *m)
+{
+    free(m->terms);
+    memset(m, 0, sizeof(*m));
+}
+
+int match_word(const struct adis_match *m, uint32_t op)
+{
+    struct adis_instr in;
+    size_t i;
+
+    decode_instr(op, &in);
+
+    for (i = 0; i < m->nterms; i++) {
+        if (match_term_test(&m->terms[i], &in)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Image words are big-endian, the vectors hold them in host order
+static inline uint32_t to_image_order(uint32_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap32(v);
+#else
+    return v;
+#endif
+}
+
+void match_out_init(struct match_out *mo, const struct adis_image *img,
+    size_t context, int separate, FILE *fp)
+{
+    mo->img = img;
+    mo->fp = fp;
+    mo->nwords = image_words_size(img) / 4;
+    mo->context = context;
+    mo->next = 0;
+    mo->separate = separate;
+    mo->printed = 0;
+
+    buffer_init(&mo->buf);
+    mo->prev = set_output_buffer(&mo->buf);
+}
+
+void match_out_range(struct match_out *mo, size_t first, size_t last)
+{
+    size_t start, end, i;
+
+    start = first > mo->context ? first - mo->context : 0;
+    start = ADIS_MAX(start, mo->next);
+    end = ADIS_MIN(last + mo->context + 1, mo->nwords);
+
+    if (mo->separate && mo->printed && start > mo->next) {
+        adis_printf("--\n");
+    }
+
+    for (i = start; i < end; i++) {
+        disasm_line(image_word(mo->img, i * 4), i * 4);
+    }
+
+    mo->next = ADIS_MAX(end, mo->next);
+    mo->printed = 1;
+
+    if (mo->buf.len >= ADIS_FLUSH_SIZE) {
+        buffer_flush(&mo->buf, mo->fp);
+    }
+}
+
+void match_out_finish(struct match_out *mo)
+{
+    buffer_flush(&mo->buf, mo->fp);
+    set_output_buffer(mo->prev);
+    buffer_free(&mo->buf);
+}
+
+long match_disasm(const struct adis_match *m, const struct adis_image *img,
+    size_t context, FILE *fp)
+{
+    struct match_out mo;
+    match_vec *masks, *bits, v[ADIS_MATCH_UNROLL], hit[ADIS_MATCH_UNROLL];
+    uint32_t any;
+    size_t i, t, w, u, l;
+    long count = 0;
+
+    masks = malloc(sizeof(*masks) * (m->nterms ? m->nterms : 1));
+    bits = malloc(sizeof(*bits) * (m->nterms ? m->nterms : 1));
+    if (masks == NULL || bits == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(masks);
+        free(bits);
+        return -1;
+    }
+
+    for (t = 0; t < m->nterms; t++) {
+        for (l = 0; l < ADIS_MATCH_LANES; l++) {
+            masks[t][l] = to_image_order(m->terms[t].mask);
+            bits[t][l] = to_image_order(m->terms[t].bits);
+        }
+    }
+
+    match_out_init(&mo, img, context, context > 0, fp);
+
+    /*
+     * Compare ADIS_MATCH_STEP words against every mask/value pair at once
+     * and only look at single words when one of them hit. Class and opcode
+     * terms still need their exact check, the mask only rules words out.
+     */
+    for (w = 0; w + ADIS_MATCH_STEP <= mo.nwords; w += ADIS_MATCH_STEP) {
+        for (u = 0; u < ADIS_MATCH_UNROLL; u++) {
+            memcpy(&v[u], img->data + (w + u * ADIS_MATCH_LANES) * 4,
+                sizeof(v[u]));
+            hit[u] = (match_vec){ 0 };
+        }
+
+        for (t = 0; t < m->nterms; t++) {
+            for (u = 0; u < ADIS_MATCH_UNROLL; u++) {
+                hit[u] |= (match_vec)((v[u] & masks[t]) == bits[t]);
+            }
+        }
+
+        for (any = 0, i = 0; i < ADIS_MATCH_STEP; i++) {
+            any |= hit[i / ADIS_MATCH_LANES][i % ADIS_MATCH_LANES];
+        }
+        if (!any) {
+            continue;
+        }
+
+        for (i = 0; i < ADIS_MATCH_STEP; i++) {
+            if (hit[i / ADIS_MATCH_LANES][i % ADIS_MATCH_LANES] &&
+                match_word(m, image_word(img, (w + i) * 4))) {
+                match_out_range(&mo, w + i, w + i);
+                count++;
+            }
+        }
+    }
+
+    for (; w < mo.nwords; w++) {
+        if (match_word(m, image_word(img, w * 4))) {
+            match_out_range(&mo, w, w);
+            count++;
+        }
+    }
+
+    match_out_finish(&mo);
+    free(masks);
+    free(bits);
+
+    return count;
+}
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_MATCH_H__
+#define __ADIS_MATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+
+#include "buffer.h"
+#include "decode.h"
+
+// Most --context words shown on either side of a hit
+#define ADIS_MATCH_MAX_CONTEXT  (1024 * 1024)
+
+/*
+ * One alternative of a --match expression: a word matches if
+ * (op & mask) == bits and, for class=NAME and op=NAME terms, it also
+ * decodes to that class or opcode (-1 if not checked). The class terms
+ * take their mask from predicates.h.
+ */
+struct match_term {
+    uint32_t mask;
+    uint32_t bits;
+    int cls;
+    int id;
+};
+
+struct adis_match {
+    struct match_term *terms;
+    size_t nterms;
+    size_t size;
+};
+
+// Parse a single MASK:VALUE, class=NAME or op=NAME spec of len bytes
+int match_parse_term(const char *spec, size_t len, struct match_term *t);
+
+static inline int match_term_test(const struct match_term *t,
+    const struct adis_instr *in)
+{
+    return (in->op & t->mask) == t->bits &&
+           (t->cls < 0 || in->cls == t->cls) &&
+           (t->id < 0 || in->id == t->id);
+}
+
+/*
+ * Add the terms of a comma separated list of specs. Returns 0 if the
+ * list doesn't parse.
+ */
+int match_add(struct adis_match *m, const char *spec);
+void match_free(struct adis_match *m);
+
+int match_word(const struct adis_match *m, uint32_t op);
+
+/*
+ * Prints ranges of image words in address order. Ranges are widened by
+ * context words on either side, overlapping parts are only printed once
+ * and, if separate is set, a "--" line goes between ranges that aren't
+ * adjacent.
+ */
+struct match_out {
+    const struct adis_image *img;
+    struct adis_buffer buf;
+    struct adis_buffer *prev;
+    FILE *fp;
+    size_t nwords;
+    size_t context;
+    size_t next;
+    int separate;
+    int printed;
+};
+
+void match_out_init(struct match_out *mo, const struct adis_image *img,
+    size_t context, int separate, FILE *fp);
+void match_out_range(struct match_out *mo, size_t first, size_t last);
+void match_out_finish(struct match_out *mo);
+
+/*
+ * Disassemble the words of img matching any term, with up to context
+ * words on either side. Separate groups are split by "--" lines. Returns
+ * the number of matching words, or -1 on error.
+ */
+long match_disasm(const struct adis_match *m, const struct adis_image *img,
+    size_t context, FILE *fp);
+
+#endif  // __ADIS_MATCH_H__
@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "misc.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_MISC_BX        0x0
@@ -110,7 +111,7 @@ static void saturating_instr(uint32_t op)
     cond = get_condition_string(op);
     opstr = get_saturating_operation_string(op);
 
-    printf("%s%s R%d,R%d,R%d\n", opstr, cond, ADIS_RD(op), ADIS_RM(op),
+    adis_printf("%s%s R%d,R%d,R%d\n", opstr, cond, ADIS_RD(op), ADIS_RM(op),
         ADIS_RN(op));
 }
 
@@ -122,7 +123,7 @@ void misc_instr(uint32_t op)
     misc_type = get_misc_instr(op);
 
     if (misc_type == ADIS_MISC_UNKNOWN) {
-        printf("Unrecognized instruction 0x%x\n", op);
+        adis_printf("Unrecognized instruction 0x%x\n", op);
         return;
     }
 
@@ -134,15 +135,29 @@ void misc_instr(uint32_t op)
     cond = get_condition_string(op);
     opstr = get_misc_instr_string(misc_type);
 
-    printf("%s%s ", opstr, cond);
+    adis_printf("%s%s ", opstr, cond);
 
     if (misc_type == ADIS_MISC_CLZ) {
-        printf("R%d,R%d\n", ADIS_RD(op), ADIS_RM(op));
+        adis_printf("R%d,R%d\n", ADIS_RD(op), ADIS_RM(op));
     } else if (misc_type == ADIS_MISC_BKPT) {
-        printf("=0x%x\n", ((op & 0x000FFF00) << 4) | (op & 0x0000000F));
+        adis_printf("=0x%x\n", ((op & 0x000FFF00) << 4) | (op & 0x0000000F));
     } else if (misc_type == ADIS_MISC_SMC) {
-        printf("=0x%x\n", op & 0x0000000F);
+        adis_printf("=0x%x\n", op & 0x0000000F);
     } else {
-        printf("R%d\n", ADIS_RM(op));
+        adis_printf("R%d\n", ADIS_RM(op));
     }
 }
+
+int misc_opcode(uint32_t op)
+{
+    int misc_type = get_misc_instr(op);
+
+    if (misc_type == ADIS_MISC_UNKNOWN) {
+        return ADIS_OP_UNKNOWN;
+    } else if (misc_type == ADIS_MISC_SAT) {
+        return ADIS_OP_QADD + ((op & 0x00600000) >> 21);
+    }
+
+    // ADIS_MISC_* are in the same order as the opcode IDs
+    return ADIS_OP_BX + misc_type;
+}
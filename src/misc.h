@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void misc_instr(uint32_t op);
+int misc_opcode(uint32_t op);
 
 #endif  // __ADIS_MISC_H__
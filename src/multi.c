@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "multi.h"
+#include "opcodes.h"
 #include "common.h"
 
 // For some reason, these two registers are switched
@@ -69,10 +70,15 @@ static int is_mls_instr(uint32_t op)
 }
 
 // Used for long multiplication instructions
+static int get_long_multi_index(uint32_t op)
+{
+    return (ADIS_ACCUM_BIT(op) >> 21) | (ADIS_SIGNED_BIT(op) ? 0 : 2);
+}
+
 static char *get_operation_string(uint32_t op)
 {
     static char *opstr[4] = {"SMULL", "SMLAL", "UMULL", "UMLAL"};
-    return opstr[ADIS_ACCUM_BIT(op) | (ADIS_SIGNED_BIT(op) << 1)];
+    return opstr[get_long_multi_index(op)];
 }
 
 static void long_multi_instr(uint32_t op)
@@ -83,7 +89,7 @@ static void long_multi_instr(uint32_t op)
     opstr = get_operation_string(op);
     setcond = ADIS_SETCOND_BIT(op) ? 'S' : 0;
     
-    printf("%s%s%c R%d,R%d,R%d,R%d\n", opstr, cond, setcond, ADIS_RDLO(op),
+    adis_printf("%s%s%c R%d,R%d,R%d,R%d\n", opstr, cond, setcond, ADIS_RDLO(op),
         ADIS_RDHI(op), ADIS_RM(op), ADIS_RN(op));
 }
 
@@ -94,7 +100,7 @@ void multi_instr(uint32_t op)
 
     if (is_mls_instr(op)) {
         // We can process this immediately without checking other bits
-        printf("MLS%s R%d,R%d,R%d,R%d\n", cond, ADIS_RD(op), ADIS_RN(op),
+        adis_printf("MLS%s R%d,R%d,R%d,R%d\n", cond, ADIS_RD(op), ADIS_RN(op),
             ADIS_RS(op), ADIS_RM(op));
         return;
     } else if (ADIS_LONG_BIT(op)) {
@@ -108,10 +114,10 @@ void multi_instr(uint32_t op)
 
     if (ADIS_ACCUM_BIT(op)) {
         // multiply and accumulate
-        printf("MLA%s%c R%d,R%d,R%d,R%d\n", cond, setcond, ADIS_RD(op), 
+        adis_printf("MLA%s%c R%d,R%d,R%d,R%d\n", cond, setcond, ADIS_RD(op), 
             ADIS_RM(op), ADIS_RN(op), ADIS_RS(op));
     } else {
-        printf("MUL%s%c R%d,R%d,R%d\n", cond, setcond, ADIS_RD(op),
+        adis_printf("MUL%s%c R%d,R%d,R%d\n", cond, setcond, ADIS_RD(op),
             ADIS_RM(op), ADIS_RN(op));
     }
 }
@@ -150,10 +156,34 @@ void halfword_multi_instr(uint32_t op)
     rn_half = ADIS_HW_RNHI_BIT(op) ? 'T' : 'B';
 
     if (accum) {
-        printf("%s%s%c%c R%d,R%d,R%d,R%d\n", opstr, cond, rm_half, rn_half,
+        adis_printf("%s%s%c%c R%d,R%d,R%d,R%d\n", opstr, cond, rm_half, rn_half,
             ADIS_RD(op), ADIS_RM(op), ADIS_RN(op), ADIS_RS(op));
     } else {
-        printf("%s%s%c%c R%d,R%d,R%d\n", opstr, cond, rm_half, rn_half,
+        adis_printf("%s%s%c%c R%d,R%d,R%d\n", opstr, cond, rm_half, rn_half,
             ADIS_RD(op), ADIS_RM(op), ADIS_RN(op));
     }
 }
+
+int multi_opcode(uint32_t op)
+{
+    if (is_mls_instr(op)) {
+        return ADIS_OP_MLS;
+    } else if (ADIS_LONG_BIT(op)) {
+        return ADIS_OP_SMULL + get_long_multi_index(op);
+    }
+
+    return ADIS_ACCUM_BIT(op) ? ADIS_OP_MLA : ADIS_OP_MUL;
+}
+
+int halfword_multi_opcode(uint32_t op)
+{
+    if (ADIS_HW_ACCUM(op)) {
+        return ADIS_OP_SMLAXY;
+    } else if (ADIS_HW_LACCUM(op)) {
+        return ADIS_OP_SMLALXY;
+    } else if (ADIS_HW_RESULT(op)) {
+        return ADIS_OP_SMULXY;
+    }
+
+    return ADIS_HW_MIXED_RESULT_BIT(op) ? ADIS_OP_SMULWY : ADIS_OP_SMLAWY;
+}
@@ -24,4 +24,7 @@
 void multi_instr(uint32_t op);
 void halfword_multi_instr(uint32_t op);
 
+int multi_opcode(uint32_t op);
+int halfword_multi_opcode(uint32_t op);
+
 #endif  // __ADIS_MULTI_H__
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_OPCODES_H__
+#define __ADIS_OPCODES_H__
+
+/*
+ * Opcode IDs identify the operation of a decoded instruction independent
+ * of its condition, operands and addressing mode. The data-processing
+ * IDs are in the same order as ADIS_DATAPROC_* in dataproc.c.
+ */
+#define ADIS_OP_UNKNOWN     0
+
+// data-processing
+#define ADIS_OP_AND         1
+#define ADIS_OP_EOR         2
+#define ADIS_OP_SUB         3
+#define ADIS_OP_RSB         4
+#define ADIS_OP_ADD         5
+#define ADIS_OP_ADC         6
+#define ADIS_OP_SBC         7
+#define ADIS_OP_RSC         8
+#define ADIS_OP_TST         9
+#define ADIS_OP_TEQ         10
+#define ADIS_OP_CMP         11
+#define ADIS_OP_CMN         12
+#define ADIS_OP_ORR         13
+#define ADIS_OP_MOV         14
+#define ADIS_OP_BIC         15
+#define ADIS_OP_MVN         16
+#define ADIS_OP_LSL         17
+#define ADIS_OP_LSR         18
+#define ADIS_OP_ASR         19
+#define ADIS_OP_ROR         20
+#define ADIS_OP_RRX         21
+#define ADIS_OP_ADR         22
+#define ADIS_OP_MOVW        23
+#define ADIS_OP_MOVT        24
+
+// multiply
+#define ADIS_OP_MUL         25
+#define ADIS_OP_MLA         26
+#define ADIS_OP_MLS         27
+#define ADIS_OP_SMULL       28
+#define ADIS_OP_SMLAL       29
+#define ADIS_OP_UMULL       30
+#define ADIS_OP_UMLAL       31
+
+// halfword multiply
+#define ADIS_OP_SMLAXY      32
+#define ADIS_OP_SMLALXY     33
+#define ADIS_OP_SMULXY      34
+#define ADIS_OP_SMULWY      35
+#define ADIS_OP_SMLAWY      36
+
+// miscellaneous
+#define ADIS_OP_BX          37
+#define ADIS_OP_CLZ         38
+#define ADIS_OP_BXJ         39
+#define ADIS_OP_BLX         40
+#define ADIS_OP_BKPT        41
+#define ADIS_OP_SMC         42
+#define ADIS_OP_QADD        43
+#define ADIS_OP_QDADD       44
+#define ADIS_OP_QSUB        45
+#define ADIS_OP_QDSUB       46
+
+// branch
+#define ADIS_OP_B           47
+#define ADIS_OP_BL          48
+
+// synchronization primitives
+#define ADIS_OP_SWP         49
+#define ADIS_OP_SWPB        50
+#define ADIS_OP_LDREX       51
+#define ADIS_OP_STREX       52
+#define ADIS_OP_LDREXB      53
+#define ADIS_OP_STREXB      54
+#define ADIS_OP_LDREXH      55
+#define ADIS_OP_STREXH      56
+#define ADIS_OP_LDREXD      57
+#define ADIS_OP_STREXD      58
+
+// single data transfer
+#define ADIS_OP_LDR         59
+#define ADIS_OP_STR         60
+#define ADIS_OP_LDRB        61
+#define ADIS_OP_STRB        62
+
+// block data transfer
+#define ADIS_OP_LDM         63
+#define ADIS_OP_STM         64
+
+// halfword, signed and dual data transfer
+#define ADIS_OP_LDRH        65
+#define ADIS_OP_STRH        66
+#define ADIS_OP_LDRSB       67
+#define ADIS_OP_STRSB       68
+#define ADIS_OP_LDRSH       69
+#define ADIS_OP_STRSH       70
+#define ADIS_OP_LDRD        71
+#define ADIS_OP_STRD        72
+
+// coprocessor
+#define ADIS_OP_LDC         73
+#define ADIS_OP_STC         74
+#define ADIS_OP_MCR         75
+#define ADIS_OP_MRC         76
+#define ADIS_OP_CDP         77
+
+// software interrupt
+#define ADIS_OP_SWI         78
+
+#define ADIS_NUM_OPS        79
+
+#endif  // __ADIS_OPCODES_H__
@@ -0,0 +1,561 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "page.h"
+#include "decode.h"
+#include "common.h"
+
+#define ADIS_PAGE_BUCKETS   1024
+#define ADIS_PAGE_SEEN_INIT 4096
+
+/*
+ * Rendered pages kept in memory, least recently used ones are dropped
+ * past this. A page is only kept once it was seen a second time.
+ */
+#define ADIS_PAGE_CACHE_BYTES   (64 * 1024 * 1024)
+
+// More output than any word renders to, a bound for cache entries
+#define ADIS_PAGE_WORD_MAX      512
+
+/*
+ * On-disk entries start with this magic. Bump the version whenever the
+ * rendered text of any instruction changes so stale entries are ignored.
+ */
+#define ADIS_CACHE_MAGIC    "ADISPG"
+#define ADIS_CACHE_VERSION  3
+
+struct cache_header {
+    char magic[6];
+    uint16_t version;
+    uint32_t len;
+    uint32_t complete;
+    uint32_t nfixups;
+    uint32_t body_len;
+};
+
+struct page_entry {
+    uint64_t hash;
+    uint8_t bytes[ADIS_PAGE_SIZE];
+    size_t len;
+    int complete;
+    struct adis_buffer body;
+    // offset of the address column of each line in body
+    uint32_t fixups[ADIS_PAGE_SIZE / 4];
+    size_t nfixups;
+    struct page_entry *next;
+    // least recently used list, most recent first
+    struct page_entry *lru_prev;
+    struct page_entry *lru_next;
+};
+
+struct page_cache {
+    struct page_entry **buckets;
+    size_t nbuckets;
+    size_t nentries;
+    size_t bytes;
+    struct page_entry *lru_head;
+    struct page_entry *lru_tail;
+    // hashes of every page seen so far, open addressing, 0 is empty
+    uint64_t *seen;
+    size_t seen_size;
+    size_t unique;
+    size_t pages;
+    size_t disk_hits;
+    char *dir;
+};
+
+struct page_cache *page_cache_new(const char *dir)
+{
+    struct page_cache *pc = malloc(sizeof(*pc));
+
+    if (pc == NULL) {
+        return NULL;
+    }
+
+    pc->nbuckets = ADIS_PAGE_BUCKETS;
+    pc->buckets = calloc(pc->nbuckets, sizeof(*pc->buckets));
+    pc->nentries = 0;
+    pc->bytes = 0;
+    pc->lru_head = NULL;
+    pc->lru_tail = NULL;
+    pc->seen_size = ADIS_PAGE_SEEN_INIT;
+    pc->seen = calloc(pc->seen_size, sizeof(*pc->seen));
+    pc->unique = 0;
+    pc->pages = 0;
+    pc->disk_hits = 0;
+    pc->dir = NULL;
+
+    if (pc->buckets == NULL || pc->seen == NULL) {
+        free(pc->buckets);
+        free(pc->seen);
+        free(pc);
+        return NULL;
+    }
+
+    if (dir != NULL) {
+        if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+            perror(dir);
+            page_cache_free(pc);
+            return NULL;
+        }
+
+        pc->dir = strdup(dir);
+        if (pc->dir == NULL) {
+            page_cache_free(pc);
+            return NULL;
+        }
+    }
+
+    return pc;
+}
+
+void page_cache_free(struct page_cache *pc)
+{
+    struct page_entry *e, *next;
+    size_t i;
+
+    if (pc == NULL) {
+        return;
+    }
+
+    for (i = 0; i < pc->nbuckets; i++) {
+        for (e = pc->buckets[i]; e != NULL; e = next) {
+            next = e->next;
+            buffer_free(&e->body);
+            free(e);
+        }
+    }
+
+    free(pc->buckets);
+    free(pc->seen);
+    free(pc->dir);
+    free(pc);
+}
+
+static int seen_insert(uint64_t *seen, size_t size, uint64_t hash)
+{
+    size_t i;
+
+    for (i = hash & (size - 1); seen[i] != 0; i = (i + 1) & (size - 1)) {
+        if (seen[i] == hash) {
+            return 0;
+        }
+    }
+
+    seen[i] = hash;
+    return 1;
+}
+
+/*
+ * Record a page hash, returns 0 if it was seen before. Different pages
+ * with the same hash only make a page be kept when it didn't need to.
+ */
+static int page_seen(struct page_cache *pc, uint64_t hash)
+{
+    uint64_t *seen;
+    size_t i, n;
+
+    hash = hash ? hash : 1;
+    if (!seen_insert(pc->seen, pc->seen_size, hash)) {
+        return 1;
+    }
+
+    // keep it at most half full
+    if (++pc->unique > pc->seen_size / 2) {
+        n = pc->seen_size * 2;
+        if ((seen = calloc(n, sizeof(*seen))) != NULL) {
+            for (i = 0; i < pc->seen_size; i++) {
+                if (pc->seen[i] != 0) {
+                    seen_insert(seen, n, pc->seen[i]);
+                }
+            }
+            free(pc->seen);
+            pc->seen = seen;
+            pc->seen_size = n;
+        }
+    }
+
+    return 0;
+}
+
+static void page_cache_grow(struct page_cache *pc)
+{
+    struct page_entry **buckets, *e, *next;
+    size_t i, n = pc->nbuckets * 2;
+
+    buckets = calloc(n, sizeof(*buckets));
+    if (buckets == NULL) {
+        // keep the old table, chains just get longer
+        return;
+    }
+
+    for (i = 0; i < pc->nbuckets; i++) {
+        for (e = pc->buckets[i]; e != NULL; e = next) {
+            next = e->next;
+            e->next = buckets[e->hash & (n - 1)];
+            buckets[e->hash & (n - 1)] = e;
+        }
+    }
+
+    free(pc->buckets);
+    pc->buckets = buckets;
+    pc->nbuckets = n;
+}
+
+static struct page_entry *
+page_lookup(struct page_cache *pc, uint64_t hash, const uint8_t *page, size_t len)
+{
+    struct page_entry *e;
+
+    for (e = pc->buckets[hash & (pc->nbuckets - 1)]; e != NULL; e = e->next) {
+        if (e->hash == hash && e->len == len && !memcmp(e->bytes, page, len)) {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+static void lru_unlink(struct page_cache *pc, struct page_entry *e)
+{
+    if (e->lru_prev != NULL) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        pc->lru_head = e->lru_next;
+    }
+
+    if (e->lru_next != NULL) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        pc->lru_tail = e->lru_prev;
+    }
+}
+
+static void lru_push(struct page_cache *pc, struct page_entry *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = pc->lru_head;
+    if (pc->lru_head != NULL) {
+        pc->lru_head->lru_prev = e;
+    } else {
+        pc->lru_tail = e;
+    }
+    pc->lru_head = e;
+}
+
+static size_t entry_bytes(const struct page_entry *e)
+{
+    return sizeof(*e) + e->body.size;
+}
+
+// Drop the least recently used pages until there is room for one more
+static void page_evict(struct page_cache *pc)
+{
+    struct page_entry *e, **link;
+
+    while (pc->lru_tail != NULL && pc->bytes > ADIS_PAGE_CACHE_BYTES) {
+        e = pc->lru_tail;
+        lru_unlink(pc, e);
+
+        link = &pc->buckets[e->hash & (pc->nbuckets - 1)];
+        while (*link != e) {
+            link = &(*link)->next;
+        }
+        *link = e->next;
+
+        pc->bytes -= entry_bytes(e);
+        pc->nentries--;
+        buffer_free(&e->body);
+        free(e);
+    }
+}
+
+// Render a page body with addresses relative to the start of the page
+static void page_render(struct page_entry *e)
+{
+    struct adis_buffer *prev = set_output_buffer(&e->body);
+    const uint8_t *p;
+    uint32_t op;
+    size_t off;
+
+    e->complete = 1;
+    e->nfixups = 0;
+
+    for (off = 0; off < e->len; off += 4) {
+        p = e->bytes + off;
+        op = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+             ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+
+        e->fixups[e->nfixups++] = e->body.len + ADIS_ADDR_COLUMN;
+        if (!disasm_line(op, off)) {
+            e->complete = 0;
+            break;
+        }
+    }
+
+    set_output_buffer(prev);
+}
+
+static void write_hex32(char *dst, uint32_t val)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        dst[i] = digits[val & 0xF];
+        val >>= 4;
+    }
+}
+
+static void cache_path(struct page_cache *pc, uint64_t hash, char *buf, size_t bsize)
+{
+    snprintf(buf, bsize, "%s/%.16llx", pc->dir, (unsigned long long)hash);
+}
+
+static int read_full(int fd, void *data, size_t len)
+{
+    uint8_t *p = data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(fd, p, len);
+        if (n <= 0) {
+            return 0;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return 1;
+}
+
+static int write_full(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n < 0) {
+            return 0;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return 1;
+}
+
+/*
+ * Look the page up in the cache directory. The entry stores the page
+ * bytes next to the rendered body, so a hash collision is simply a miss.
+ */
+static int cache_load(struct page_cache *pc, struct page_entry *e)
+{
+    struct cache_header hdr;
+    uint8_t bytes[ADIS_PAGE_SIZE];
+    char path[4096];
+    int fd, ok = 0;
+    size_t i;
+
+    cache_path(pc, e->hash, path, sizeof(path));
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return 0;
+    }
+
+    if (!read_full(fd, &hdr, sizeof(hdr)) ||
+        memcmp(hdr.magic, ADIS_CACHE_MAGIC, sizeof(hdr.magic)) ||
+        hdr.version != ADIS_CACHE_VERSION || hdr.len != e->len ||
+        hdr.nfixups > e->len / 4 ||
+        hdr.body_len > (e->len / 4) * ADIS_PAGE_WORD_MAX) {
+        goto out;
+    }
+
+    if (!read_full(fd, bytes, hdr.len) || memcmp(bytes, e->bytes, e->len)) {
+        goto out;
+    }
+
+    if (!read_full(fd, e->fixups, hdr.nfixups * sizeof(e->fixups[0]))) {
+        goto out;
+    }
+
+    buffer_reserve(&e->body, hdr.body_len);
+    if (!read_full(fd, e->body.data, hdr.body_len)) {
+        goto out;
+    }
+
+    // page_emit() writes an address at every fixup
+    for (i = 0; i < hdr.nfixups; i++) {
+        if ((uint64_t)e->fixups[i] + 8 > hdr.body_len) {
+            goto out;
+        }
+    }
+
+    e->body.len = hdr.body_len;
+    e->nfixups = hdr.nfixups;
+    e->complete = hdr.complete;
+    ok = 1;
+
+out:
+    close(fd);
+    return ok;
+}
+
+// Write to a temporary file and rename it, readers never see partial entries
+static void cache_store(struct page_cache *pc, struct page_entry *e)
+{
+    struct cache_header hdr;
+    char path[4096], tmp[4096 + 32];
+    int fd, ok;
+
+    memcpy(hdr.magic, ADIS_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = ADIS_CACHE_VERSION;
+    hdr.len = e->len;
+    hdr.complete = e->complete;
+    hdr.nfixups = e->nfixups;
+    hdr.body_len = e->body.len;
+
+    cache_path(pc, e->hash, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+        return;
+    }
+
+    ok = write_full(fd, &hdr, sizeof(hdr)) &&
+         write_full(fd, e->bytes, e->len) &&
+         write_full(fd, e->fixups, e->nfixups * sizeof(e->fixups[0])) &&
+         write_full(fd, e->body.data, e->body.len);
+
+    if (close(fd) != 0 || !ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+}
+
+// Copy a rendered body to out, rewriting the address column of every line
+static void page_emit(struct page_entry *e, uint32_t addr, struct adis_buffer *out)
+{
+    char *start;
+    size_t i;
+
+    buffer_write(out, e->body.data, e->body.len);
+
+    if (addr == 0) {
+        return;
+    }
+
+    start = out->data + out->len - e->body.len;
+    for (i = 0; i < e->nfixups; i++) {
+        write_hex32(start + e->fixups[i], addr + i * 4);
+    }
+}
+
+// A page seen for the first time goes straight to out
+static int page_render_direct(const uint8_t *page, size_t len, uint32_t addr,
+    struct adis_buffer *out)
+{
+    struct adis_buffer *prev = set_output_buffer(out);
+    const uint8_t *p;
+    size_t off;
+    int ok = 1;
+
+    for (off = 0; off < len && ok; off += 4) {
+        p = page + off;
+        ok = disasm_line(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+            ((uint32_t)p[2] << 8) | (uint32_t)p[3], addr + off);
+    }
+
+    set_output_buffer(prev);
+    return ok;
+}
+
+int page_disasm(struct page_cache *pc, const uint8_t *page, size_t len,
+    uint32_t addr, struct adis_buffer *out)
+{
+    uint64_t hash = adis_hash64(page, len);
+    struct page_entry *e;
+    int seen;
+
+    pc->pages++;
+
+    e = page_lookup(pc, hash, page, len);
+    if (e != NULL) {
+        lru_unlink(pc, e);
+        lru_push(pc, e);
+    } else {
+        /*
+         * Only hashes are kept for pages seen once, most pages of an
+         * image never come back. With a cache directory every page is
+         * looked up and stored there anyway.
+         */
+        seen = page_seen(pc, hash);
+        if (!seen && pc->dir == NULL) {
+            return page_render_direct(page, len, addr, out);
+        }
+
+        e = malloc(sizeof(*e));
+        if (e == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            exit(1);
+        }
+
+        e->hash = hash;
+        e->len = len;
+        memcpy(e->bytes, page, len);
+        buffer_init(&e->body);
+
+        if (pc->dir != NULL && cache_load(pc, e)) {
+            pc->disk_hits++;
+        } else {
+            buffer_free(&e->body);
+            page_render(e);
+            if (pc->dir != NULL) {
+                cache_store(pc, e);
+            }
+        }
+
+        e->next = pc->buckets[hash & (pc->nbuckets - 1)];
+        pc->buckets[hash & (pc->nbuckets - 1)] = e;
+        lru_push(pc, e);
+        pc->bytes += entry_bytes(e);
+
+        if (++pc->nentries > pc->nbuckets) {
+            page_cache_grow(pc);
+        }
+        page_evict(pc);
+    }
+
+    page_emit(e, addr, out);
+    return e->complete;
+}
+
+void page_cache_stats(struct page_cache *pc, size_t *pages, size_t *unique,
+    size_t *disk_hits)
+{
+    *pages = pc->pages;
+    *unique = pc->unique;
+    *disk_hits = pc->disk_hits;
+}
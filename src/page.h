@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_PAGE_H__
+#define __ADIS_PAGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+#define ADIS_PAGE_SIZE      4096
+
+/*
+ * Images often repeat whole pages (duplicated libraries, padding, tables).
+ * A page cache keeps the rendered body of pages that show up more than
+ * once, with addresses relative to the start of the page, and only
+ * rewrites the address column when the same page shows up again. Pages
+ * seen once are only remembered by their hash, and the bodies kept are
+ * bounded, the least recently used ones going first.
+ */
+struct page_cache;
+
+/*
+ * If dir isn't NULL, rendered pages are also kept on disk in that
+ * directory, named by the hash of their contents, so later runs over a
+ * mostly unchanged image only decode the pages that changed.
+ */
+struct page_cache *page_cache_new(const char *dir);
+void page_cache_free(struct page_cache *pc);
+
+/*
+ * Disassemble one page (len is a multiple of 4, at most ADIS_PAGE_SIZE)
+ * located at addr into out. Returns 0 if an unrecognized instruction
+ * ended the page early.
+ */
+int page_disasm(struct page_cache *pc, const uint8_t *page, size_t len,
+    uint32_t addr, struct adis_buffer *out);
+
+void page_cache_stats(struct page_cache *pc, size_t *pages, size_t *unique,
+    size_t *disk_hits);
+
+#endif  // __ADIS_PAGE_H__
@@ -0,0 +1,309 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "buffer.h"
+
+/*
+ * Every worker owns a deque of tasks. A worker pushes the tasks it
+ * submits itself onto the bottom of its own deque and takes work from
+ * there first (newest first, which keeps a file and its chunks on one
+ * CPU). Idle workers steal from the top of the other deques (oldest
+ * first), so a few huge inputs can't keep the small ones waiting while
+ * other CPUs sit idle. Tasks submitted from outside the pool are spread
+ * over the deques round-robin.
+ */
+struct pool_task {
+    pool_task_fn fn;
+    void *arg;
+    struct pool_task *prev;
+    struct pool_task *next;
+};
+
+struct pool_deque {
+    pthread_mutex_t lock;
+    struct pool_task *top;
+    struct pool_task *bottom;
+};
+
+struct pool_worker {
+    struct adis_pool *pool;
+    struct pool_deque deque;
+    pthread_t thread;
+    int index;
+};
+
+struct adis_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    size_t queued;
+    size_t pending;
+    unsigned next;
+    int shutdown;
+    int nthreads;
+    struct pool_worker *workers;
+};
+
+static __thread struct pool_worker *current_worker;
+
+static void deque_push_bottom(struct pool_deque *dq, struct pool_task *task)
+{
+    pthread_mutex_lock(&dq->lock);
+    task->next = NULL;
+    task->prev = dq->bottom;
+    if (dq->bottom != NULL) {
+        dq->bottom->next = task;
+    } else {
+        __atomic_store_n(&dq->top, task, __ATOMIC_RELAXED);
+    }
+    dq->bottom = task;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+static struct pool_task *deque_pop_bottom(struct pool_deque *dq)
+{
+    struct pool_task *task;
+
+    pthread_mutex_lock(&dq->lock);
+    task = dq->bottom;
+    if (task != NULL) {
+        dq->bottom = task->prev;
+        if (dq->bottom != NULL) {
+            dq->bottom->next = NULL;
+        } else {
+            __atomic_store_n(&dq->top, NULL, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return task;
+}
+
+static struct pool_task *deque_steal_top(struct pool_deque *dq)
+{
+    struct pool_task *task;
+
+    // cheap unlocked peek, most deques are empty when stealing
+    if (__atomic_load_n(&dq->top, __ATOMIC_RELAXED) == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&dq->lock);
+    task = dq->top;
+    if (task != NULL) {
+        __atomic_store_n(&dq->top, task->next, __ATOMIC_RELAXED);
+        if (dq->top != NULL) {
+            dq->top->prev = NULL;
+        } else {
+            dq->bottom = NULL;
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return task;
+}
+
+static struct pool_task *pool_find_task(struct pool_worker *self)
+{
+    struct adis_pool *pool = self->pool;
+    struct pool_task *task;
+    int i;
+
+    if ((task = deque_pop_bottom(&self->deque)) != NULL) {
+        return task;
+    }
+
+    for (i = 1; i < pool->nthreads; i++) {
+        task = deque_steal_top(&pool->workers[(self->index + i) %
+            pool->nthreads].deque);
+        if (task != NULL) {
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+static void *pool_worker_main(void *arg)
+{
+    struct pool_worker *self = arg;
+    struct adis_pool *pool = self->pool;
+    struct adis_buffer out;
+    struct pool_task *task;
+
+    current_worker = self;
+    buffer_init(&out);
+    set_output_buffer(&out);
+
+    for (;;) {
+        task = pool_find_task(self);
+
+        if (task == NULL) {
+            pthread_mutex_lock(&pool->lock);
+            while (!__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) &&
+                   !pool->shutdown) {
+                pthread_cond_wait(&pool->work, &pool->lock);
+            }
+            if (!__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) &&
+                pool->shutdown) {
+                pthread_mutex_unlock(&pool->lock);
+                break;
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+
+        task->fn(task->arg);
+        free(task);
+        out.len = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    buffer_free(&out);
+    return NULL;
+}
+
+struct adis_pool *pool_new(int nthreads)
+{
+    struct adis_pool *pool = calloc(1, sizeof(*pool));
+    int i;
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (nthreads <= 0) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads <= 0) {
+            nthreads = 1;
+        }
+    }
+
+    pool->workers = calloc(nthreads, sizeof(*pool->workers));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    // all deques must exist before any worker starts stealing
+    for (i = 0; i < nthreads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pthread_mutex_init(&pool->workers[i].deque.lock, NULL);
+    }
+
+    pool->nthreads = nthreads;
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, pool_worker_main,
+                &pool->workers[i]) != 0) {
+            // only join the workers that did start
+            pool->nthreads = i;
+            pool_free(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void pool_free(struct adis_pool *pool)
+{
+    int i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < pool->nthreads; i++) {
+        pthread_mutex_destroy(&pool->workers[i].deque.lock);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->workers);
+    free(pool);
+}
+
+int pool_size(struct adis_pool *pool)
+{
+    return pool->nthreads;
+}
+
+void pool_submit(struct adis_pool *pool, pool_task_fn fn, void *arg)
+{
+    struct pool_task *task = malloc(sizeof(*task));
+    struct pool_worker *w = current_worker;
+
+    if (task == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        exit(1);
+    }
+
+    task->fn = fn;
+    task->arg = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->pending++;
+    if (w == NULL || w->pool != pool) {
+        w = &pool->workers[pool->next++ % pool->nthreads];
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    deque_push_bottom(&w->deque, task);
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_wait(struct adis_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
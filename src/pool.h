@@ -0,0 +1,47 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_POOL_H__
+#define __ADIS_POOL_H__
+
+/*
+ * Fixed-size work-stealing pool of worker threads running submitted
+ * tasks. Tasks may submit more tasks (e.g. a file splitting itself into
+ * chunks); those stay with the submitting worker unless an idle worker
+ * steals them. Each worker has its own output buffer installed (see
+ * buffer.h), tasks that render text swap in their own buffer and put
+ * the old one back when done.
+ */
+struct adis_pool;
+
+typedef void (*pool_task_fn)(void *arg);
+
+// Most threads a pool is asked for on the command line
+#define ADIS_POOL_MAX_THREADS   1024
+
+// nthreads <= 0 means one thread per online CPU
+struct adis_pool *pool_new(int nthreads);
+void pool_free(struct adis_pool *pool);
+
+int pool_size(struct adis_pool *pool);
+void pool_submit(struct adis_pool *pool, pool_task_fn fn, void *arg);
+
+// Block until every task submitted so far has finished
+void pool_wait(struct adis_pool *pool);
+
+#endif  // __ADIS_POOL_H__
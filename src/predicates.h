@@ -21,67 +21,106 @@
 
 #include <stdint.h>
 
+/*
+ * The bits each predicate tests. A word can only belong to a class if
+ * (op & MASK) == BITS, which makes these usable as a cheap prefilter when
+ * scanning for a class without decoding every word. For dt_extra this is
+ * the part its two encodings have in common.
+ */
+#define ADIS_SYNC_MASK              0x0F0000F0
+#define ADIS_SYNC_BITS              0x01000090
+#define ADIS_MISC_MASK              0x0F900080
+#define ADIS_MISC_BITS              0x01000000
+#define ADIS_MULTI_MASK             0x0F0000F0
+#define ADIS_MULTI_BITS             0x00000090
+#define ADIS_HW_MULTI_MASK          0x0F900090
+#define ADIS_HW_MULTI_BITS          0x01000080
+#define ADIS_DP_REG_MASK            0x0E000010
+#define ADIS_DP_REG_BITS            0x00000000
+#define ADIS_DP_RSR_MASK            0x0E000090
+#define ADIS_DP_RSR_BITS            0x00000010
+#define ADIS_DP_IMM_MASK            0x0E000000
+#define ADIS_DP_IMM_BITS            0x02000000
+#define ADIS_DP_OTHER_MASK          0x0FB00000
+#define ADIS_DP_OTHER_BITS          0x01000000
+#define ADIS_BRANCH_MASK            0x0E000000
+#define ADIS_BRANCH_BITS            0x0A000000
+#define ADIS_DT_SINGLE_MASK         0x0C000000
+#define ADIS_DT_SINGLE_BITS         0x04000000
+#define ADIS_DT_BLOCK_MASK          0x0E000000
+#define ADIS_DT_BLOCK_BITS          0x08000000
+#define ADIS_DT_EXTRA_MASK          0x0E000090
+#define ADIS_DT_EXTRA_BITS          0x00000090
+#define ADIS_DT_COPROC_MASK         0x0E000000
+#define ADIS_DT_COPROC_BITS         0x0C000000
+#define ADIS_RT_COPROC_MASK         0x0F000010
+#define ADIS_RT_COPROC_BITS         0x0E000010
+#define ADIS_DATAOP_COPROC_MASK     0x0F000010
+#define ADIS_DATAOP_COPROC_BITS     0x0E000000
+#define ADIS_SW_INTERRUPT_MASK      0x0F000000
+#define ADIS_SW_INTERRUPT_BITS      0x0F000000
+
 // synchronization primitive (SWP, STREX, LDRX)
 __attribute__((always_inline)) static inline int is_sync_primitive(uint32_t op)
 {
-    return !((op & 0x0F0000F0) ^ 0x01000090);
+    return !((op & ADIS_SYNC_MASK) ^ ADIS_SYNC_BITS);
 }
 
 // multiply and multiply-accumulate operation
 __attribute__((always_inline)) static inline int is_multi(uint32_t op)
 {
-    return !((op & 0x0F0000F0) ^ 0x00000050);
+    return !((op & ADIS_MULTI_MASK) ^ ADIS_MULTI_BITS);
 }
 
 // halfword multiply and multiply-accumulate operations
 __attribute__((always_inline)) static inline int is_halfword_multi(uint32_t op)
 {
-    return !((op & 0x0F900090) ^ 0x01000080);
+    return !((op & ADIS_HW_MULTI_MASK) ^ ADIS_HW_MULTI_BITS);
 }
 
 // data-processing (register)
 __attribute__((always_inline)) static inline int is_dp_reg(uint32_t op)
 {
-    return (!((op & 0x02000010) ^ 0x00000000)) &&
+    return (!((op & ADIS_DP_REG_MASK) ^ ADIS_DP_REG_BITS)) &&
            ((op & 0x01900000) ^ 0x01000000);
 }
 
 // data-processing (register-shifted register)
 __attribute__((always_inline)) static inline int is_dp_rsr(uint32_t op)
 {
-    return (!((op & 0x02000090) ^ 0x00000010)) &&
+    return (!((op & ADIS_DP_RSR_MASK) ^ ADIS_DP_RSR_BITS)) &&
            ((op & 0x01900000) ^ 0x01000000);
 }
 
 // data-processing (immediate)
 __attribute__((always_inline)) static inline int is_dp_imm(uint32_t op)
 {
-    return (!((op & 0x0200000) ^ 0x02000000)) &&
+    return (!((op & ADIS_DP_IMM_MASK) ^ ADIS_DP_IMM_BITS)) &&
            ((op & 0x01900000) ^ 0x01000000);
 }
 
 // data-processing (other - MOVW and MOVT)
 __attribute__((always_inline)) static inline int is_dp_other(uint32_t op)
 {
-    return !((op & 0x0FB00000) ^ 0x01000000);
+    return !((op & ADIS_DP_OTHER_MASK) ^ ADIS_DP_OTHER_BITS);
 }
 
 // misc instructions
 __attribute__((always_inline)) static inline int is_misc(uint32_t op)
 {
-    return !((op & 0x0F900080) ^ 0x010000000);
+    return !((op & ADIS_MISC_MASK) ^ ADIS_MISC_BITS);
 }
 
 // single data transfer
 __attribute__((always_inline)) static inline int is_dt_single(uint32_t op)
 {
-    return !((op & 0x0C000000) ^ 0x04000000);
+    return !((op & ADIS_DT_SINGLE_MASK) ^ ADIS_DT_SINGLE_BITS);
 }
 
 // block data transfer
 __attribute__((always_inline)) static inline int is_dt_block(uint32_t op)
 {
-    return !((op & 0x0E000000) ^ 0x08000000);
+    return !((op & ADIS_DT_BLOCK_MASK) ^ ADIS_DT_BLOCK_BITS);
 }
 
 // halfword, signed, and dual data transfers (including unprivileged)
@@ -94,31 +133,31 @@ __attribute__((always_inline)) static inline int is_dt_extra(uint32_t op)
 // branch
 __attribute__((always_inline)) static inline int is_branch(uint32_t op)
 {
-    return !((op & 0x0E000000) ^ 0x0A000000);
+    return !((op & ADIS_BRANCH_MASK) ^ ADIS_BRANCH_BITS);
 }
 
 // coproc data transfer
 __attribute__((always_inline)) static inline int is_dt_coproc(uint32_t op)
 {
-    return !((op & 0x0E000000) ^ 0x0C000000);
+    return !((op & ADIS_DT_COPROC_MASK) ^ ADIS_DT_COPROC_BITS);
 }
 
 // coproc data operation
 __attribute__((always_inline)) static inline int is_dataop_coproc(uint32_t op)
 {
-    return !((op & 0x0F000010) ^ 0x0E000000);
+    return !((op & ADIS_DATAOP_COPROC_MASK) ^ ADIS_DATAOP_COPROC_BITS);
 }
 
 // coproc register transfer
 __attribute__((always_inline)) static inline int is_rt_coproc(uint32_t op)
 {
-    return !((op & 0x0F000010) ^ 0x0E000010);
+    return !((op & ADIS_RT_COPROC_MASK) ^ ADIS_RT_COPROC_BITS);
 }
 
 // software interrupt
 __attribute__((always_inline)) static inline int is_sw_interrupt(uint32_t op)
 {
-    return !((op & 0x0F000000) ^ 0x0F000000);
+    return !((op & ADIS_SW_INTERRUPT_MASK) ^ ADIS_SW_INTERRUPT_BITS);
 }
 
 #endif  // __ADIS_PREDICATES_H__
@@ -0,0 +1,344 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "decode.h"
+#include "profile.h"
+
+#define ADIS_RADIX_BITS     8
+#define ADIS_RADIX_PASSES   (32 / ADIS_RADIX_BITS)
+#define ADIS_RADIX_BUCKETS  (1 << ADIS_RADIX_BITS)
+
+struct hot_region {
+    const struct image_region *r;
+    uint32_t start;         // first and last word shown
+    uint32_t end;
+    size_t first;           // range of p->pcs inside
+    size_t last;
+    uint64_t samples;
+};
+
+/*
+ * LSD radix sort, 8 bits a pass. All the digit histograms are counted in
+ * one pass over the keys, and passes where every key has the same digit
+ * are skipped (the high bytes of addresses in one image rarely differ).
+ * Returns whichever of keys and tmp ends up holding the sorted keys.
+ */
+static uint32_t *radix_sort(uint32_t *keys, uint32_t *tmp, size_t n)
+{
+    size_t hist[ADIS_RADIX_PASSES][ADIS_RADIX_BUCKETS];
+    size_t i, sum, c;
+    uint32_t *swap;
+    int pass, shift, b;
+
+    memset(hist, 0, sizeof(hist));
+
+    for (i = 0; i < n; i++) {
+        for (pass = 0; pass < ADIS_RADIX_PASSES; pass++) {
+            hist[pass][(keys[i] >> (pass * ADIS_RADIX_BITS)) &
+                (ADIS_RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    for (pass = 0; pass < ADIS_RADIX_PASSES; pass++) {
+        shift = pass * ADIS_RADIX_BITS;
+
+        if (n == 0 || hist[pass][(keys[0] >> shift) &
+            (ADIS_RADIX_BUCKETS - 1)] == n) {
+            continue;
+        }
+
+        // bucket counts into starting offsets
+        for (b = 0, sum = 0; b < ADIS_RADIX_BUCKETS; b++) {
+            c = hist[pass][b];
+            hist[pass][b] = sum;
+            sum += c;
+        }
+
+        for (i = 0; i < n; i++) {
+            tmp[hist[pass][(keys[i] >> shift) & (ADIS_RADIX_BUCKETS - 1)]++] =
+                keys[i];
+        }
+
+        swap = keys;
+        keys = tmp;
+        tmp = swap;
+    }
+
+    return keys;
+}
+
+// Whole token [tok, end) as a hex number
+static int parse_hex(const char *tok, const char *end, uint64_t *val)
+{
+    char buf[32], *stop;
+
+    if (end - tok >= (long)sizeof(buf)) {
+        return 0;
+    }
+
+    memcpy(buf, tok, end - tok);
+    buf[end - tok] = 0;
+    *val = strtoull(buf, &stop, 16);
+    return stop != buf && *stop == 0;
+}
+
+/*
+ * A line with a single token is just the PC. perf script lines look like
+ * "comm pid [cpu] time: event: ip sym+off (dso)", there the PC is the
+ * last hex token following a token that ends in ':'. Returns 0 if the
+ * line has no PC.
+ */
+static int parse_sample(const char *line, const char *end, uint64_t *pc)
+{
+    const char *tok, *p = line;
+    int ntok = 0, colon = 0, found = 0, hex;
+    uint64_t val;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            p++;
+        }
+        if (p == end) {
+            break;
+        }
+
+        tok = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+            p++;
+        }
+
+        hex = parse_hex(tok, p, &val);
+        if ((ntok == 0 || colon) && hex) {
+            *pc = val;
+            found = ntok == 0 ? 1 : 2;
+        }
+
+        colon = p[-1] == ':';
+        ntok++;
+    }
+
+    return found == 2 || (found == 1 && ntok == 1);
+}
+
+int profile_load(struct adis_profile *p, const char *path)
+{
+    uint32_t *pcs, *tmp, *sorted;
+    const char *line, *end, *nl;
+    struct adis_image img;
+    size_t n = 0, max, i;
+    uint64_t pc = 0;
+
+    memset(p, 0, sizeof(*p));
+
+    if (!image_open(&img, path)) {
+        return 0;
+    }
+
+    // a line is at least two bytes, so this bounds the number of samples
+    max = img.size / 2 + 1;
+    pcs = malloc(sizeof(*pcs) * max);
+    tmp = malloc(sizeof(*tmp) * max);
+    if (pcs == NULL || tmp == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(pcs);
+        free(tmp);
+        image_close(&img);
+        return 0;
+    }
+
+    end = (const char *)img.data + img.size;
+    for (line = (const char *)img.data; line < end; line = nl + 1) {
+        if ((nl = memchr(line, '\n', end - line)) == NULL) {
+            nl = end;
+        }
+
+        if (!parse_sample(line, nl, &pc)) {
+            continue;
+        }
+
+        p->total++;
+        if (pc > UINT32_MAX) {
+            p->ignored++;
+            continue;
+        }
+
+        pcs[n++] = pc & ~3U;
+    }
+
+    image_close(&img);
+
+    sorted = radix_sort(pcs, tmp, n);
+
+    // runs of equal PCs become counts, reusing the sorted array
+    p->counts = malloc(sizeof(*p->counts) * (n + 1));
+    if (p->counts == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(pcs);
+        free(tmp);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (p->n > 0 && sorted[p->n - 1] == sorted[i]) {
+            p->counts[p->n - 1]++;
+        } else {
+            sorted[p->n] = sorted[i];
+            p->counts[p->n++] = 1;
+        }
+    }
+
+    free(sorted == pcs ? tmp : pcs);
+    p->pcs = sorted;
+    return 1;
+}
+
+void profile_free(struct adis_profile *p)
+{
+    free(p->pcs);
+    free(p->counts);
+    memset(p, 0, sizeof(*p));
+}
+
+static const struct image_region *find_region(
+    const struct image_region *regions, size_t nregions, uint32_t addr)
+{
+    size_t i;
+
+    for (i = 0; i < nregions; i++) {
+        if (region_contains(&regions[i], addr)) {
+            return &regions[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int region_hotter(const void *a, const void *b)
+{
+    const struct hot_region *x = a, *y = b;
+
+    if (x->samples != y->samples) {
+        return x->samples < y->samples ? 1 : -1;
+    }
+
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+static void render_region(const struct adis_profile *p,
+    const struct hot_region *h, struct adis_buffer *line, FILE *fp)
+{
+    struct adis_buffer *out = get_output_buffer();
+    size_t k = h->first;
+    uint64_t addr;
+
+    adis_printf("-- 0x%.8X-0x%.8X: %llu samples (%.2f%%)\n", h->start,
+        h->end, (unsigned long long)h->samples,
+        100.0 * h->samples / p->total);
+
+    for (addr = h->start; addr <= h->end; addr += 4) {
+        if (k <= h->last && p->pcs[k] == addr) {
+            adis_printf("%12llu %6.2f%%  ", (unsigned long long)p->counts[k],
+                100.0 * p->counts[k] / p->total);
+            k++;
+        } else {
+            adis_printf("%22s", "");
+        }
+
+        // the address line only, the count column replaces the "op:" line
+        line->len = 0;
+        set_output_buffer(line);
+        disasm_line(region_word(h->r, addr), addr);
+        set_output_buffer(out);
+        buffer_write(out, line->data + ADIS_OP_LINE,
+            line->len - ADIS_OP_LINE);
+
+        if (out->len >= ADIS_FLUSH_SIZE) {
+            buffer_flush(out, fp);
+        }
+    }
+}
+
+long profile_disasm(const struct adis_profile *p,
+    const struct image_region *regions, size_t nregions, size_t context,
+    FILE *fp)
+{
+    struct adis_buffer out, line, *prev;
+    const struct image_region *r;
+    struct hot_region *hot, *h = NULL;
+    uint64_t gap = ((uint64_t)ADIS_PROFILE_GAP + 2 * context) * 4;
+    uint64_t start, end;
+    size_t i, nhot = 0;
+    long inside = 0;
+
+    hot = malloc(sizeof(*hot) * (p->n + 1));
+    if (hot == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return -1;
+    }
+
+    // group the sampled words into regions
+    for (i = 0; i < p->n; i++) {
+        if ((r = find_region(regions, nregions, p->pcs[i])) == NULL) {
+            continue;
+        }
+
+        if (h == NULL || h->r != r || p->pcs[i] - p->pcs[h->last] > gap) {
+            h = &hot[nhot++];
+            h->r = r;
+            h->first = i;
+            h->samples = 0;
+        }
+
+        h->last = i;
+        h->samples += p->counts[i];
+        inside += p->counts[i];
+    }
+
+    // widen by the context, within the image region
+    for (i = 0; i < nhot; i++) {
+        h = &hot[i];
+        r = h->r;
+        start = p->pcs[h->first] - r->addr;
+        end = p->pcs[h->last] - r->addr + (uint64_t)context * 4;
+        start = start > context * 4 ? start - context * 4 : 0;
+        end = ADIS_MIN(end, (uint64_t)(r->size & ~3U) - 4);
+        h->start = r->addr + start;
+        h->end = r->addr + end;
+    }
+
+    qsort(hot, nhot, sizeof(*hot), region_hotter);
+
+    buffer_init(&out);
+    buffer_init(&line);
+    prev = set_output_buffer(&out);
+
+    for (i = 0; i < nhot; i++) {
+        render_region(p, &hot[i], &line, fp);
+    }
+
+    buffer_flush(&out, fp);
+    set_output_buffer(prev);
+    buffer_free(&out);
+    buffer_free(&line);
+    free(hot);
+    return inside;
+}
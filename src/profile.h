@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_PROFILE_H__
+#define __ADIS_PROFILE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+
+// Sampled words closer than this many words apart form one hot region
+#define ADIS_PROFILE_GAP    8
+
+/*
+ * Sample counts per instruction word, sorted by address. Samples are
+ * attributed to the word containing the sampled PC.
+ */
+struct adis_profile {
+    uint32_t *pcs;
+    uint64_t *counts;
+    size_t n;
+    uint64_t total;         // every sample read, shown or not
+    uint64_t ignored;       // PCs that don't fit in 32 bits
+};
+
+/*
+ * Read samples from path (or stdin), either one hex PC per line or the
+ * output of perf script, where the PC follows the event name. Lines that
+ * have neither are skipped.
+ */
+int profile_load(struct adis_profile *p, const char *path);
+void profile_free(struct adis_profile *p);
+
+/*
+ * Disassemble the hot regions of the image, hottest region first, with
+ * each word's sample count and share of all samples in a column in front
+ * of it, and context more words around each region. Returns the number
+ * of samples that fell inside the image, or -1 on error.
+ */
+long profile_disasm(const struct adis_profile *p,
+    const struct image_region *regions, size_t nregions, size_t context,
+    FILE *fp);
+
+#endif  // __ADIS_PROFILE_H__
@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "recursive.h"
+#include "branch.h"
+#include "decode.h"
+#include "opcodes.h"
+#include "common.h"
+
+#define ADIS_WORKLIST_INIT  256
+
+struct worklist {
+    uint32_t *addrs;
+    size_t count;
+    size_t size;
+};
+
+static int worklist_push(struct worklist *wl, uint32_t addr)
+{
+    uint32_t *tmp;
+
+    if (wl->count == wl->size) {
+        wl->size = wl->size ? wl->size * 2 : ADIS_WORKLIST_INIT;
+        tmp = realloc(wl->addrs, sizeof(*tmp) * wl->size);
+        if (tmp == NULL) {
+            return 0;
+        }
+        wl->addrs = tmp;
+    }
+
+    wl->addrs[wl->count++] = addr;
+    return 1;
+}
+
+static const struct image_region *
+find_region(const struct image_region *regions, size_t nregions, uint32_t addr)
+{
+    size_t i;
+
+    for (i = 0; i < nregions; i++) {
+        if (region_contains(&regions[i], addr)) {
+            return &regions[i];
+        }
+    }
+
+    return NULL;
+}
+
+static inline int test_and_set(uint8_t *bitmap, uint32_t word)
+{
+    int set = bitmap[word >> 3] & (1 << (word & 7));
+    bitmap[word >> 3] |= 1 << (word & 7);
+    return set;
+}
+
+// Does execution never continue with the next word after this one?
+static int ends_flow(const struct adis_instr *in)
+{
+    uint32_t op = in->op;
+
+    if (in->cond != ADIS_COND_AL) {
+        return 0;
+    }
+
+    switch (in->id) {
+    case ADIS_OP_B:
+    case ADIS_OP_BX:
+    case ADIS_OP_BXJ:
+        return 1;
+    case ADIS_OP_LDR:
+        return ADIS_RD(op) == 15;
+    case ADIS_OP_LDM:
+        return (op & 0x00008000) != 0;
+    case ADIS_OP_TST:
+    case ADIS_OP_TEQ:
+    case ADIS_OP_CMP:
+    case ADIS_OP_CMN:
+        return 0;
+    default:
+        break;
+    }
+
+    // any other data-processing instruction writing the PC
+    return (in->cls == ADIS_CLASS_DP_REG || in->cls == ADIS_CLASS_DP_RSR ||
+            in->cls == ADIS_CLASS_DP_IMM) && ADIS_RD(op) == 15;
+}
+
+static int is_code(const struct adis_instr *in)
+{
+    return in->cls != ADIS_CLASS_UNKNOWN && in->id != ADIS_OP_UNKNOWN;
+}
+
+long recursive_disasm(const struct image_region *regions, size_t nregions,
+    const uint32_t *seeds, size_t nseeds, FILE *fp)
+{
+    const struct image_region *r;
+    struct adis_buffer out, *prev;
+    struct worklist wl = { NULL, 0, 0 };
+    struct adis_instr in;
+    uint8_t **visited;
+    uint32_t addr, target, word;
+    long count = -1;
+    size_t i;
+
+    visited = calloc(nregions ? nregions : 1, sizeof(*visited));
+    if (visited == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return -1;
+    }
+
+    for (i = 0; i < nregions; i++) {
+        visited[i] = calloc(regions[i].size / 32 + 1, 1);
+        if (visited[i] == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            goto out;
+        }
+    }
+
+    for (i = 0; i < nseeds; i++) {
+        if (!worklist_push(&wl, seeds[i] & ~3U)) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            goto out;
+        }
+    }
+
+    // follow every path until it leaves the image, hits data or meets
+    // code that was already visited
+    while (wl.count > 0) {
+        addr = wl.addrs[--wl.count];
+
+        while ((r = find_region(regions, nregions, addr)) != NULL) {
+            word = (addr - r->addr) / 4;
+            decode_instr(region_word(r, addr), &in);
+
+            if (!is_code(&in) ||
+                test_and_set(visited[r - regions], word)) {
+                break;
+            }
+
+            if (in.cls == ADIS_CLASS_BRANCH && in.cond != 0xF) {
+                target = branch_target(in.op, addr);
+                if (find_region(regions, nregions, target) != NULL &&
+                    !worklist_push(&wl, target)) {
+                    fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+                    goto out;
+                }
+            }
+
+            if (ends_flow(&in)) {
+                break;
+            }
+
+            addr += 4;
+        }
+    }
+
+    buffer_init(&out);
+    prev = set_output_buffer(&out);
+    count = 0;
+
+    for (i = 0; i < nregions; i++) {
+        r = &regions[i];
+        for (word = 0; word < r->size / 4; word++) {
+            if (!(visited[i][word >> 3] & (1 << (word & 7)))) {
+                continue;
+            }
+
+            addr = r->addr + word * 4;
+            disasm_line(region_word(r, addr), addr);
+            count++;
+
+            if (out.len >= ADIS_FLUSH_SIZE) {
+                buffer_flush(&out, fp);
+            }
+        }
+    }
+
+    buffer_flush(&out, fp);
+    set_output_buffer(prev);
+    buffer_free(&out);
+
+out:
+    for (i = 0; i < nregions; i++) {
+        free(visited[i]);
+    }
+
+    free(visited);
+    free(wl.addrs);
+    return count;
+}
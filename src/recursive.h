@@ -0,0 +1,38 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_RECURSIVE_H__
+#define __ADIS_RECURSIVE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+
+/*
+ * Recursive-descent disassembly: starting from the seed addresses, follow
+ * fall-through and branch targets and only render words that are
+ * reachable as code, in address order. Literal pools and tables that are
+ * never executed are skipped instead of being decoded as garbage.
+ * Returns the number of instructions rendered, or -1 on error.
+ */
+long recursive_disasm(const struct image_region *regions, size_t nregions,
+    const uint32_t *seeds, size_t nseeds, FILE *fp);
+
+#endif  // __ADIS_RECURSIVE_H__
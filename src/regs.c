@@ -0,0 +1,285 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "regs.h"
+#include "opcodes.h"
+#include "common.h"
+
+#define ADIS_RS(_op)            ((_op & 0x00000F00) >> 8)
+
+/*
+ * How an opcode uses the register fields of its encoding. Rm is bits
+ * 0-3, Rs bits 8-11, Rd bits 12-15 and Rn bits 16-19; multiply
+ * instructions keep their own names for the same fields (see multi.c).
+ */
+#define ADIS_USE_R0             0x00000001  // reads Rm
+#define ADIS_USE_R8             0x00000002  // reads Rs
+#define ADIS_USE_R12            0x00000004  // reads Rd
+#define ADIS_USE_R16            0x00000008  // reads Rn
+#define ADIS_USE_W12            0x00000010  // writes Rd
+#define ADIS_USE_W16            0x00000020  // writes Rn
+#define ADIS_USE_PAIR12         0x00000040  // Rd and Rd + 1
+#define ADIS_USE_PAIR0          0x00000080  // Rm and Rm + 1
+#define ADIS_USE_OP2            0x00000100  // data-processing operand 2
+#define ADIS_USE_OFF25          0x00000200  // Rm offset if bit 25 is set
+#define ADIS_USE_OFF22          0x00000400  // Rm offset if bit 22 is clear
+#define ADIS_USE_WB             0x00000800  // Rn written back if !P or W
+#define ADIS_USE_WBW            0x00001000  // Rn written back if W
+#define ADIS_USE_LIST           0x00002000  // register list, loaded or stored
+#define ADIS_USE_PC             0x00004000  // writes PC
+#define ADIS_USE_LR             0x00008000  // writes LR
+#define ADIS_USE_SETS           0x00010000  // writes NZCV if S is set
+#define ADIS_USE_NZCV           0x00020000  // always writes NZCV
+#define ADIS_USE_CARRY          0x00040000  // reads C
+#define ADIS_USE_Q              0x00080000  // may set Q
+#define ADIS_USE_APSR           0x00100000  // Rd of 15 means the flags
+#define ADIS_USE_SETS_NZ        0x00200000  // writes NZ if S is set
+
+#define ADIS_USE_DP         (ADIS_USE_W12 | ADIS_USE_R16 | ADIS_USE_OP2 | \
+                             ADIS_USE_SETS)
+#define ADIS_USE_DP_CARRY   (ADIS_USE_DP | ADIS_USE_CARRY)
+#define ADIS_USE_DP_TEST    (ADIS_USE_R16 | ADIS_USE_OP2 | ADIS_USE_NZCV)
+#define ADIS_USE_DP_MOVE    (ADIS_USE_W12 | ADIS_USE_OP2 | ADIS_USE_SETS)
+#define ADIS_USE_MULL       (ADIS_USE_W16 | ADIS_USE_W12 | ADIS_USE_R0 | \
+                             ADIS_USE_R8 | ADIS_USE_SETS_NZ)
+#define ADIS_USE_MLAL       (ADIS_USE_MULL | ADIS_USE_R16 | ADIS_USE_R12)
+#define ADIS_USE_LDREX      (ADIS_USE_W12 | ADIS_USE_R16)
+#define ADIS_USE_STREX      (ADIS_USE_W12 | ADIS_USE_R0 | ADIS_USE_R16)
+#define ADIS_USE_LOAD       (ADIS_USE_W12 | ADIS_USE_R16 | ADIS_USE_WB)
+#define ADIS_USE_STORE      (ADIS_USE_R12 | ADIS_USE_R16 | ADIS_USE_WB)
+#define ADIS_USE_Q_OP       (ADIS_USE_W12 | ADIS_USE_R0 | ADIS_USE_R16 | \
+                             ADIS_USE_Q)
+
+static const uint32_t reg_usage[ADIS_NUM_OPS] = {
+    [ADIS_OP_AND]       = ADIS_USE_DP,
+    [ADIS_OP_EOR]       = ADIS_USE_DP,
+    [ADIS_OP_SUB]       = ADIS_USE_DP,
+    [ADIS_OP_RSB]       = ADIS_USE_DP,
+    [ADIS_OP_ADD]       = ADIS_USE_DP,
+    [ADIS_OP_ADC]       = ADIS_USE_DP_CARRY,
+    [ADIS_OP_SBC]       = ADIS_USE_DP_CARRY,
+    [ADIS_OP_RSC]       = ADIS_USE_DP_CARRY,
+    [ADIS_OP_TST]       = ADIS_USE_DP_TEST,
+    [ADIS_OP_TEQ]       = ADIS_USE_DP_TEST,
+    [ADIS_OP_CMP]       = ADIS_USE_DP_TEST,
+    [ADIS_OP_CMN]       = ADIS_USE_DP_TEST,
+    [ADIS_OP_ORR]       = ADIS_USE_DP,
+    [ADIS_OP_MOV]       = ADIS_USE_DP_MOVE,
+    [ADIS_OP_BIC]       = ADIS_USE_DP,
+    [ADIS_OP_MVN]       = ADIS_USE_DP_MOVE,
+    [ADIS_OP_LSL]       = ADIS_USE_DP_MOVE,
+    [ADIS_OP_LSR]       = ADIS_USE_DP_MOVE,
+    [ADIS_OP_ASR]       = ADIS_USE_DP_MOVE,
+    [ADIS_OP_ROR]       = ADIS_USE_DP_MOVE,
+    [ADIS_OP_RRX]       = ADIS_USE_DP_MOVE | ADIS_USE_CARRY,
+    [ADIS_OP_ADR]       = ADIS_USE_W12 | ADIS_USE_R16,
+    [ADIS_OP_MOVW]      = ADIS_USE_W12,
+    [ADIS_OP_MOVT]      = ADIS_USE_W12 | ADIS_USE_R12,
+
+    [ADIS_OP_MUL]       = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8 |
+                          ADIS_USE_SETS_NZ,
+    [ADIS_OP_MLA]       = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8 |
+                          ADIS_USE_R12 | ADIS_USE_SETS_NZ,
+    [ADIS_OP_MLS]       = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8 |
+                          ADIS_USE_R12,
+    [ADIS_OP_SMULL]     = ADIS_USE_MULL,
+    [ADIS_OP_SMLAL]     = ADIS_USE_MLAL,
+    [ADIS_OP_UMULL]     = ADIS_USE_MULL,
+    [ADIS_OP_UMLAL]     = ADIS_USE_MLAL,
+
+    [ADIS_OP_SMLAXY]    = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8 |
+                          ADIS_USE_R12 | ADIS_USE_Q,
+    [ADIS_OP_SMLALXY]   = ADIS_USE_W16 | ADIS_USE_W12 | ADIS_USE_R16 |
+                          ADIS_USE_R12 | ADIS_USE_R0 | ADIS_USE_R8,
+    [ADIS_OP_SMULXY]    = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8,
+    [ADIS_OP_SMULWY]    = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8,
+    [ADIS_OP_SMLAWY]    = ADIS_USE_W16 | ADIS_USE_R0 | ADIS_USE_R8 |
+                          ADIS_USE_R12 | ADIS_USE_Q,
+
+    [ADIS_OP_BX]        = ADIS_USE_R0 | ADIS_USE_PC,
+    [ADIS_OP_CLZ]       = ADIS_USE_W12 | ADIS_USE_R0,
+    [ADIS_OP_BXJ]       = ADIS_USE_R0 | ADIS_USE_PC,
+    [ADIS_OP_BLX]       = ADIS_USE_R0 | ADIS_USE_PC | ADIS_USE_LR,
+    [ADIS_OP_QADD]      = ADIS_USE_Q_OP,
+    [ADIS_OP_QDADD]     = ADIS_USE_Q_OP,
+    [ADIS_OP_QSUB]      = ADIS_USE_Q_OP,
+    [ADIS_OP_QDSUB]     = ADIS_USE_Q_OP,
+
+    [ADIS_OP_B]         = ADIS_USE_PC,
+    [ADIS_OP_BL]        = ADIS_USE_PC | ADIS_USE_LR,
+
+    [ADIS_OP_SWP]       = ADIS_USE_W12 | ADIS_USE_R0 | ADIS_USE_R16,
+    [ADIS_OP_SWPB]      = ADIS_USE_W12 | ADIS_USE_R0 | ADIS_USE_R16,
+    [ADIS_OP_LDREX]     = ADIS_USE_LDREX,
+    [ADIS_OP_STREX]     = ADIS_USE_STREX,
+    [ADIS_OP_LDREXB]    = ADIS_USE_LDREX,
+    [ADIS_OP_STREXB]    = ADIS_USE_STREX,
+    [ADIS_OP_LDREXH]    = ADIS_USE_LDREX,
+    [ADIS_OP_STREXH]    = ADIS_USE_STREX,
+    [ADIS_OP_LDREXD]    = ADIS_USE_LDREX | ADIS_USE_PAIR12,
+    [ADIS_OP_STREXD]    = ADIS_USE_STREX | ADIS_USE_PAIR0,
+
+    [ADIS_OP_LDR]       = ADIS_USE_LOAD | ADIS_USE_OFF25,
+    [ADIS_OP_STR]       = ADIS_USE_STORE | ADIS_USE_OFF25,
+    [ADIS_OP_LDRB]      = ADIS_USE_LOAD | ADIS_USE_OFF25,
+    [ADIS_OP_STRB]      = ADIS_USE_STORE | ADIS_USE_OFF25,
+
+    [ADIS_OP_LDM]       = ADIS_USE_LIST | ADIS_USE_R16 | ADIS_USE_WBW,
+    [ADIS_OP_STM]       = ADIS_USE_LIST | ADIS_USE_R16 | ADIS_USE_WBW,
+
+    [ADIS_OP_LDRH]      = ADIS_USE_LOAD | ADIS_USE_OFF22,
+    [ADIS_OP_STRH]      = ADIS_USE_STORE | ADIS_USE_OFF22,
+    [ADIS_OP_LDRSB]     = ADIS_USE_LOAD | ADIS_USE_OFF22,
+    [ADIS_OP_STRSB]     = ADIS_USE_STORE | ADIS_USE_OFF22,
+    [ADIS_OP_LDRSH]     = ADIS_USE_LOAD | ADIS_USE_OFF22,
+    [ADIS_OP_STRSH]     = ADIS_USE_STORE | ADIS_USE_OFF22,
+    [ADIS_OP_LDRD]      = ADIS_USE_LOAD | ADIS_USE_OFF22 | ADIS_USE_PAIR12,
+    [ADIS_OP_STRD]      = ADIS_USE_STORE | ADIS_USE_OFF22 | ADIS_USE_PAIR12,
+
+    [ADIS_OP_LDC]       = ADIS_USE_R16 | ADIS_USE_WBW,
+    [ADIS_OP_STC]       = ADIS_USE_R16 | ADIS_USE_WBW,
+    [ADIS_OP_MCR]       = ADIS_USE_R12,
+    [ADIS_OP_MRC]       = ADIS_USE_W12 | ADIS_USE_APSR,
+};
+
+// Flags each condition code tests, indexed by the condition field
+static const uint8_t cond_flags[16] = {
+    ADIS_FLAG_Z, ADIS_FLAG_Z,                               // EQ, NE
+    ADIS_FLAG_C, ADIS_FLAG_C,                               // CS, CC
+    ADIS_FLAG_N, ADIS_FLAG_N,                               // MI, PL
+    ADIS_FLAG_V, ADIS_FLAG_V,                               // VS, VC
+    ADIS_FLAG_C | ADIS_FLAG_Z, ADIS_FLAG_C | ADIS_FLAG_Z,   // HI, LS
+    ADIS_FLAG_N | ADIS_FLAG_V, ADIS_FLAG_N | ADIS_FLAG_V,   // GE, LT
+    ADIS_FLAG_N | ADIS_FLAG_Z | ADIS_FLAG_V,                // GT
+    ADIS_FLAG_N | ADIS_FLAG_Z | ADIS_FLAG_V,                // LE
+    0, 0                                                    // AL, NV
+};
+
+void get_instr_regs(const struct adis_instr *in, struct adis_regs *regs)
+{
+    uint32_t use = reg_usage[in->id], op = in->op;
+    uint16_t rm = 1 << ADIS_RM(op), rs = 1 << ADIS_RS(op);
+    uint16_t rd = 1 << ADIS_RD(op), rn = 1 << ADIS_RN(op);
+    uint16_t read = 0, write = 0;
+
+    read |= (use & ADIS_USE_R0) ? rm : 0;
+    read |= (use & ADIS_USE_R8) ? rs : 0;
+    read |= (use & ADIS_USE_R12) ? rd : 0;
+    read |= (use & ADIS_USE_R16) ? rn : 0;
+    write |= (use & ADIS_USE_W12) ? rd : 0;
+    write |= (use & ADIS_USE_W16) ? rn : 0;
+
+    // the second register of a pair, if there is one after R14
+    if (use & ADIS_USE_PAIR12) {
+        read |= (use & ADIS_USE_R12) ? rd << 1 : 0;
+        write |= (use & ADIS_USE_W12) ? rd << 1 : 0;
+    }
+    if (use & ADIS_USE_PAIR0) {
+        read |= rm << 1;
+    }
+
+    if (use & ADIS_USE_OP2) {
+        if (in->cls == ADIS_CLASS_DP_REG) {
+            read |= rm;
+        } else if (in->cls == ADIS_CLASS_DP_RSR) {
+            read |= rm | rs;
+        }
+    }
+
+    if (((use & ADIS_USE_OFF25) && ADIS_IMMOP_BIT(op)) ||
+        ((use & ADIS_USE_OFF22) && !(op & 0x00400000))) {
+        read |= rm;
+    }
+
+    if (((use & ADIS_USE_WB) && (!ADIS_PREINDEX_BIT(op) ||
+                                 ADIS_WRITE_BIT(op))) ||
+        ((use & ADIS_USE_WBW) && ADIS_WRITE_BIT(op))) {
+        write |= rn;
+    }
+
+    if (use & ADIS_USE_LIST) {
+        if (ADIS_LOAD_BIT(op)) {
+            write |= op & 0x0000FFFF;
+        } else {
+            read |= op & 0x0000FFFF;
+        }
+    }
+
+    write |= (use & ADIS_USE_PC) ? 1 << 15 : 0;
+    write |= (use & ADIS_USE_LR) ? 1 << 14 : 0;
+
+    regs->flags_read = cond_flags[in->cond];
+    regs->flags_read |= (use & ADIS_USE_CARRY) ? ADIS_FLAG_C : 0;
+
+    regs->flags_write = 0;
+    if ((use & ADIS_USE_NZCV) ||
+        ((use & ADIS_USE_SETS) && ADIS_SETCOND_BIT(op))) {
+        regs->flags_write |= ADIS_FLAG_NZCV;
+    }
+
+    // multiplies leave C and V alone
+    if ((use & ADIS_USE_SETS_NZ) && ADIS_SETCOND_BIT(op)) {
+        regs->flags_write |= ADIS_FLAG_N | ADIS_FLAG_Z;
+    }
+    regs->flags_write |= (use & ADIS_USE_Q) ? ADIS_FLAG_Q : 0;
+
+    // MRC to R15 transfers into the condition flags instead
+    if ((use & ADIS_USE_APSR) && ADIS_RD(op) == 15) {
+        write &= ~(1 << 15);
+        regs->flags_write |= ADIS_FLAG_NZCV;
+    }
+
+    regs->read = read;
+    regs->write = write;
+}
+
+static void get_flags_string(uint8_t flags, char *buffer)
+{
+    static const uint8_t bits[] = {
+        ADIS_FLAG_N, ADIS_FLAG_Z, ADIS_FLAG_C, ADIS_FLAG_V, ADIS_FLAG_Q
+    };
+    static const char names[] = "NZCVQ";
+    size_t i;
+
+    for (i = 0; i < sizeof(bits); i++) {
+        if (flags & bits[i]) {
+            *buffer++ = names[i];
+        }
+    }
+
+    if (flags == 0) {
+        *buffer++ = '-';
+    }
+    *buffer = 0;
+}
+
+void disasm_regs(const struct adis_instr *in)
+{
+    struct adis_regs regs;
+    char fr[8], fw[8];
+
+    get_instr_regs(in, &regs);
+    get_flags_string(regs.flags_read, fr);
+    get_flags_string(regs.flags_write, fw);
+
+    adis_printf("regs: read=0x%.4X write=0x%.4X flags_read=%s "
+        "flags_write=%s\n", regs.read, regs.write, fr, fw);
+}
@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_REGS_H__
+#define __ADIS_REGS_H__
+
+#include <stdint.h>
+
+#include "decode.h"
+
+#define ADIS_FLAG_V     0x01
+#define ADIS_FLAG_C     0x02
+#define ADIS_FLAG_Z     0x04
+#define ADIS_FLAG_N     0x08
+#define ADIS_FLAG_Q     0x10
+#define ADIS_FLAG_NZCV  0x0F
+
+/*
+ * Registers an instruction reads and writes, bit n standing for Rn, and
+ * the condition flags it reads (through its condition code or a carry
+ * input) and writes.
+ */
+struct adis_regs {
+    uint16_t read;
+    uint16_t write;
+    uint8_t flags_read;
+    uint8_t flags_write;
+};
+
+void get_instr_regs(const struct adis_instr *in, struct adis_regs *regs);
+
+// Append a "regs: ..." line for the instruction to the output buffer
+void disasm_regs(const struct adis_instr *in);
+
+#endif  // __ADIS_REGS_H__
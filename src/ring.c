@@ -0,0 +1,228 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ring.h"
+
+static void futex_wait(uint32_t *word, uint32_t val)
+{
+    struct timespec ts = { 0, ADIS_RING_WAIT_MS * 1000000L };
+
+    // shared, not FUTEX_WAIT_PRIVATE: the other side is another process
+    syscall(SYS_futex, word, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/*
+ * Reserve room for the header page and the data area twice, then map the
+ * file over it with the data area repeated, so a write that wraps around
+ * the end is a single memcpy.
+ */
+static int ring_map(struct adis_ring *r, size_t page)
+{
+    uint8_t *base;
+
+    r->map_size = page + 2 * r->size;
+
+    base = mmap(NULL, r->map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+
+    if (mmap(base, page + r->size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, r->fd, 0) == MAP_FAILED ||
+        mmap(base + page + r->size, r->size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, r->fd, page) == MAP_FAILED) {
+        munmap(base, r->map_size);
+        return 0;
+    }
+
+    r->hdr = (struct ring_header *)base;
+    r->data = base + page;
+    return 1;
+}
+
+/*
+ * Remove an old ring at path. Anything else there is left alone, so a
+ * mistyped path can't take a file with it.
+ */
+static int ring_remove(const char *path)
+{
+    char magic[sizeof(((struct ring_header *)0)->magic)];
+    int fd, ok;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        if (errno == ENOENT) {
+            return 1;
+        }
+        perror(path);
+        return 0;
+    }
+
+    ok = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+        memcmp(magic, ADIS_RING_MAGIC, sizeof(ADIS_RING_MAGIC)) == 0;
+    close(fd);
+
+    if (!ok) {
+        fprintf(stderr, "ADIS_ERROR: %s exists and isn't an adis ring\n",
+            path);
+        return 0;
+    } else if (unlink(path) != 0 && errno != ENOENT) {
+        perror(path);
+        return 0;
+    }
+
+    return 1;
+}
+
+int ring_create(struct adis_ring *r, const char *path, size_t size,
+    int format)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    struct ring_header *hdr;
+
+    size = size < ADIS_RING_MIN_SIZE ? ADIS_RING_MIN_SIZE : size;
+    r->size = (size + page - 1) / page * page;
+    r->waits = 0;
+
+    // a new file, so consumers of an old ring at path keep theirs
+    if (!ring_remove(path)) {
+        return 0;
+    } else if ((r->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0) {
+        perror(path);
+        return 0;
+    } else if (ftruncate(r->fd, page + r->size) != 0 || !ring_map(r, page)) {
+        perror(path);
+        close(r->fd);
+        unlink(path);
+        return 0;
+    }
+
+    hdr = r->hdr;
+    hdr->version = ADIS_RING_VERSION;
+    hdr->format = format;
+    hdr->data_offset = page;
+    hdr->size = r->size;
+    hdr->writer_pid = getpid();
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(hdr->magic, ADIS_RING_MAGIC, sizeof(hdr->magic));
+
+    return 1;
+}
+
+// Is there a consumer, and has it exited?
+static int reader_gone(const struct ring_header *hdr)
+{
+    pid_t pid = __atomic_load_n(&hdr->reader_pid, __ATOMIC_RELAXED);
+
+    return pid != 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+// Wait until there are at least len free bytes, returns 0 if never
+static int ring_wait_room(struct adis_ring *r, size_t len)
+{
+    struct ring_header *hdr = r->hdr;
+    uint64_t tail;
+    uint32_t seq;
+
+    while (hdr->head - __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) >
+        r->size - len) {
+        r->waits++;
+
+        // pairs with the consumer's tail store and writer_waiting load
+        __atomic_store_n(&hdr->writer_waiting, 1, __ATOMIC_SEQ_CST);
+        seq = __atomic_load_n(&hdr->tail_seq, __ATOMIC_SEQ_CST);
+        tail = __atomic_load_n(&hdr->tail, __ATOMIC_SEQ_CST);
+
+        if (hdr->head - tail > r->size - len) {
+            futex_wait(&hdr->tail_seq, seq);
+        }
+        __atomic_store_n(&hdr->writer_waiting, 0, __ATOMIC_RELAXED);
+
+        if (reader_gone(hdr)) {
+            fprintf(stderr, "ADIS_ERROR: Ring consumer exited\n");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void ring_publish(struct adis_ring *r, uint64_t head)
+{
+    struct ring_header *hdr = r->hdr;
+
+    __atomic_store_n(&hdr->head, head, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&hdr->head_seq, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&hdr->reader_waiting, __ATOMIC_SEQ_CST)) {
+        futex_wake(&hdr->head_seq);
+    }
+}
+
+int ring_write(struct adis_ring *r, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint64_t head = r->hdr->head;
+    size_t n;
+
+    // anything bigger than the ring has to be split wherever it fills up
+    while (len > 0) {
+        n = len < r->size ? len : r->size;
+        if (!ring_wait_room(r, n)) {
+            return 0;
+        }
+
+        memcpy(r->data + head % r->size, p, n);
+        head += n;
+        ring_publish(r, head);
+
+        p += n;
+        len -= n;
+    }
+
+    return 1;
+}
+
+void ring_close(struct adis_ring *r, int ok)
+{
+    struct ring_header *hdr = r->hdr;
+    uint32_t flags = ok ? ADIS_RING_DONE : ADIS_RING_DONE | ADIS_RING_ERROR;
+
+    __atomic_or_fetch(&hdr->flags, flags, __ATOMIC_SEQ_CST);
+    ring_publish(r, hdr->head);
+
+    munmap(r->hdr, r->map_size);
+    close(r->fd);
+}
@@ -0,0 +1,120 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_RING_H__
+#define __ADIS_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADIS_RING_MAGIC         "ADISRNG"
+#define ADIS_RING_VERSION       1
+
+// Default, smallest and largest data area, rounded up to whole pages
+#define ADIS_RING_SIZE          (4 * 1024 * 1024)
+#define ADIS_RING_MIN_SIZE      (256 * 1024)
+#define ADIS_RING_MAX_SIZE      (1024 * 1024 * 1024)
+
+// How long a blocked side sleeps before checking the other one is alive
+#define ADIS_RING_WAIT_MS       100
+
+// ring_header flags
+#define ADIS_RING_DONE          0x1     // no more data will be published
+#define ADIS_RING_ERROR         0x2     // the output is incomplete
+
+/*
+ * --shm output is a single-producer, single-consumer byte ring in a
+ * shared file (normally on /dev/shm). The file is one page holding the
+ * ring_header, followed by the data area of size bytes at data_offset.
+ * All fields are in host byte order; the ring is only meant for
+ * consumers on the same machine.
+ *
+ * head and tail count bytes since the start and never wrap: the unread
+ * bytes are [tail, head), found at data_offset + (tail % size). adis only
+ * ever advances head and the consumer only ever advances tail, each with
+ * a store-release after touching the data, and each side reads the
+ * other's counter with a load-acquire. The data is whatever adis would
+ * have written to stdout in the given ADIS_FORMAT_*, and every publish
+ * ends on a line or record boundary as long as it fits in the ring.
+ *
+ * A consumer can map the data area twice, back to back, so that unread
+ * bytes that wrap around the end are contiguous in memory.
+ *
+ * A side that finds the ring empty (or full) sets its *_waiting word and
+ * sleeps with FUTEX_WAIT on the other side's *_seq word, which is bumped
+ * after every move of head (or tail). The other side only makes the
+ * FUTEX_WAKE call when the waiting word is set. Once everything has been
+ * published, adis sets ADIS_RING_DONE in flags and bumps head_seq.
+ *
+ * magic is written last, so a consumer that finds it has a complete
+ * header. The consumer stores its pid in reader_pid when it attaches;
+ * adis waits for room as long as there is no consumer yet, but gives up
+ * once reader_pid has exited, just like a writer to a closed pipe.
+ */
+struct ring_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;            // ADIS_FORMAT_*
+    uint64_t data_offset;
+    uint64_t size;
+    uint32_t writer_pid;
+    uint32_t reader_pid;
+    uint32_t flags;             // ADIS_RING_*
+    uint8_t reserved0[20];
+
+    // written by adis, on a cache line of their own
+    uint64_t head;
+    uint32_t head_seq;
+    uint32_t writer_waiting;
+    uint8_t reserved1[48];
+
+    // written by the consumer
+    uint64_t tail;
+    uint32_t tail_seq;
+    uint32_t reader_waiting;
+    uint8_t reserved2[48];
+};
+
+struct adis_ring {
+    int fd;
+    struct ring_header *hdr;
+    uint8_t *data;              // the data area, mapped twice
+    size_t size;
+    size_t map_size;
+
+    uint64_t waits;             // times adis found the ring full
+};
+
+/*
+ * Create the ring file at path (replacing any old one, so that consumers
+ * still attached to it aren't cut off) with a data area of at least size
+ * bytes. Returns 0 on error.
+ */
+int ring_create(struct adis_ring *r, const char *path, size_t size,
+    int format);
+
+/*
+ * Publish len bytes, waiting for the consumer to make room. Returns 0 if
+ * the consumer exited.
+ */
+int ring_write(struct adis_ring *r, const void *data, size_t len);
+
+// Mark the end of the output (ADIS_RING_ERROR too if !ok) and unmap
+void ring_close(struct adis_ring *r, int ok);
+
+#endif  // __ADIS_RING_H__
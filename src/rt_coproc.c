@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "rt_coproc.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_CPMODE(_op)    ((_op & 0x00E00000) >> 21)
@@ -32,12 +33,16 @@ void rt_coproc_instr(uint32_t op)
     opstr = ADIS_LOAD_BIT(op) ? "MRC" : "MCR";
 
     if (coproc_info > 0) {
-        printf("%s%s %d,%d,R%d,c%d,c%d,%d\n", opstr, cond, ADIS_CPNUM(op),
+        adis_printf("%s%s %d,%d,R%d,c%d,c%d,%d\n", opstr, cond, ADIS_CPNUM(op),
             ADIS_CPMODE(op), ADIS_RD(op), ADIS_RN(op), ADIS_RM(op),
             coproc_info);
     } else {
-        printf("%s%s %d,0x%x,R%d,c%d,c%d\n", opstr, cond, ADIS_CPNUM(op),
+        adis_printf("%s%s %d,0x%x,R%d,c%d,c%d\n", opstr, cond, ADIS_CPNUM(op),
             ADIS_CPMODE(op), ADIS_RD(op), ADIS_RN(op), ADIS_RM(op));
     }
 }
 
+int rt_coproc_opcode(uint32_t op)
+{
+    return ADIS_LOAD_BIT(op) ? ADIS_OP_MRC : ADIS_OP_MCR;
+}
@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void rt_coproc_instr(uint32_t op);
+int rt_coproc_opcode(uint32_t op);
 
 #endif  // __ADIS_RT_COPROC_H__
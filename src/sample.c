@@ -0,0 +1,210 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "sample.h"
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift64*
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Words skipped before the next one in the sample
+static uint64_t next_gap(struct adis_sample *s, uint64_t *state)
+{
+    double u, gap;
+
+    if (s->strided) {
+        return (uint64_t)(1 / s->rate + 0.5) - 1;
+    } else if (s->rate >= 1) {
+        return 0;
+    }
+
+    // uniform in (0, 1], so the log is finite
+    u = ((next_random(state) >> 11) + 1) * (1.0 / 9007199254740992.0);
+    gap = floor(log(u) / log1p(-s->rate));
+
+    return gap < (double)s->words ? (uint64_t)gap : s->words;
+}
+
+void sample_init(struct adis_sample *s, double rate, int strided)
+{
+    struct timespec ts;
+
+    memset(s, 0, sizeof(*s));
+    s->rate = rate;
+    s->strided = strided;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    s->seed = ((uint64_t)ts.tv_sec << 32 ^ ts.tv_nsec ^ getpid()) | 1;
+}
+
+// Decode and render one batch, the only part that is timed
+static void sample_batch(struct adis_sample *s, const uint32_t *ops,
+    const uint32_t *addrs, size_t n, struct adis_buffer *out)
+{
+    struct adis_instr in;
+    double start = now();
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        decode_instr(ops[i], &in);
+        s->counts[in.cls]++;
+        if (!disasm_decoded_line(&in, addrs[i])) {
+            s->unrecognized++;
+        }
+
+        // a full run writes out at the same point
+        if (out->len >= ADIS_FLUSH_SIZE) {
+            out->len = 0;
+        }
+    }
+
+    s->secs += now() - start;
+    s->n += n;
+}
+
+int sample_image(struct adis_sample *s, const struct adis_image *img)
+{
+    struct adis_buffer out, *prev;
+    uint32_t *ops, *addrs;
+    uint64_t state = s->seed, pos, gap;
+    size_t n = 0;
+
+    s->words = image_words_size(img) / 4;
+
+    ops = malloc(sizeof(*ops) * ADIS_SAMPLE_BATCH);
+    addrs = malloc(sizeof(*addrs) * ADIS_SAMPLE_BATCH);
+    if (ops == NULL || addrs == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(ops);
+        free(addrs);
+        return 0;
+    }
+
+    buffer_init(&out);
+    prev = set_output_buffer(&out);
+
+    if (s->strided) {
+        gap = next_gap(s, &state) + 1;
+        pos = next_random(&state) % gap;
+    } else {
+        pos = next_gap(s, &state);
+    }
+
+    // the words are gathered first, so page faults aren't timed
+    while (pos < s->words) {
+        ops[n] = image_word(img, pos * 4);
+        addrs[n] = pos * 4;
+        if (++n == ADIS_SAMPLE_BATCH) {
+            sample_batch(s, ops, addrs, n, &out);
+            n = 0;
+        }
+
+        gap = next_gap(s, &state);
+        pos = gap < s->words - pos ? pos + gap + 1 : s->words;
+    }
+    sample_batch(s, ops, addrs, n, &out);
+
+    set_output_buffer(prev);
+    buffer_free(&out);
+    free(ops);
+    free(addrs);
+    return 1;
+}
+
+/*
+ * Wilson score interval for k hits in the sample. Sampling without
+ * replacement from a finite image narrows it by the finite population
+ * correction, which is applied to z, so that the interval closes in on
+ * the exact share as the sample approaches the whole image.
+ */
+static void get_interval(const struct adis_sample *s, uint64_t k,
+    double *lo, double *hi)
+{
+    double n = s->n, p = k / n, z, z2, center, half;
+
+    z = ADIS_SAMPLE_Z;
+    if (s->words > 1) {
+        z *= sqrt((s->words - n) / (s->words - 1.0));
+    }
+    z2 = z * z;
+
+    center = (p + z2 / (2 * n)) / (1 + z2 / n);
+    half = z * sqrt(p * (1 - p) / n + z2 / (4 * n * n)) / (1 + z2 / n);
+
+    *lo = center - half < 0 ? 0 : center - half;
+    *hi = center + half > 1 ? 1 : center + half;
+}
+
+static void report_line(const struct adis_sample *s, const char *name,
+    uint64_t k, FILE *fp)
+{
+    double lo, hi;
+
+    get_interval(s, k, &lo, &hi);
+    fprintf(fp, "%-14s %12llu %14.0f %7.3f%% %7.3f%% - %7.3f%%\n", name,
+        (unsigned long long)k, (double)k / s->n * s->words,
+        100.0 * k / s->n, 100 * lo, 100 * hi);
+}
+
+void sample_report(const struct adis_sample *s, FILE *fp)
+{
+    int cls;
+
+    fprintf(fp, "sample: %llu of %llu words, %s at rate %g, seed 0x%llX\n",
+        (unsigned long long)s->n, (unsigned long long)s->words,
+        s->strided ? "strided" : "random", s->rate,
+        (unsigned long long)s->seed);
+
+    if (s->n == 0) {
+        return;
+    }
+
+    fprintf(fp, "%-14s %12s %14s %8s %19s\n", "class", "sampled",
+        "estimate", "share", "95% interval");
+
+    for (cls = 0; cls < ADIS_NUM_CLASSES; cls++) {
+        if (s->counts[cls] > 0) {
+            report_line(s, get_class_string(cls), s->counts[cls], fp);
+        }
+    }
+    report_line(s, "unrecognized", s->unrecognized, fp);
+
+    fprintf(fp, "time: %.6f s for the sample, %.1f ns per word, about "
+        "%.3f s to decode and render the whole image\n", s->secs,
+        s->secs / s->n * 1e9, s->secs / s->n * s->words);
+}
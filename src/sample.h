@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_SAMPLE_H__
+#define __ADIS_SAMPLE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "decode.h"
+#include "image.h"
+
+// Sampled words are gathered and then timed in batches of this many
+#define ADIS_SAMPLE_BATCH       65536
+
+// z for the two-sided 95% confidence intervals
+#define ADIS_SAMPLE_Z           1.96
+
+/*
+ * Estimates of the instruction mix of an image from a sample of its
+ * words. Each word is in the sample with probability rate, picked with
+ * geometrically distributed gaps so the sample comes out in address
+ * order; with strided set, every (1 / rate)th word is taken instead,
+ * starting at a random one of the first stride words.
+ */
+struct adis_sample {
+    double rate;
+    int strided;
+    uint64_t seed;
+
+    uint64_t words;             // in the whole image
+    uint64_t n;                 // in the sample
+    uint64_t counts[ADIS_NUM_CLASSES];
+    uint64_t unrecognized;      // words disasm_line() would stop at
+    double secs;                // decoding and rendering the sample
+};
+
+void sample_init(struct adis_sample *s, double rate, int strided);
+
+/*
+ * Decode and render the sampled words of img through the same path as
+ * plain disassembly, with the output thrown away. Returns 0 on error.
+ */
+int sample_image(struct adis_sample *s, const struct adis_image *img);
+
+/*
+ * Print the estimated number and share of words of each class, and of
+ * unrecognized words, with 95% Wilson score intervals (corrected for the
+ * size of the image), then the time a full run would take to decode and
+ * render the image at the rate the sample went.
+ */
+void sample_report(const struct adis_sample *s, FILE *fp);
+
+#endif  // __ADIS_SAMPLE_H__
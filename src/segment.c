@@ -0,0 +1,396 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "buffer.h"
+#include "common.h"
+#include "decode.h"
+#include "segment.h"
+
+/*
+ * Four words at a time with GCC vector extensions. The words are loaded
+ * as they are stored, most significant byte first, so where the
+ * condition field ends up in a lane depends on the host.
+ */
+typedef uint32_t v4su __attribute__((vector_size(16)));
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ADIS_SEGMENT_COND(_w)   (((_w) >> 4) & 0xF)
+#else
+#define ADIS_SEGMENT_COND(_w)   ((_w) >> 28)
+#endif
+
+// Window bytes, for the c * log2(c) table
+#define ADIS_SEGMENT_WINDOW_BYTES   (ADIS_SEGMENT_WINDOW * ADIS_SEGMENT_BLOCK * 4)
+
+struct block_stats {
+    uint8_t words;
+    uint8_t recognized;
+    uint8_t plausible;
+    uint8_t al;
+};
+
+/*
+ * The class predicates run one word at a time, before the vector pass.
+ * known[i] is set for words that are recognized. The --match class
+ * prefilter would only rule words out, and almost every word passes it
+ * (over 98% of random data does), so the predicates would still run for
+ * nearly all of them.
+ */
+static unsigned classify_words(const struct adis_image *img, size_t off,
+    size_t n, uint32_t *known)
+{
+    unsigned recognized = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        known[i] = get_instr_class(image_word(img, off + i * 4)) !=
+            ADIS_CLASS_UNKNOWN;
+        recognized += known[i];
+    }
+
+    return recognized;
+}
+
+// Statistics of a whole block, the rest of them four words at a time
+static void block_vector(const struct adis_image *img, size_t off,
+    struct block_stats *b)
+{
+    uint32_t known[ADIS_SEGMENT_BLOCK];
+    v4su w, k, c, blank, al = { 0 }, plausible = { 0 };
+    size_t i;
+
+    b->words = ADIS_SEGMENT_BLOCK;
+    b->recognized = classify_words(img, off, ADIS_SEGMENT_BLOCK, known);
+
+    for (i = 0; i < ADIS_SEGMENT_BLOCK; i += 4) {
+        memcpy(&w, img->data + off + i * 4, sizeof(w));
+        memcpy(&k, known + i, sizeof(k));
+        c = ADIS_SEGMENT_COND(w);
+        blank = (v4su)(w == 0) | (v4su)(w == ~0U);
+
+        // comparisons are -1 where they hold
+        al -= (v4su)(c == 0xE) & ~blank;
+        plausible -= (v4su)(k != 0) & (v4su)(c != 0xF) & ~blank;
+    }
+
+    b->al = al[0] + al[1] + al[2] + al[3];
+    b->plausible = plausible[0] + plausible[1] + plausible[2] + plausible[3];
+}
+
+// Same as above for the last few words of an image
+static void block_scalar(const struct adis_image *img, size_t off, size_t n,
+    struct block_stats *b)
+{
+    uint32_t known[ADIS_SEGMENT_BLOCK], op;
+    size_t i;
+    int blank;
+
+    b->words = n;
+    b->recognized = classify_words(img, off, n, known);
+    b->al = 0;
+    b->plausible = 0;
+
+    for (i = 0; i < n; i++) {
+        op = image_word(img, off + i * 4);
+        blank = op == 0 || op == ~0U;
+        b->al += (op >> 28) == 0xE && !blank;
+        b->plausible += known[i] && (op >> 28) != 0xF && !blank;
+    }
+}
+
+/*
+ * Byte histogram of a sliding window. The entropy is log2(n) - sum / n
+ * with sum the total of c * log2(c) over the counts c, which is kept up
+ * to date as bytes come and go.
+ */
+struct entropy_window {
+    unsigned counts[256];
+    double clog[ADIS_SEGMENT_WINDOW_BYTES + 1];
+    double sum;
+    size_t n;
+};
+
+static void entropy_init(struct entropy_window *e)
+{
+    size_t c;
+
+    memset(e->counts, 0, sizeof(e->counts));
+    e->sum = 0;
+    e->n = 0;
+
+    e->clog[0] = 0;
+    for (c = 1; c <= ADIS_SEGMENT_WINDOW_BYTES; c++) {
+        e->clog[c] = c * log2(c);
+    }
+}
+
+static void entropy_update(struct entropy_window *e, const uint8_t *p,
+    size_t len, int add)
+{
+    unsigned *c;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        c = &e->counts[p[i]];
+        e->sum -= e->clog[*c];
+        *c += add ? 1 : -1;
+        e->sum += e->clog[*c];
+    }
+
+    e->n += add ? len : -len;
+}
+
+static double entropy_get(const struct entropy_window *e)
+{
+    return e->n ? log2(e->n) - e->sum / e->n : 0;
+}
+
+static int segment_add(struct adis_segments *s, size_t *size, uint32_t start,
+    uint32_t end, int code)
+{
+    struct segment *tmp;
+
+    if (s->n == *size) {
+        *size = *size ? *size * 2 : 64;
+        tmp = realloc(s->regions, sizeof(*tmp) * *size);
+        if (tmp == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            return 0;
+        }
+        s->regions = tmp;
+    }
+
+    memset(&s->regions[s->n], 0, sizeof(*s->regions));
+    s->regions[s->n].start = start;
+    s->regions[s->n].end = end;
+    s->regions[s->n].code = code;
+    s->n++;
+    return 1;
+}
+
+/*
+ * Runs of blocks with the same label, short ones merged into the run
+ * before them (or after them, at the start of the image).
+ */
+static int segment_runs(struct adis_segments *s, const uint8_t *labels,
+    size_t nblocks, size_t nwords)
+{
+    size_t i, j, size = 0;
+    struct segment *last;
+    uint32_t start, end;
+
+    for (i = 0; i < nblocks; i = j) {
+        for (j = i + 1; j < nblocks && labels[j] == labels[i]; j++) {
+            ;
+        }
+
+        start = i * ADIS_SEGMENT_BLOCK * 4;
+        end = (j == nblocks ? nwords : j * ADIS_SEGMENT_BLOCK) * 4 - 4;
+        last = s->n > 0 ? &s->regions[s->n - 1] : NULL;
+
+        if (last != NULL && (j - i < ADIS_SEGMENT_MIN_BLOCKS ||
+            last->code == labels[i])) {
+            last->end = end;
+        } else if (!segment_add(s, &size, start, end, labels[i])) {
+            return 0;
+        } else if (last == NULL && j - i < ADIS_SEGMENT_MIN_BLOCKS &&
+            j < nblocks) {
+            s->regions[0].code = labels[j];
+        }
+    }
+
+    return 1;
+}
+
+// Statistics of each region from its blocks, the entropy over all of it
+static void segment_stats(struct adis_segments *s, const struct adis_image *img,
+    const struct block_stats *blocks)
+{
+    unsigned long long words, recognized, plausible, al;
+    unsigned long long counts[256];
+    struct segment *r;
+    size_t i, b, off;
+    double h, p;
+
+    for (i = 0; i < s->n; i++) {
+        r = &s->regions[i];
+        words = recognized = plausible = al = 0;
+
+        for (b = r->start / (ADIS_SEGMENT_BLOCK * 4);
+             b <= r->end / (ADIS_SEGMENT_BLOCK * 4); b++) {
+            words += blocks[b].words;
+            recognized += blocks[b].recognized;
+            plausible += blocks[b].plausible;
+            al += blocks[b].al;
+        }
+
+        memset(counts, 0, sizeof(counts));
+        for (off = r->start; off < (size_t)r->end + 4; off++) {
+            counts[img->data[off]]++;
+        }
+
+        h = 0;
+        for (b = 0; b < 256; b++) {
+            if (counts[b] > 0) {
+                p = (double)counts[b] / (words * 4);
+                h -= p * log2(p);
+            }
+        }
+
+        r->recognized = (double)recognized / words;
+        r->plausible = (double)plausible / words;
+        r->al = (double)al / words;
+        r->entropy = h;
+    }
+}
+
+int segment_image(struct adis_segments *s, const struct adis_image *img)
+{
+    size_t nwords, nblocks, i, lo, hi, words, plausible, al;
+    size_t bytes = ADIS_SEGMENT_BLOCK * 4;
+    struct block_stats *blocks;
+    struct entropy_window *e;
+    uint8_t *labels;
+    int ret = 0;
+
+    s->regions = NULL;
+    s->n = 0;
+
+    nwords = ADIS_MIN(image_words_size(img), (size_t)0xFFFFFFFC) / 4;
+    nblocks = (nwords + ADIS_SEGMENT_BLOCK - 1) / ADIS_SEGMENT_BLOCK;
+    if (nblocks == 0) {
+        return 1;
+    }
+
+    blocks = malloc(sizeof(*blocks) * nblocks);
+    labels = malloc(nblocks);
+    e = malloc(sizeof(*e));
+    if (blocks == NULL || labels == NULL || e == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        goto out;
+    }
+
+    for (i = 0; i < nwords / ADIS_SEGMENT_BLOCK; i++) {
+        block_vector(img, i * bytes, &blocks[i]);
+    }
+    if (i < nblocks) {
+        block_scalar(img, i * bytes, nwords - i * ADIS_SEGMENT_BLOCK,
+            &blocks[i]);
+    }
+
+    /*
+     * Slide the window [i - WINDOW / 2 + 1, i + WINDOW / 2] over the
+     * blocks, clipped to the image.
+     */
+    entropy_init(e);
+    words = plausible = al = 0;
+    lo = 0;
+    hi = 0;
+
+    for (i = 0; i < nblocks; i++) {
+        for (; hi < nblocks && hi <= i + ADIS_SEGMENT_WINDOW / 2; hi++) {
+            words += blocks[hi].words;
+            plausible += blocks[hi].plausible;
+            al += blocks[hi].al;
+            entropy_update(e, img->data + hi * bytes, blocks[hi].words * 4, 1);
+        }
+        for (; lo + ADIS_SEGMENT_WINDOW / 2 < i + 1; lo++) {
+            words -= blocks[lo].words;
+            plausible -= blocks[lo].plausible;
+            al -= blocks[lo].al;
+            entropy_update(e, img->data + lo * bytes, blocks[lo].words * 4, 0);
+        }
+
+        labels[i] = plausible >= ADIS_SEGMENT_MIN_PLAUSIBLE * words &&
+            al >= ADIS_SEGMENT_MIN_AL * words &&
+            entropy_get(e) <= ADIS_SEGMENT_MAX_ENTROPY;
+    }
+
+    if (segment_runs(s, labels, nblocks, nwords)) {
+        segment_stats(s, img, blocks);
+        ret = 1;
+    }
+
+out:
+    free(blocks);
+    free(labels);
+    free(e);
+    return ret;
+}
+
+void segments_free(struct adis_segments *s)
+{
+    free(s->regions);
+    s->regions = NULL;
+    s->n = 0;
+}
+
+void segments_report(const struct adis_segments *s, FILE *fp)
+{
+    const struct segment *r;
+    size_t i;
+
+    for (i = 0; i < s->n; i++) {
+        r = &s->regions[i];
+        fprintf(fp, "%s 0x%.8X-0x%.8X bytes=%llu recognized=%.3f "
+            "plausible=%.3f al=%.3f entropy=%.3f\n", r->code ? "code" : "data",
+            r->start, r->end, (unsigned long long)r->end - r->start + 4,
+            r->recognized, r->plausible, r->al, r->entropy);
+    }
+}
+
+long segments_disasm(const struct adis_segments *s,
+    const struct adis_image *img, FILE *fp)
+{
+    struct adis_buffer out, *prev;
+    const struct segment *r;
+    uint64_t addr;
+    long count = 0;
+    size_t i;
+
+    buffer_init(&out);
+    prev = set_output_buffer(&out);
+
+    for (i = 0; i < s->n; i++) {
+        r = &s->regions[i];
+
+        if (!r->code) {
+            adis_printf("-- data 0x%.8X-0x%.8X: %llu bytes\n", r->start,
+                r->end, (unsigned long long)r->end - r->start + 4);
+            continue;
+        }
+
+        for (addr = r->start; addr <= r->end; addr += 4) {
+            disasm_line(image_word(img, addr), addr);
+            count++;
+
+            if (out.len >= ADIS_FLUSH_SIZE) {
+                buffer_flush(&out, fp);
+            }
+        }
+    }
+
+    buffer_flush(&out, fp);
+    set_output_buffer(prev);
+    buffer_free(&out);
+    return count;
+}
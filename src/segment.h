@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_SEGMENT_H__
+#define __ADIS_SEGMENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+
+// Words are scored in blocks, each from the window of blocks around it
+#define ADIS_SEGMENT_BLOCK          16
+#define ADIS_SEGMENT_WINDOW         4
+
+// What a window needs to be taken for code
+#define ADIS_SEGMENT_MIN_PLAUSIBLE  0.85
+#define ADIS_SEGMENT_MIN_AL         0.5
+#define ADIS_SEGMENT_MAX_ENTROPY    7.0     // bits per byte
+
+// Shorter runs of blocks are merged into the region before them
+#define ADIS_SEGMENT_MIN_BLOCKS     4
+
+/*
+ * A run of code or data in a raw image, from start to the last word at
+ * end (addresses, which are offsets in raw images), with statistics
+ * over its words: the share the class predicates recognize, the share
+ * of plausible encodings (recognized, not in the unconditional space and
+ * not all zeros or ones), the share with
+ * the AL condition and the byte entropy.
+ */
+struct segment {
+    uint32_t start;
+    uint32_t end;
+    int code;
+    double recognized;
+    double plausible;
+    double al;
+    double entropy;
+};
+
+struct adis_segments {
+    struct segment *regions;
+    size_t n;
+};
+
+/*
+ * Split img into code and data. Each block of ADIS_SEGMENT_BLOCK words
+ * is code if the window of ADIS_SEGMENT_WINDOW blocks around it has
+ * enough plausible encodings, enough of them with the AL condition (code
+ * rarely has less than half, data has about one in sixteen) and a low
+ * enough entropy (compressed data has close to 8 bits per byte). Returns
+ * 0 on error.
+ */
+int segment_image(struct adis_segments *s, const struct adis_image *img);
+void segments_free(struct adis_segments *s);
+
+/*
+ * The region map, one line per region:
+ *
+ *      code 0x00000000-0x00003F00 bytes=16128 recognized=0.812
+ *          plausible=0.977 al=0.861 entropy=5.214
+ *
+ * (on one line).
+ */
+void segments_report(const struct adis_segments *s, FILE *fp);
+
+/*
+ * Disassemble only the code regions, carrying on past unrecognized
+ * words, with a "-- data 0x...-0x...: N bytes" line in place of each
+ * data region. Returns the number of words disassembled, or -1 on error.
+ */
+long segments_disasm(const struct adis_segments *s,
+    const struct adis_image *img, FILE *fp);
+
+#endif  // __ADIS_SEGMENT_H__
@@ -0,0 +1,481 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "seq.h"
+#include "decode.h"
+#include "common.h"
+
+#define ADIS_SEQ_SET_WORDS      (ADIS_SEQ_MAX_POS / 64)
+
+// Once either limit is hit the automaton is thrown away and rebuilt
+#define ADIS_SEQ_MAX_STATES     4096
+#define ADIS_SEQ_MAX_SYMBOLS    4096
+#define ADIS_SEQ_HASH_SIZE      (2 * ADIS_SEQ_MAX_STATES)
+
+static int seq_push_elem(struct adis_seq *s, int any, int optional,
+    uint64_t terms)
+{
+    struct seq_elem *e;
+
+    if (s->nelems == ADIS_SEQ_MAX_POS) {
+        return 0;
+    }
+
+    e = &s->elems[s->nelems++];
+    e->terms = terms;
+    e->any = any;
+    e->optional = optional;
+    return 1;
+}
+
+static int seq_intern_term(struct adis_seq *s, const struct match_term *t)
+{
+    size_t i;
+
+    for (i = 0; i < s->nterms; i++) {
+        if (s->terms[i].mask == t->mask && s->terms[i].bits == t->bits &&
+            s->terms[i].cls == t->cls && s->terms[i].id == t->id) {
+            return i;
+        }
+    }
+
+    if (s->nterms == ADIS_SEQ_MAX_TERMS) {
+        return -1;
+    }
+
+    s->terms[s->nterms] = *t;
+    return s->nterms++;
+}
+
+static int seq_parse_elem(struct adis_seq *s, const char *p, const char *end)
+{
+    struct match_term t;
+    uint64_t terms = 0;
+    unsigned long n;
+    const char *q;
+    char *r;
+    int i;
+
+    while (p < end && isspace((unsigned char)*p)) {
+        p++;
+    }
+    while (end > p && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+
+    if (p == end) {
+        return 0;
+    } else if (*p == '*' && end - p == 1) {
+        return seq_push_elem(s, 1, 0, 0);
+    } else if (*p == '*') {
+        n = strtoul(p + 1, &r, 10);
+        if (r != end || n == 0 || n > ADIS_SEQ_MAX_POS) {
+            return 0;
+        }
+        while (n--) {
+            if (!seq_push_elem(s, 1, 1, 0)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    for (; p < end; p = q + 1) {
+        for (q = p; q < end && *q != ','; q++)
+            ;
+        if (!match_parse_term(p, q - p, &t) ||
+            (i = seq_intern_term(s, &t)) < 0) {
+            return 0;
+        }
+        terms |= (uint64_t)1 << i;
+    }
+
+    return seq_push_elem(s, 0, 0, terms);
+}
+
+int seq_add(struct adis_seq *s, const char *pattern)
+{
+    size_t nterms = s->nterms, i;
+    struct seq_pattern *pat;
+    const char *end;
+
+    if (s->npats == ADIS_SEQ_MAX_PATTERNS) {
+        return 0;
+    }
+
+    pat = &s->pats[s->npats];
+    pat->first = s->nelems;
+
+    for (;;) {
+        end = strchr(pattern, ';');
+        if (end == NULL) {
+            end = pattern + strlen(pattern);
+        }
+
+        if (!seq_parse_elem(s, pattern, end)) {
+            goto fail;
+        } else if (*end == 0) {
+            break;
+        }
+
+        pattern = end + 1;
+    }
+
+    pat->len = s->nelems - pat->first;
+    pat->minlen = 0;
+    for (i = pat->first; i < s->nelems; i++) {
+        pat->minlen += !s->elems[i].optional;
+    }
+
+    // gaps only make sense between two elements
+    if (s->elems[pat->first].optional || s->elems[s->nelems - 1].optional ||
+        !seq_push_elem(s, 0, 0, 0)) {
+        goto fail;
+    }
+
+    s->npats++;
+    return 1;
+
+fail:
+    s->nelems = pat->first;
+    s->nterms = nterms;
+    return 0;
+}
+
+// Bitmask of the terms a word matches, the input symbol of the automaton
+static uint64_t seq_symbol(const struct adis_seq *s, uint32_t op)
+{
+    struct adis_instr in;
+    uint64_t sym = 0;
+    size_t i;
+
+    decode_instr(op, &in);
+
+    for (i = 0; i < s->nterms; i++) {
+        if (match_term_test(&s->terms[i], &in)) {
+            sym |= (uint64_t)1 << i;
+        }
+    }
+
+    return sym;
+}
+
+static inline int set_test(const uint64_t *set, size_t pos)
+{
+    return (set[pos / 64] >> (pos % 64)) & 1;
+}
+
+// Enter pos, and everything after it that optional elements can skip to
+static void seq_closure(const struct adis_seq *s, uint64_t *set, size_t pos)
+{
+    for (;;) {
+        set[pos / 64] |= (uint64_t)1 << (pos % 64);
+        if (!s->elems[pos].optional) {
+            break;
+        }
+        pos++;
+    }
+}
+
+// Positions reached from the ones in from after a word matching sym
+static void seq_advance(const struct adis_seq *s, const uint64_t *from,
+    uint64_t sym, uint64_t *to)
+{
+    const struct seq_elem *e;
+    uint64_t bits;
+    size_t i, pos;
+
+    memset(to, 0, sizeof(*to) * ADIS_SEQ_SET_WORDS);
+
+    for (i = 0; i < ADIS_SEQ_SET_WORDS; i++) {
+        for (bits = from[i]; bits != 0; bits &= bits - 1) {
+            pos = i * 64 + __builtin_ctzll(bits);
+            e = &s->elems[pos];
+            if (e->any || (e->terms & sym)) {
+                seq_closure(s, to, pos + 1);
+            }
+        }
+    }
+}
+
+/*
+ * A state of the automaton is the set of pattern positions that are
+ * still alive. The start positions of every pattern are implicitly in
+ * each set, so an occurrence can begin at any word, and transitions are
+ * only computed the first time a state sees a symbol.
+ */
+struct seq_state {
+    uint64_t set[ADIS_SEQ_SET_WORDS];
+    uint64_t accept;
+    int32_t *next;
+    size_t nnext;
+};
+
+struct seq_dfa {
+    const struct adis_seq *seq;
+    uint64_t start[ADIS_SEQ_SET_WORDS];
+    struct seq_state *states;
+    size_t nstates;
+    int32_t state_hash[ADIS_SEQ_HASH_SIZE];
+    uint64_t syms[ADIS_SEQ_MAX_SYMBOLS];
+    size_t nsyms;
+    int32_t sym_hash[ADIS_SEQ_HASH_SIZE];
+};
+
+static void dfa_reset(struct seq_dfa *d)
+{
+    size_t i;
+
+    for (i = 0; i < d->nstates; i++) {
+        free(d->states[i].next);
+    }
+
+    d->nstates = 0;
+    d->nsyms = 0;
+    memset(d->state_hash, 0xFF, sizeof(d->state_hash));
+    memset(d->sym_hash, 0xFF, sizeof(d->sym_hash));
+}
+
+// Returns -1 when the table is full
+static int32_t dfa_state(struct seq_dfa *d, const uint64_t *set)
+{
+    size_t h = adis_hash64(set, sizeof(*set) * ADIS_SEQ_SET_WORDS);
+    const struct adis_seq *s = d->seq;
+    struct seq_state *st;
+    int32_t id;
+    size_t p;
+
+    for (h &= ADIS_SEQ_HASH_SIZE - 1; (id = d->state_hash[h]) >= 0;
+         h = (h + 1) & (ADIS_SEQ_HASH_SIZE - 1)) {
+        if (!memcmp(d->states[id].set, set, sizeof(d->states[id].set))) {
+            return id;
+        }
+    }
+
+    if (d->nstates == ADIS_SEQ_MAX_STATES) {
+        return -1;
+    }
+
+    id = d->nstates++;
+    st = &d->states[id];
+    memcpy(st->set, set, sizeof(st->set));
+    st->next = NULL;
+    st->nnext = 0;
+    st->accept = 0;
+
+    for (p = 0; p < s->npats; p++) {
+        if (set_test(set, s->pats[p].first + s->pats[p].len)) {
+            st->accept |= (uint64_t)1 << p;
+        }
+    }
+
+    d->state_hash[h] = id;
+    return id;
+}
+
+static int32_t dfa_symbol(struct seq_dfa *d, uint64_t sym)
+{
+    size_t h = adis_hash64(&sym, sizeof(sym));
+    int32_t id;
+
+    for (h &= ADIS_SEQ_HASH_SIZE - 1; (id = d->sym_hash[h]) >= 0;
+         h = (h + 1) & (ADIS_SEQ_HASH_SIZE - 1)) {
+        if (d->syms[id] == sym) {
+            return id;
+        }
+    }
+
+    if (d->nsyms == ADIS_SEQ_MAX_SYMBOLS) {
+        return -1;
+    }
+
+    id = d->nsyms++;
+    d->syms[id] = sym;
+    d->sym_hash[h] = id;
+    return id;
+}
+
+// Follow the transition of state on sym, computing it if it's new
+static int32_t dfa_step(struct seq_dfa *d, int32_t state, uint64_t sym)
+{
+    uint64_t from[ADIS_SEQ_SET_WORDS], to[ADIS_SEQ_SET_WORDS];
+    struct seq_state *st = &d->states[state];
+    int32_t id, next, *tmp;
+    size_t i;
+
+    id = dfa_symbol(d, sym);
+    if (id >= 0 && (size_t)id < st->nnext && st->next[id] >= 0) {
+        return st->next[id];
+    }
+
+    for (i = 0; i < ADIS_SEQ_SET_WORDS; i++) {
+        from[i] = st->set[i] | d->start[i];
+    }
+
+    seq_advance(d->seq, from, sym, to);
+    next = dfa_state(d, to);
+
+    if (id < 0 || next < 0) {
+        dfa_reset(d);
+        return dfa_state(d, to);
+    }
+
+    if ((size_t)id >= st->nnext) {
+        tmp = realloc(st->next, sizeof(*tmp) * d->nsyms);
+        if (tmp == NULL) {
+            return next;
+        }
+        for (i = st->nnext; i < d->nsyms; i++) {
+            tmp[i] = -1;
+        }
+        st->next = tmp;
+        st->nnext = d->nsyms;
+    }
+
+    st->next[id] = next;
+    return next;
+}
+
+// Does pattern p match the words first .. last exactly?
+static int seq_match_at(const struct adis_seq *s, size_t p,
+    const struct adis_image *img, size_t first, size_t last)
+{
+    const struct seq_pattern *pat = &s->pats[p];
+    uint64_t set[ADIS_SEQ_SET_WORDS], next[ADIS_SEQ_SET_WORDS];
+    size_t w, i;
+    int alive;
+
+    memset(set, 0, sizeof(set));
+    seq_closure(s, set, pat->first);
+
+    for (w = first; w <= last; w++) {
+        seq_advance(s, set, seq_symbol(s, image_word(img, w * 4)), next);
+        memcpy(set, next, sizeof(set));
+
+        for (alive = 0, i = 0; i < ADIS_SEQ_SET_WORDS; i++) {
+            alive |= set[i] != 0;
+        }
+        if (!alive) {
+            return 0;
+        }
+    }
+
+    return set_test(set, pat->first + pat->len);
+}
+
+/*
+ * The automaton only knows where an occurrence ends. Find the latest
+ * start, which gives the shortest occurrence when there are gaps.
+ */
+static size_t seq_match_start(const struct adis_seq *s, size_t p,
+    const struct adis_image *img, size_t last)
+{
+    const struct seq_pattern *pat = &s->pats[p];
+    size_t first = last + 1 - pat->minlen;
+    size_t min = last + 1 >= pat->len ? last + 1 - pat->len : 0;
+
+    for (; first > min; first--) {
+        if (seq_match_at(s, p, img, first, last)) {
+            return first;
+        }
+    }
+
+    // the automaton saw an occurrence, so it can only be the longest one
+    return min;
+}
+
+long seq_disasm(const struct adis_seq *s, const struct adis_image *img,
+    size_t context, FILE *fp)
+{
+    uint64_t empty[ADIS_SEQ_SET_WORDS] = { 0 }, accept;
+    size_t w, p, first, maxlen = 0, pending = 0, start = 0, end = 0;
+    struct match_out mo;
+    struct seq_dfa *d;
+    int32_t state;
+    long count = 0;
+
+    d = malloc(sizeof(*d));
+    if (d == NULL || (d->states = malloc(sizeof(*d->states) *
+                                         ADIS_SEQ_MAX_STATES)) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        free(d);
+        return -1;
+    }
+
+    d->seq = s;
+    d->nstates = 0;
+    memset(d->start, 0, sizeof(d->start));
+    for (p = 0; p < s->npats; p++) {
+        seq_closure(s, d->start, s->pats[p].first);
+        maxlen = ADIS_MAX(maxlen, s->pats[p].len);
+    }
+
+    dfa_reset(d);
+    state = dfa_state(d, empty);
+
+    match_out_init(&mo, img, context, 1, fp);
+
+    /*
+     * Occurrences are found in order of their last word, but a longer one
+     * can start before a shorter one that ended earlier. Merge them into
+     * a pending range until no later occurrence can reach back into it.
+     */
+    for (w = 0; w < mo.nwords; w++) {
+        state = dfa_step(d, state, seq_symbol(s, image_word(img, w * 4)));
+
+        for (accept = d->states[state].accept; accept; accept &= accept - 1) {
+            p = __builtin_ctzll(accept);
+            first = seq_match_start(s, p, img, w);
+
+            if (pending && first <= end + 1) {
+                start = ADIS_MIN(start, first);
+            } else {
+                if (pending) {
+                    match_out_range(&mo, start, end);
+                }
+                start = first;
+                pending = 1;
+            }
+
+            end = w;
+            count++;
+        }
+
+        if (pending && end + maxlen < w + 1) {
+            match_out_range(&mo, start, end);
+            pending = 0;
+        }
+    }
+
+    if (pending) {
+        match_out_range(&mo, start, end);
+    }
+
+    match_out_finish(&mo);
+
+    dfa_reset(d);
+    free(d->states);
+    free(d);
+
+    return count;
+}
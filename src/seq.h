@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_SEQ_H__
+#define __ADIS_SEQ_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+#include "match.h"
+
+#define ADIS_SEQ_MAX_TERMS      64
+#define ADIS_SEQ_MAX_PATTERNS   64
+#define ADIS_SEQ_MAX_POS        256
+
+/*
+ * One position of a sequence pattern. A word fits the element if it
+ * matches any of the terms in the bitmask, or anything at all for
+ * wildcards. Optional elements may also be skipped, which is how gaps of
+ * up to N words are expressed.
+ */
+struct seq_elem {
+    uint64_t terms;
+    uint8_t any;
+    uint8_t optional;
+};
+
+/*
+ * Elements first .. first + len - 1 of a pattern, followed by one
+ * element marking that the whole pattern matched.
+ */
+struct seq_pattern {
+    size_t first;
+    size_t len;
+    size_t minlen;
+};
+
+struct adis_seq {
+    struct match_term terms[ADIS_SEQ_MAX_TERMS];
+    size_t nterms;
+    struct seq_elem elems[ADIS_SEQ_MAX_POS];
+    size_t nelems;
+    struct seq_pattern pats[ADIS_SEQ_MAX_PATTERNS];
+    size_t npats;
+};
+
+/*
+ * Add a pattern of ';' separated elements. Each element is a comma
+ * separated list of match specs (see match.h), "*" for any one word or
+ * "*N" for a gap of up to N words. Returns 0 if it doesn't parse or the
+ * limits above are exceeded.
+ */
+int seq_add(struct adis_seq *s, const char *pattern);
+
+/*
+ * Disassemble every occurrence of any of the patterns, with up to context
+ * words around it. All patterns are matched in a single pass by a lazily
+ * built automaton, so the cost per word doesn't grow with the number of
+ * patterns. Returns the number of occurrences, or -1 on error.
+ */
+long seq_disasm(const struct adis_seq *s, const struct adis_image *img,
+    size_t context, FILE *fp);
+
+#endif  // __ADIS_SEQ_H__
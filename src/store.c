@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "store.h"
+#include "decode.h"
+#include "common.h"
+
+int store_build(struct adis_store *st, const struct adis_image *img,
+    uint32_t base)
+{
+    struct adis_instr in;
+    size_t i, n = image_words_size(img) / 4;
+    uint32_t op;
+
+    st->base = base;
+    st->count = n;
+    st->op = malloc(sizeof(*st->op) * (n ? n : 1));
+    st->id = malloc(sizeof(*st->id) * (n ? n : 1));
+    st->cls = malloc(sizeof(*st->cls) * (n ? n : 1));
+
+    if (st->op == NULL || st->id == NULL || st->cls == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        store_free(st);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        op = image_word(img, i * 4);
+        decode_instr(op, &in);
+
+        st->op[i] = op;
+        st->id[i] = in.id;
+        st->cls[i] = in.cls;
+    }
+
+    return 1;
+}
+
+void store_free(struct adis_store *st)
+{
+    free(st->op);
+    free(st->id);
+    free(st->cls);
+
+    st->op = NULL;
+    st->id = st->cls = NULL;
+    st->count = 0;
+}
+
+long store_row(const struct adis_store *st, uint32_t addr)
+{
+    if (addr < st->base || (addr - st->base) / 4 >= st->count) {
+        return -1;
+    }
+
+    return (addr - st->base) / 4;
+}
+
+void store_instr(const struct adis_store *st, size_t row,
+    struct adis_instr *in)
+{
+    in->op = st->op[row];
+    in->id = st->id[row];
+    in->cls = st->cls[row];
+    in->cond = in->op >> 28;
+}
+
+void store_render(const struct adis_store *st, size_t first, size_t count)
+{
+    struct adis_instr in;
+    size_t i;
+
+    if (first >= st->count) {
+        return;
+    }
+
+    count = ADIS_MIN(count, st->count - first);
+
+    for (i = first; i < first + count; i++) {
+        store_instr(st, i, &in);
+        disasm_decoded_line(&in, st->base + i * 4);
+    }
+}
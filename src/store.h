@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_STORE_H__
+#define __ADIS_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+#include "decode.h"
+#include "image.h"
+
+/*
+ * Columnar instruction store for viewers that decode a whole image up
+ * front but only ever show a screenful of it. Every field lives in its
+ * own dense array, 6 bytes per instruction in total, and text is only
+ * rendered for the rows that are asked for. Only what needs decoding is
+ * kept: the condition and register fields are bits of the raw word and
+ * the immediate is computed from it (see store_instr()).
+ */
+struct adis_store {
+    uint32_t base;
+    size_t count;
+
+    uint32_t *op;       // raw instruction words
+    uint8_t *id;        // ADIS_OP_*
+    uint8_t *cls;       // ADIS_CLASS_*
+};
+
+int store_build(struct adis_store *st, const struct adis_image *img,
+    uint32_t base);
+void store_free(struct adis_store *st);
+
+// Row number of an address, or -1 if it is outside the store
+long store_row(const struct adis_store *st, uint32_t addr);
+
+/*
+ * The decoded instruction of a row, for ADIS_RN() and friends on in->op
+ * and get_instr_imm().
+ */
+void store_instr(const struct adis_store *st, size_t row,
+    struct adis_instr *in);
+
+/*
+ * Render rows [first, first + count) into the output buffer of the
+ * calling thread, in the same format as the regular output.
+ */
+void store_render(const struct adis_store *st, size_t first, size_t count);
+
+#endif  // __ADIS_STORE_H__
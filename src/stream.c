@@ -0,0 +1,342 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef ADIS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "stream.h"
+
+#define ADIS_STREAM_IN_SIZE     65536
+
+int stream_detect(const uint8_t *p, size_t n)
+{
+    if (n >= 2 && p[0] == 0x1F && p[1] == 0x8B) {
+        return ADIS_STREAM_GZIP;
+    } else if (n >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F &&
+               p[3] == 0xFD) {
+        return ADIS_STREAM_ZSTD;
+    }
+
+    return ADIS_STREAM_NONE;
+}
+
+// Compressed bytes, the detection prefix first
+static ssize_t stream_read(struct adis_stream *s, uint8_t *buf, size_t size)
+{
+    ssize_t n;
+
+    if (s->nprefix > 0) {
+        n = s->nprefix < size ? s->nprefix : size;
+        memcpy(buf, s->prefix, n);
+        memmove(s->prefix, s->prefix + n, s->nprefix - n);
+        s->nprefix -= n;
+        return n;
+    }
+
+    n = read(s->fd, buf, size);
+    if (n < 0) {
+        perror(s->name);
+    }
+
+    return n;
+}
+
+/*
+ * Space left in the chunk being filled, waiting for the reader to give
+ * one back if the ring is full. NULL once the reader has gone away.
+ */
+static struct stream_chunk *stream_out(struct adis_stream *s)
+{
+    struct stream_chunk *c = &s->chunks[s->head];
+
+    if (c->len < ADIS_STREAM_CHUNK_SIZE) {
+        return c;
+    }
+
+    // hand over the full chunk
+    pthread_mutex_lock(&s->lock);
+    s->count++;
+    s->head = (s->head + 1) % ADIS_STREAM_CHUNKS;
+    pthread_cond_broadcast(&s->cond);
+
+    while (s->count == ADIS_STREAM_CHUNKS && !s->stop) {
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    if (s->stop) {
+        return NULL;
+    }
+
+    c = &s->chunks[s->head];
+    c->len = 0;
+    return c;
+}
+
+static int stream_gzip(struct adis_stream *s, uint8_t *in)
+{
+    struct stream_chunk *c;
+    int ret = Z_OK, ended = 0;
+    z_stream zs;
+    ssize_t n;
+
+    memset(&zs, 0, sizeof(zs));
+
+    // 32 lets zlib tell gzip and zlib headers apart
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+        fprintf(stderr, "ADIS_ERROR: Failed to initialize zlib\n");
+        return 0;
+    }
+
+    for (;;) {
+        if (zs.avail_in == 0) {
+            if ((n = stream_read(s, in, ADIS_STREAM_IN_SIZE)) < 0) {
+                ended = 0;
+                break;
+            } else if (n == 0) {
+                if (!ended) {
+                    fprintf(stderr, "ADIS_ERROR: %s: truncated gzip input\n",
+                        s->name);
+                }
+                break;
+            }
+            zs.next_in = in;
+            zs.avail_in = n;
+        }
+
+        // another member follows the one that just ended
+        if (ended) {
+            inflateReset(&zs);
+            ended = 0;
+        }
+
+        if ((c = stream_out(s)) == NULL) {
+            ended = 1;
+            break;
+        }
+
+        zs.next_out = c->data + c->len;
+        zs.avail_out = ADIS_STREAM_CHUNK_SIZE - c->len;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        c->len = ADIS_STREAM_CHUNK_SIZE - zs.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            ended = 1;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            fprintf(stderr, "ADIS_ERROR: %s: corrupt gzip input\n", s->name);
+            break;
+        }
+    }
+
+    inflateEnd(&zs);
+    return ended;
+}
+
+#ifdef ADIS_HAVE_ZSTD
+static int stream_zstd(struct adis_stream *s, uint8_t *in)
+{
+    ZSTD_inBuffer zin = { in, 0, 0 };
+    ZSTD_outBuffer zout;
+    struct stream_chunk *c;
+    ZSTD_DStream *zd;
+    size_t ret = 1;
+    int ok = 0;
+    ssize_t n;
+
+    if ((zd = ZSTD_createDStream()) == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return 0;
+    }
+
+    ZSTD_initDStream(zd);
+
+    for (;;) {
+        if (zin.pos == zin.size) {
+            if ((n = stream_read(s, in, ADIS_STREAM_IN_SIZE)) < 0) {
+                break;
+            } else if (n == 0) {
+                // 0 means the last frame was complete
+                ok = ret == 0;
+                if (!ok) {
+                    fprintf(stderr, "ADIS_ERROR: %s: truncated zstd input\n",
+                        s->name);
+                }
+                break;
+            }
+            zin.pos = 0;
+            zin.size = n;
+        }
+
+        if ((c = stream_out(s)) == NULL) {
+            ok = 1;
+            break;
+        }
+
+        zout.dst = c->data + c->len;
+        zout.size = ADIS_STREAM_CHUNK_SIZE - c->len;
+        zout.pos = 0;
+        ret = ZSTD_decompressStream(zd, &zout, &zin);
+        c->len += zout.pos;
+
+        if (ZSTD_isError(ret)) {
+            fprintf(stderr, "ADIS_ERROR: %s: corrupt zstd input (%s)\n",
+                s->name, ZSTD_getErrorName(ret));
+            break;
+        }
+    }
+
+    ZSTD_freeDStream(zd);
+    return ok;
+}
+#endif
+
+static void *stream_worker(void *arg)
+{
+    struct adis_stream *s = arg;
+    uint8_t *in = malloc(ADIS_STREAM_IN_SIZE);
+    int ok = 0;
+
+    if (in == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+    } else if (s->format == ADIS_STREAM_GZIP) {
+        ok = stream_gzip(s, in);
+    } else {
+#ifdef ADIS_HAVE_ZSTD
+        ok = stream_zstd(s, in);
+#else
+        fprintf(stderr, "ADIS_ERROR: %s: zstd input, but adis was built "
+            "without zstd support\n", s->name);
+#endif
+    }
+
+    free(in);
+
+    // hand over the last, partly filled chunk
+    pthread_mutex_lock(&s->lock);
+    if (s->chunks[s->head].len > 0) {
+        s->count++;
+        s->head = (s->head + 1) % ADIS_STREAM_CHUNKS;
+    }
+    s->error = !ok;
+    s->done = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+
+int stream_open(struct adis_stream *s, int fd, const char *name, int format,
+    const uint8_t *prefix, size_t nprefix)
+{
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->format = format;
+    s->name = name != NULL ? name : "stdin";
+    memcpy(s->prefix, prefix, nprefix);
+    s->nprefix = nprefix;
+
+    for (i = 0; i < ADIS_STREAM_CHUNKS; i++) {
+        if ((s->chunks[i].data = malloc(ADIS_STREAM_CHUNK_SIZE)) == NULL) {
+            fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+            while (i-- > 0) {
+                free(s->chunks[i].data);
+            }
+            return 0;
+        }
+    }
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    if (pthread_create(&s->thread, NULL, stream_worker, s) != 0) {
+        fprintf(stderr, "ADIS_ERROR: Failed to start decompression thread\n");
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->cond);
+        for (i = 0; i < ADIS_STREAM_CHUNKS; i++) {
+            free(s->chunks[i].data);
+        }
+        return 0;
+    }
+
+    return 1;
+}
+
+const uint8_t *stream_next(struct adis_stream *s, size_t *len)
+{
+    struct stream_chunk *c;
+
+    pthread_mutex_lock(&s->lock);
+
+    // give the previous chunk back to the worker
+    if (s->held) {
+        s->held = 0;
+        s->count--;
+        pthread_cond_broadcast(&s->cond);
+    }
+
+    while (s->count == 0 && !s->done) {
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+
+    if (s->count == 0) {
+        pthread_mutex_unlock(&s->lock);
+        *len = 0;
+        return NULL;
+    }
+
+    c = &s->chunks[s->tail];
+    s->tail = (s->tail + 1) % ADIS_STREAM_CHUNKS;
+    s->held = 1;
+    pthread_mutex_unlock(&s->lock);
+
+    *len = c->len;
+    return c->data;
+}
+
+int stream_close(struct adis_stream *s)
+{
+    int i, ok;
+
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    pthread_join(s->thread, NULL);
+    ok = !s->error;
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    for (i = 0; i < ADIS_STREAM_CHUNKS; i++) {
+        free(s->chunks[i].data);
+    }
+
+    if (s->fd != STDIN_FILENO) {
+        close(s->fd);
+    }
+
+    return ok;
+}
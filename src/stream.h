@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_STREAM_H__
+#define __ADIS_STREAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define ADIS_STREAM_CHUNKS      4
+#define ADIS_STREAM_CHUNK_SIZE  (256 * 1024)
+#define ADIS_STREAM_MAGIC_SIZE  4
+
+enum {
+    ADIS_STREAM_NONE,
+    ADIS_STREAM_GZIP,
+    ADIS_STREAM_ZSTD,
+};
+
+struct stream_chunk {
+    uint8_t *data;
+    size_t len;
+};
+
+/*
+ * Decompresses a gzip (or zlib) or zstd input on its own thread into a
+ * ring of ADIS_STREAM_CHUNKS fixed-size chunks, so decoding overlaps with
+ * decompression without ever holding more than the ring in memory. The
+ * worker blocks while every chunk is full or held by the reader.
+ * Concatenated gzip members and zstd frames are read as one stream.
+ */
+struct adis_stream {
+    int fd;
+    int format;
+    const char *name;
+
+    // bytes already read from fd to detect the format
+    uint8_t prefix[ADIS_STREAM_MAGIC_SIZE];
+    size_t nprefix;
+
+    struct stream_chunk chunks[ADIS_STREAM_CHUNKS];
+    unsigned head;      // next chunk the worker fills
+    unsigned tail;      // next chunk handed to the reader
+    unsigned count;     // chunks filled or held by the reader
+    int held;
+    int done;
+    int error;
+    int stop;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+// Format of an input starting with the n bytes at p
+int stream_detect(const uint8_t *p, size_t n);
+
+/*
+ * Start decompressing fd, whose first nprefix bytes were already read
+ * into prefix. The stream takes over fd and closes it unless it is stdin.
+ */
+int stream_open(struct adis_stream *s, int fd, const char *name, int format,
+    const uint8_t *prefix, size_t nprefix);
+
+/*
+ * Next chunk of decompressed data, valid until the next call. Returns
+ * NULL at the end of the input or on error. Every chunk but the last is
+ * full, so instruction words never straddle two chunks.
+ */
+const uint8_t *stream_next(struct adis_stream *s, size_t *len);
+
+// Stop the worker, returns 0 if the input was corrupt or unreadable
+int stream_close(struct adis_stream *s);
+
+#endif  // __ADIS_STREAM_H__
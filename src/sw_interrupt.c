@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "sw_interrupt.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_SWI_DATA(_op)  (_op & 0x00FFFFFF)
@@ -26,5 +27,11 @@
 void sw_interrupt_instr(uint32_t op)
 {
     char *cond = get_condition_string(op);
-    printf("SWI%s =0x%x\n", cond, ADIS_SWI_DATA(op));
+    adis_printf("SWI%s =0x%x\n", cond, ADIS_SWI_DATA(op));
+}
+
+int sw_interrupt_opcode(uint32_t op)
+{
+    (void)op;
+    return ADIS_OP_SWI;
 }
@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void sw_interrupt_instr(uint32_t op);
+int sw_interrupt_opcode(uint32_t op);
 
 #endif  // __ADIS_SW_INTERRUPT_H__
@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include "sync.h"
+#include "opcodes.h"
 #include "common.h"
 
 #define ADIS_DBLWORD_BIT(_op)        (op & 0x00200000)
@@ -30,11 +31,11 @@ static void swap_instr(uint32_t op)
 
     if (ADIS_BYTE_BIT(op)) {
         // swap byte
-        printf("SWP%sB R%d,R%d,[R%d]\n", cond, ADIS_RD(op), ADIS_RM(op),
+        adis_printf("SWP%sB R%d,R%d,[R%d]\n", cond, ADIS_RD(op), ADIS_RM(op),
             ADIS_RN(op));
     } else {
         // swap word
-        printf("SWP%s R%d,R%d,[R%d]\n", cond, ADIS_RD(op), ADIS_RM(op),
+        adis_printf("SWP%s R%d,R%d,[R%d]\n", cond, ADIS_RD(op), ADIS_RM(op),
             ADIS_RN(op));
     }
 }
@@ -58,10 +59,10 @@ void sync_instr(uint32_t op)
         // Special case - two destination / source registers so just
         // decode the instruction separately
         if (ADIS_LOAD_BIT(op)) {
-            printf("LDREXD%s, R%d,R%d,[R%d]\n", cond, ADIS_RD(op),
+            adis_printf("LDREXD%s, R%d,R%d,[R%d]\n", cond, ADIS_RD(op),
                 ADIS_RD(op) + 1, ADIS_RN(op));
         } else {
-            printf("STREXD%s R%d,R%d,R%d,[R%d]\n", cond, ADIS_RD(op),
+            adis_printf("STREXD%s R%d,R%d,R%d,[R%d]\n", cond, ADIS_RD(op),
                 ADIS_RM(op), ADIS_RM(op) + 1, ADIS_RN(op));
         }
         // All done at this point
@@ -71,10 +72,31 @@ void sync_instr(uint32_t op)
     }
 
     if (ADIS_LOAD_BIT(op)) {
-        printf("LDREX%c%s R%d,[R%d]\n", size, cond, ADIS_RD(op), ADIS_RN(op));
+        adis_printf("LDREX%c%s R%d,[R%d]\n", size, cond, ADIS_RD(op), ADIS_RN(op));
     } else {
-        printf("STREX%c%s R%d,R%d,[R%d]\n", size, cond, ADIS_RD(op),
+        adis_printf("STREX%c%s R%d,R%d,[R%d]\n", size, cond, ADIS_RD(op),
             ADIS_RM(op), ADIS_RN(op));
     }
 }
 
+int sync_opcode(uint32_t op)
+{
+    int size;
+
+    if (!ADIS_EXCL_BIT(op)) {
+        return ADIS_BYTE_BIT(op) ? ADIS_OP_SWPB : ADIS_OP_SWP;
+    }
+
+    // word, byte, halfword, doubleword
+    if (ADIS_BYTE_BIT(op) && ADIS_DBLWORD_BIT(op)) {
+        size = 2;
+    } else if (ADIS_BYTE_BIT(op)) {
+        size = 1;
+    } else if (ADIS_DBLWORD_BIT(op)) {
+        size = 3;
+    } else {
+        size = 0;
+    }
+
+    return ADIS_OP_LDREX + size * 2 + (ADIS_LOAD_BIT(op) ? 0 : 1);
+}
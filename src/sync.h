@@ -22,5 +22,6 @@
 #include <stdint.h>
 
 void sync_instr(uint32_t op);
+int sync_opcode(uint32_t op);
 
 #endif  // __ADIS_SYNC_H__
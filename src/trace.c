@@ -0,0 +1,230 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "decode.h"
+#include "trace.h"
+
+#define ADIS_TRACE_INIT_BITS    12
+
+struct trace_entry {
+    uint32_t pc;
+    uint32_t op;
+    uint64_t count;         // 0 for free slots
+    size_t off;             // rendered text in the trace's text buffer
+    size_t len;
+};
+
+struct adis_trace {
+    struct trace_entry *slots;
+    unsigned bits;
+    size_t used;
+    uint64_t records;
+    struct adis_buffer text;
+};
+
+static inline size_t trace_slot(uint32_t pc, uint32_t op, unsigned bits)
+{
+    uint64_t key = ((uint64_t)pc << 32) | op;
+
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+}
+
+struct adis_trace *trace_new(void)
+{
+    struct adis_trace *t = malloc(sizeof(*t));
+
+    if (t == NULL) {
+        return NULL;
+    }
+
+    t->bits = ADIS_TRACE_INIT_BITS;
+    t->slots = calloc((size_t)1 << t->bits, sizeof(*t->slots));
+    t->used = 0;
+    t->records = 0;
+    buffer_init(&t->text);
+
+    if (t->slots == NULL) {
+        free(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+void trace_free(struct adis_trace *t)
+{
+    if (t == NULL) {
+        return;
+    }
+
+    buffer_free(&t->text);
+    free(t->slots);
+    free(t);
+}
+
+// Double the table once it is half full
+static void trace_grow(struct adis_trace *t)
+{
+    size_t i, j, n = (size_t)1 << t->bits;
+    struct trace_entry *slots;
+
+    slots = calloc(n * 2, sizeof(*slots));
+    if (slots == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (t->slots[i].count == 0) {
+            continue;
+        }
+
+        j = trace_slot(t->slots[i].pc, t->slots[i].op, t->bits + 1);
+        while (slots[j].count != 0) {
+            j = (j + 1) & (n * 2 - 1);
+        }
+        slots[j] = t->slots[i];
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->bits++;
+}
+
+static struct trace_entry *trace_lookup(struct adis_trace *t, uint32_t pc,
+    uint32_t op)
+{
+    size_t mask = ((size_t)1 << t->bits) - 1;
+    size_t i = trace_slot(pc, op, t->bits);
+    struct adis_buffer *prev;
+    struct trace_entry *e;
+
+    for (;; i = (i + 1) & mask) {
+        e = &t->slots[i];
+        if (e->count == 0) {
+            break;
+        } else if (e->pc == pc && e->op == op) {
+            return e;
+        }
+    }
+
+    // first time this pair is seen, keep the table at most half full
+    if ((t->used + 1) * 2 > mask + 1) {
+        trace_grow(t);
+        return trace_lookup(t, pc, op);
+    }
+
+    e->pc = pc;
+    e->op = op;
+    e->off = t->text.len;
+
+    prev = set_output_buffer(&t->text);
+    disasm_line(op, pc);
+    set_output_buffer(prev);
+
+    e->len = t->text.len - e->off;
+    t->used++;
+    return e;
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+void trace_feed(struct adis_trace *t, const uint8_t *data, size_t len,
+    int render)
+{
+    struct adis_buffer *out = get_output_buffer();
+    size_t n = len / ADIS_TRACE_RECORD_SIZE;
+    struct trace_entry *e;
+    const uint8_t *p;
+
+    for (p = data; p < data + n * ADIS_TRACE_RECORD_SIZE;
+         p += ADIS_TRACE_RECORD_SIZE) {
+        e = trace_lookup(t, get_le32(p), get_le32(p + 4));
+        e->count++;
+        if (render) {
+            buffer_write(out, t->text.data + e->off, e->len);
+        }
+    }
+
+    t->records += n;
+}
+
+// Most executed first, then by address
+static int entry_hotter(const void *a, const void *b)
+{
+    const struct trace_entry *x = a, *y = b;
+
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    } else if (x->pc != y->pc) {
+        return x->pc < y->pc ? -1 : 1;
+    }
+
+    return (x->op > y->op) - (x->op < y->op);
+}
+
+void trace_summary(struct adis_trace *t)
+{
+    size_t i, n = 0, nslots = (size_t)1 << t->bits;
+    struct adis_buffer *out = get_output_buffer();
+    struct trace_entry *hot;
+
+    if (t->used == 0) {
+        return;
+    }
+
+    hot = malloc(sizeof(*hot) * t->used);
+    if (hot == NULL) {
+        fprintf(stderr, "ADIS_ERROR: Out of memory\n");
+        return;
+    }
+
+    for (i = 0; i < nslots; i++) {
+        if (t->slots[i].count != 0) {
+            hot[n++] = t->slots[i];
+        }
+    }
+
+    qsort(hot, n, sizeof(*hot), entry_hotter);
+
+    // the address line of each rendered pair, without the "op:" line
+    for (i = 0; i < n; i++) {
+        adis_printf("%12llu %6.2f%%  ", (unsigned long long)hot[i].count,
+            100.0 * hot[i].count / t->records);
+        buffer_write(out, t->text.data + hot[i].off + ADIS_OP_LINE,
+            hot[i].len - ADIS_OP_LINE);
+    }
+
+    free(hot);
+}
+
+void trace_stats(const struct adis_trace *t, uint64_t *records,
+    size_t *unique)
+{
+    *records = t->records;
+    *unique = t->used;
+}
@@ -0,0 +1,57 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ADIS_TRACE_H__
+#define __ADIS_TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Execution traces are a stream of 8 byte records, the PC and then the
+ * instruction word executed there, both 32-bit little-endian as most
+ * simulators write them. A trace repeats the same few (pc, opcode) pairs
+ * over and over, so each distinct pair is rendered once into a hash
+ * table and later occurrences copy the rendered line.
+ */
+#define ADIS_TRACE_RECORD_SIZE  8
+
+struct adis_trace;
+
+struct adis_trace *trace_new(void);
+void trace_free(struct adis_trace *t);
+
+/*
+ * Count the whole records in data[0, len) and, if render is set, append
+ * their disassembly to the output buffer of the calling thread.
+ * Unrecognized words are shown as such and don't stop the trace.
+ */
+void trace_feed(struct adis_trace *t, const uint8_t *data, size_t len,
+    int render);
+
+/*
+ * Append every distinct (pc, opcode) pair to the output buffer of the
+ * calling thread, most executed first, with its execution count and share
+ * of the trace in front of the instruction.
+ */
+void trace_summary(struct adis_trace *t);
+
+void trace_stats(const struct adis_trace *t, uint64_t *records,
+    size_t *unique);
+
+#endif  // __ADIS_TRACE_H__
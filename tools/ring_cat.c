@@ -0,0 +1,301 @@
+/*
+ *  Copyright (C) 2012 Matthew Rheaume
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Reference consumer for adis --shm: attaches to the ring, reads the
+ * published bytes in place and writes them to stdout. With -b they are
+ * only scanned (counting lines) and the throughput is printed instead, and
+ * with - as the path the same is done for adis output read from a pipe,
+ * for comparison.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "../src/ring.h"
+
+#define PIPE_CHUNK      65536
+
+struct consumer {
+    int bench;
+    uint64_t bytes;
+    uint64_t lines;
+    uint64_t waits;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Hand over the bytes at p, returns 0 on a write error
+static int consume(struct consumer *c, const uint8_t *p, size_t len)
+{
+    const uint8_t *end = p + len;
+
+    c->bytes += len;
+
+    if (!c->bench) {
+        return fwrite(p, 1, len, stdout) == len;
+    }
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        c->lines++;
+        p++;
+    }
+
+    return 1;
+}
+
+static void futex_wait(uint32_t *word, uint32_t val)
+{
+    struct timespec ts = { 0, ADIS_RING_WAIT_MS * 1000000L };
+
+    syscall(SYS_futex, word, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/*
+ * Wait for adis to create the ring and finish its header, then map it
+ * with the data area twice so unread bytes are always contiguous.
+ */
+static struct ring_header *attach(const char *path, uint8_t **data)
+{
+    struct ring_header *hdr;
+    struct stat st;
+    uint8_t *base;
+    size_t size, page;
+    int fd;
+
+    for (;;) {
+        fd = open(path, O_RDWR);
+        if (fd < 0 && errno != ENOENT) {
+            perror(path);
+            return NULL;
+        } else if (fd >= 0 && fstat(fd, &st) == 0 &&
+            (size_t)st.st_size > sizeof(*hdr)) {
+            hdr = mmap(NULL, sizeof(*hdr), PROT_READ, MAP_SHARED, fd, 0);
+            if (hdr != MAP_FAILED &&
+                memcmp(hdr->magic, ADIS_RING_MAGIC, sizeof(hdr->magic)) == 0) {
+                break;
+            } else if (hdr != MAP_FAILED) {
+                munmap(hdr, sizeof(*hdr));
+            }
+        }
+
+        if (fd >= 0) {
+            close(fd);
+        }
+        usleep(10000);
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (hdr->version != ADIS_RING_VERSION) {
+        fprintf(stderr, "%s: unsupported ring version %u\n", path,
+            hdr->version);
+        return NULL;
+    }
+
+    page = hdr->data_offset;
+    size = hdr->size;
+    munmap(hdr, sizeof(*hdr));
+
+    base = mmap(NULL, page + 2 * size, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED ||
+        mmap(base, page + size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + page + size, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, page) == MAP_FAILED) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+
+    close(fd);
+    hdr = (struct ring_header *)base;
+    *data = base + page;
+
+    __atomic_store_n(&hdr->reader_pid, getpid(), __ATOMIC_SEQ_CST);
+    return hdr;
+}
+
+// Returns the exit status
+static int read_ring(const char *path, struct consumer *c)
+{
+    struct ring_header *hdr;
+    uint8_t *data;
+    uint64_t head, tail;
+    uint32_t seq, flags = 0;
+
+    if ((hdr = attach(path, &data)) == NULL) {
+        return 2;
+    }
+
+    tail = hdr->tail;
+
+    for (;;) {
+        head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            // everything before DONE was set has been published
+            if (flags & ADIS_RING_DONE) {
+                break;
+            }
+            flags = __atomic_load_n(&hdr->flags, __ATOMIC_ACQUIRE);
+            if (flags & ADIS_RING_DONE) {
+                continue;
+            }
+
+            c->waits++;
+            __atomic_store_n(&hdr->reader_waiting, 1, __ATOMIC_SEQ_CST);
+            seq = __atomic_load_n(&hdr->head_seq, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&hdr->head, __ATOMIC_SEQ_CST) == tail) {
+                futex_wait(&hdr->head_seq, seq);
+            }
+            __atomic_store_n(&hdr->reader_waiting, 0, __ATOMIC_RELAXED);
+
+            if (kill(hdr->writer_pid, 0) != 0 && errno == ESRCH &&
+                __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) == tail &&
+                !(__atomic_load_n(&hdr->flags, __ATOMIC_ACQUIRE) &
+                    ADIS_RING_DONE)) {
+                fprintf(stderr, "%s: adis exited without finishing\n", path);
+                return 2;
+            }
+            continue;
+        }
+
+        if (!consume(c, data + tail % hdr->size, head - tail)) {
+            perror("stdout");
+            return 2;
+        }
+
+        tail = head;
+        __atomic_store_n(&hdr->tail, tail, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&hdr->tail_seq, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&hdr->writer_waiting, __ATOMIC_SEQ_CST)) {
+            futex_wake(&hdr->tail_seq);
+        }
+    }
+
+    return (flags & ADIS_RING_ERROR) ? 1 : 0;
+}
+
+static int read_pipe(struct consumer *c)
+{
+    static uint8_t buf[PIPE_CHUNK];
+    ssize_t n;
+
+    while ((n = read(STDIN_FILENO, buf, sizeof(buf))) != 0) {
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            perror("stdin");
+            return 2;
+        } else if (!consume(c, buf, n)) {
+            perror("stdout");
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-b] [-u] PATH|-\n"
+        "Copy the output adis --shm=PATH publishes to stdout, or the output\n"
+        "piped to stdin with -.\n"
+        "\n"
+        "  -b  don't copy, only scan the output and print the throughput\n"
+        "  -u  remove the ring file once it was read\n",
+        prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct consumer c;
+    int opt, unlink_ring = 0, ret;
+    const char *path;
+    double start, secs;
+
+    memset(&c, 0, sizeof(c));
+
+    while ((opt = getopt(argc, argv, "buh")) != -1) {
+        switch (opt) {
+        case 'b':
+            c.bench = 1;
+            break;
+        case 'u':
+            unlink_ring = 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    path = argv[optind];
+
+    start = now();
+    if (strcmp(path, "-") == 0) {
+        ret = read_pipe(&c);
+    } else {
+        ret = read_ring(path, &c);
+        if (unlink_ring) {
+            unlink(path);
+        }
+    }
+    secs = now() - start;
+
+    if (c.bench) {
+        fprintf(stderr, "%s: %llu bytes, %llu lines in %.3f s, %.1f MB/s, "
+            "%llu waits for adis\n", path, (unsigned long long)c.bytes,
+            (unsigned long long)c.lines, secs,
+            secs > 0 ? c.bytes / secs / 1e6 : 0.0,
+            (unsigned long long)c.waits);
+    }
+
+    return ret;
+}